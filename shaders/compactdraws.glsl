@@ -0,0 +1,35 @@
+#version 440
+
+layout (local_size_x = 64) in;
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 1) readonly buffer Commands {
+    DrawCommand commands[];
+};
+
+layout (std430, binding = 3) writeonly buffer CompactedCommands {
+    DrawCommand compactedCommands[];
+};
+
+layout (std430, binding = 4) buffer DrawCount {
+    uint drawCount;
+};
+
+uniform uint commandCount;
+
+void main() {
+    const uint command = gl_GlobalInvocationID.x;
+    if (command >= commandCount || commands[command].instanceCount == 0u) {
+        return;
+    }
+
+    const uint slot = atomicAdd(drawCount, 1u);
+    compactedCommands[slot] = commands[command];
+}
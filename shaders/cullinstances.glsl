@@ -0,0 +1,126 @@
+#version 440
+
+layout (local_size_x = 64) in;
+
+struct InstanceBounds {
+    vec4 sphere;
+    uint drawId;
+    uint instance;
+    uint padding0;
+    uint padding1;
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Bounds {
+    InstanceBounds bounds[];
+};
+
+layout (std430, binding = 1) buffer Commands {
+    DrawCommand commands[];
+};
+
+layout (std430, binding = 2) writeonly buffer VisibleInstances {
+    uint visibleInstances[];
+};
+
+layout (binding = 0) uniform sampler2D hiZTexture;
+
+uniform vec4 frustumPlanes[6];
+uniform uint instanceCount;
+uniform uint drawCount;
+uniform uint visibleCapacity;
+
+uniform bool occlusionEnabled;
+uniform mat4 occlusionMatrix;
+uniform ivec2 hiZSize;
+uniform int hiZLevels;
+
+// Projects the sphere's box with the matrix the Hi-Z was drawn with and
+// compares its nearest depth with the farthest depth under its footprint
+
+bool occluded(const vec4 sphere) {
+    vec3 minimum = vec3(1e30f);
+    vec3 maximum = vec3(-1e30f);
+    for (int i = 0; i < 8; ++i) {
+        const vec3 corner = sphere.xyz + sphere.w*vec3(
+                (i & 1) != 0 ? 1.f : -1.f,
+                (i & 2) != 0 ? 1.f : -1.f,
+                (i & 4) != 0 ? 1.f : -1.f);
+        const vec4 clip = occlusionMatrix*vec4(corner, 1.f);
+        if (clip.w <= 0.f) {
+            return false;
+        }
+        const vec3 ndc = clip.xyz/clip.w;
+        minimum = min(minimum, ndc);
+        maximum = max(maximum, ndc);
+    }
+
+    const vec2 uvMin = clamp(minimum.xy*.5f + .5f, 0.f, 1.f);
+    const vec2 uvMax = clamp(maximum.xy*.5f + .5f, 0.f, 1.f);
+    const vec2 extent = (uvMax - uvMin)*vec2(hiZSize);
+
+    // The level where the footprint spans at most 2x2 texels
+
+    const int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.f)))),
+            0, hiZLevels - 1);
+
+    // Level 0 texels shifted down, not the UVs scaled by the level's size.
+    // Odd sizes round levels down and fold the rest into the last row and
+    // column, so this finds the texel that covers them
+    const ivec2 levelSize = max(hiZSize >> level, ivec2(1));
+    const ivec2 texelMin = min(min(ivec2(uvMin*vec2(hiZSize)),
+            hiZSize - 1) >> level, levelSize - 1);
+    const ivec2 texelMax = min(min(ivec2(uvMax*vec2(hiZSize)),
+            hiZSize - 1) >> level, levelSize - 1);
+
+    const float farthest = max(
+            max(texelFetch(hiZTexture, texelMin, level).r,
+                texelFetch(hiZTexture, ivec2(texelMax.x, texelMin.y), level).r),
+            max(texelFetch(hiZTexture, ivec2(texelMin.x, texelMax.y), level).r,
+                texelFetch(hiZTexture, texelMax, level).r));
+    const float nearest = minimum.z*.5f + .5f;
+    return nearest > farthest;
+}
+
+void main() {
+    const uint instance = gl_GlobalInvocationID.x;
+    if (instance >= instanceCount) {
+        return;
+    }
+
+    const vec4 sphere = bounds[instance].sphere;
+    for (int i = 0; i < 6; ++i) {
+        if (dot(frustumPlanes[i].xyz, sphere.xyz) + frustumPlanes[i].w <
+                -sphere.w) {
+            return;
+        }
+    }
+
+    if (occlusionEnabled && occluded(sphere)) {
+        return;
+    }
+
+    const uint drawId = bounds[instance].drawId;
+    if (drawId >= drawCount) {
+        return;
+    }
+
+    // A draw owns the visible list up to the next draw's range, instances
+    // past it are dropped and the count is clamped back to the range
+    const uint first = commands[drawId].baseInstance;
+    const uint end = drawId + 1u < drawCount ?
+            commands[drawId + 1u].baseInstance : visibleCapacity;
+    const uint slot = atomicAdd(commands[drawId].instanceCount, 1u);
+    if (slot >= end - first) {
+        atomicMin(commands[drawId].instanceCount, end - first);
+        return;
+    }
+    visibleInstances[first + slot] = bounds[instance].instance;
+}
@@ -1,15 +1,62 @@
 #version 440
+#ifdef MATERIAL_BINDLESS
+#extension GL_ARB_bindless_texture : require
+#endif
 
 in vec3 vs_position;
 in vec3 vs_color;
 in vec2 vs_texcoord;
+flat in uint vs_material;
 
 out vec4 fs_color;
 
-uniform sampler2D ilufanTexture;
-uniform sampler2D boxTexture;
+// Material table filled by MaterialSystem, slot 0 - ilufan, slot 1 - box.
+// A slot samples rect (offset xy, scale zw) of its texture, texcoords
+// repeat within it. Gradients come from the unwrapped texcoords so the
+// wrap doesn't jump to the smallest mip
+
+#ifdef MATERIAL_BINDLESS
+
+struct Material {
+    uvec2 textures[4];
+    vec4 rects[4];
+};
+
+layout (std430, binding = 6) readonly buffer Materials {
+    Material materials[];
+};
+
+vec4 sampleMaterial(const int slot, const vec2 texcoord) {
+    const vec4 rect = materials[vs_material].rects[slot];
+    return textureGrad(sampler2D(materials[vs_material].textures[slot]),
+            rect.xy + fract(texcoord)*rect.zw,
+            dFdx(texcoord)*rect.zw, dFdy(texcoord)*rect.zw);
+}
+
+#else
+
+struct Material {
+    uint layers[4];
+    vec4 rects[4];
+};
+
+layout (std430, binding = 6) readonly buffer Materials {
+    Material materials[];
+};
+
+layout (binding = 0) uniform sampler2DArray materialTextures;
+
+vec4 sampleMaterial(const int slot, const vec2 texcoord) {
+    const vec4 rect = materials[vs_material].rects[slot];
+    return textureGrad(materialTextures, vec3(rect.xy +
+            fract(texcoord)*rect.zw,
+            float(materials[vs_material].layers[slot])),
+            dFdx(texcoord)*rect.zw, dFdy(texcoord)*rect.zw);
+}
+
+#endif
 
 void main() {
-    fs_color = (texture(boxTexture, vs_texcoord) +
-            texture(ilufanTexture, vs_texcoord));
+    fs_color = (sampleMaterial(1, vs_texcoord) +
+            sampleMaterial(0, vs_texcoord));
 }
@@ -0,0 +1,92 @@
+#version 440
+
+in vec3 vs_position;
+in vec3 vs_color;
+in vec2 vs_texcoord;
+
+out vec4 fs_color;
+
+// Virtual texture layout set by VirtualTexture::applyUniforms
+// vtMipLayout - (first tile, tiles x, tiles y, unused) per mip
+
+uniform vec2 vtVirtualSize;
+uniform float vtTileSize;
+uniform float vtBorder;
+uniform vec2 vtPhysicalSize;
+uniform int vtMipCount;
+uniform ivec4 vtMipLayout[16];
+
+layout (std430, binding = 8) readonly buffer PageTable {
+    uint pages[];
+};
+
+// One bit per tile, read back by VirtualTexture::update
+
+layout (std430, binding = 9) buffer Feedback {
+    uint requested[];
+};
+
+layout (binding = 1) uniform sampler2D virtualTexture;
+
+int virtualMip(const vec2 texel) {
+    const vec2 dx = dFdx(texel);
+    const vec2 dy = dFdy(texel);
+    const float lod = 0.5*log2(max(dot(dx, dx), dot(dy, dy)));
+    return clamp(int(floor(lod)), 0, vtMipCount - 1);
+}
+
+ivec2 virtualTile(const vec2 texel, const int mip) {
+    return min(ivec2(texel/(vtTileSize*exp2(float(mip)))),
+            vtMipLayout[mip].yz - 1);
+}
+
+// Marks the tile this fragment needs, the draws are the feedback pass
+
+void requestTile(const vec2 texel, const int mip) {
+    const ivec2 tile = virtualTile(texel, mip);
+    const uint index = uint(vtMipLayout[mip].x + tile.y*vtMipLayout[mip].y +
+            tile.x);
+    atomicOr(requested[index >> 5], 1u << (index & 31u));
+}
+
+#ifdef VT_SPARSE
+
+// Page table holds, per mip 0 tile, the finest mip from which every
+// coarser one is resident
+
+vec4 sampleVirtual(const vec2 uv, const vec2 texel, const int mip) {
+    const ivec2 tile = virtualTile(texel, 0);
+    const float minLod = float(pages[tile.y*vtMipLayout[0].y + tile.x]);
+    const float lod = max(textureQueryLod(virtualTexture, uv).y, minLod);
+    return textureLod(virtualTexture, uv, lod);
+}
+
+#else
+
+// Page table entries are slot x | slot y << 12 | resident mip << 24
+
+vec4 sampleVirtual(const vec2 uv, const vec2 texel, const int mip) {
+    const ivec4 mipLayout = vtMipLayout[mip];
+    const ivec2 tile = virtualTile(texel, mip);
+    const uint page = pages[mipLayout.x + tile.y*mipLayout.y + tile.x];
+    const vec2 slot = vec2(page & 0xfffu, (page >> 12) & 0xfffu);
+    const float residentMip = float(page >> 24);
+
+    // Position inside the resident tile, which may be a coarser ancestor
+
+    const vec2 mipTexel = texel/exp2(residentMip);
+    const vec2 inTile = mipTexel - floor(mipTexel/vtTileSize)*vtTileSize;
+    const float padded = vtTileSize + 2.0*vtBorder;
+    return textureLod(virtualTexture,
+            (slot*padded + vtBorder + inTile)/vtPhysicalSize, 0.0);
+}
+
+#endif
+
+void main() {
+    const vec2 uv = fract(vs_texcoord);
+    const vec2 texel = uv*vtVirtualSize;
+    const int mip = virtualMip(texel);
+    requestTile(texel, mip);
+    fs_color = sampleVirtual(uv, texel, mip);
+}
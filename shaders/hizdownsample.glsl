@@ -0,0 +1,51 @@
+#version 440
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (binding = 0) uniform sampler2D source;
+layout (r32f, binding = 0) writeonly uniform image2D destination;
+
+uniform bool copyDepth;
+uniform int sourceLevel;
+uniform ivec2 sourceSize;
+
+float fetchDepth(const ivec2 texel) {
+    return texelFetch(source, min(texel, sourceSize - 1), sourceLevel).r;
+}
+
+void main() {
+    const ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    const ivec2 destinationSize = imageSize(destination);
+    if (any(greaterThanEqual(texel, destinationSize))) {
+        return;
+    }
+
+    if (copyDepth) {
+        imageStore(destination, texel, vec4(fetchDepth(texel)));
+        return;
+    }
+
+    // Odd source sizes fold the extra row/column into the last texel
+
+    const ivec2 base = texel*2;
+    const bool extraX = (sourceSize.x & 1) != 0 &&
+            texel.x == destinationSize.x - 1;
+    const bool extraY = (sourceSize.y & 1) != 0 &&
+            texel.y == destinationSize.y - 1;
+
+    float depth = max(max(fetchDepth(base), fetchDepth(base + ivec2(1, 0))),
+            max(fetchDepth(base + ivec2(0, 1)), fetchDepth(base + ivec2(1, 1))));
+    if (extraX) {
+        depth = max(depth, max(fetchDepth(base + ivec2(2, 0)),
+                fetchDepth(base + ivec2(2, 1))));
+    }
+    if (extraY) {
+        depth = max(depth, max(fetchDepth(base + ivec2(0, 2)),
+                fetchDepth(base + ivec2(1, 2))));
+    }
+    if (extraX && extraY) {
+        depth = max(depth, fetchDepth(base + ivec2(2, 2)));
+    }
+
+    imageStore(destination, texel, vec4(depth));
+}
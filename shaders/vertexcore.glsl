@@ -7,16 +7,23 @@ layout (location = 2) in vec2 vertex_texcoord;
 out vec3 vs_position;
 out vec3 vs_color;
 out vec2 vs_texcoord;
+flat out uint vs_material;
+
+// Streamed once per frame
+layout (std140, binding = 0) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
 
 uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projectionMatrix;
+uniform uint materialId;
 
 void main() {
     vs_position = vec4(modelMatrix*vec4(vertex_position, 1.f)).xyz;
     vs_color = vertex_color;
     vs_texcoord = vec2(vertex_texcoord.x, -vertex_texcoord.y);
+    vs_material = materialId;
 
-    gl_Position = modelMatrix*viewMatrix*projectionMatrix
+    gl_Position = projectionMatrix*viewMatrix*modelMatrix*
             vec4(vertex_position, 1.f);
 }
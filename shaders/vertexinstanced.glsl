@@ -0,0 +1,36 @@
+#version 440
+
+layout (location = 0) in vec3 vertex_position;
+layout (location = 1) in vec3 vertex_color;
+layout (location = 2) in vec2 vertex_texcoord;
+layout (location = 3) in uint instance_id;
+
+out vec3 vs_position;
+out vec3 vs_color;
+out vec2 vs_texcoord;
+flat out uint vs_material;
+
+layout (std430, binding = 5) readonly buffer InstanceTransforms {
+    mat4 modelMatrices[];
+};
+
+layout (std430, binding = 7) readonly buffer InstanceMaterials {
+    uint materialIds[];
+};
+
+// Streamed once per frame
+layout (std140, binding = 0) uniform FrameUniforms {
+    mat4 viewMatrix;
+    mat4 projectionMatrix;
+};
+
+void main() {
+    const mat4 modelMatrix = modelMatrices[instance_id];
+    vs_position = vec4(modelMatrix*vec4(vertex_position, 1.f)).xyz;
+    vs_color = vertex_color;
+    vs_texcoord = vec2(vertex_texcoord.x, -vertex_texcoord.y);
+    vs_material = materialIds[instance_id];
+
+    gl_Position = projectionMatrix*viewMatrix*modelMatrix*
+            vec4(vertex_position, 1.f);
+}
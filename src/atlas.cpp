@@ -0,0 +1,209 @@
+#include "atlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+static auto alignUp(const int value, const int alignment) noexcept {
+    return (value + alignment - 1)/alignment*alignment;
+}
+
+TextureAtlas::TextureAtlas(const int pageSize, const int padding) noexcept :
+        size(pageSize), border(std::max(padding, 1)), levelCount(1) {
+    while ((border >> levelCount) > 0 && (size >> levelCount) > 0) {
+        ++levelCount;
+    }
+}
+
+TextureAtlas::~TextureAtlas() noexcept {
+    destroy();
+}
+
+TextureAtlas::Page& TextureAtlas::newPage() noexcept {
+    pages.emplace_back();
+    auto& page = pages.back();
+    page.skyline.push_back({ 0, 0, size });
+    for (auto level = 0; level < levelCount; ++level) {
+        const auto levelSize = static_cast<std::size_t>(size >> level);
+        page.levels.emplace_back(levelSize*levelSize*4u, 0u);
+    }
+    return page;
+}
+
+// Lowest top edge wins, ties go to the narrower segment
+
+bool TextureAtlas::findPosition(const Page& page, const int width,
+        const int height, int& bestX, int& bestY,
+        std::size_t& bestSegment) const noexcept {
+    auto bestTop = std::numeric_limits<int>::max();
+    auto bestWidth = std::numeric_limits<int>::max();
+    for (auto i = std::size_t(0); i < page.skyline.size(); ++i) {
+        const auto x = page.skyline[i].x;
+        if (x + width > size) {
+            break;
+        }
+
+        // The rectangle rests on the highest segment it spans
+
+        auto y = 0;
+        auto remaining = width;
+        for (auto j = i; remaining > 0; ++j) {
+            y = std::max(y, page.skyline[j].y);
+            remaining -= page.skyline[j].width;
+        }
+        if (y + height > size) {
+            continue;
+        }
+        if (y + height < bestTop || (y + height == bestTop &&
+                page.skyline[i].width < bestWidth)) {
+            bestTop = y + height;
+            bestWidth = page.skyline[i].width;
+            bestX = x;
+            bestY = y;
+            bestSegment = i;
+        }
+    }
+    return bestTop != std::numeric_limits<int>::max();
+}
+
+void TextureAtlas::place(Page& page, const std::size_t segment, const int x,
+        const int y, const int width, const int height) noexcept {
+    auto& skyline = page.skyline;
+    skyline.insert(skyline.begin() + segment, { x, y + height, width });
+
+    // Trim or drop the segments now covered by the new one
+
+    for (auto i = segment + 1; i < skyline.size();) {
+        const auto& previous = skyline[i - 1];
+        auto& current = skyline[i];
+        const auto overlap = previous.x + previous.width - current.x;
+        if (overlap <= 0) {
+            break;
+        }
+        current.x += overlap;
+        current.width -= overlap;
+        if (current.width > 0) {
+            break;
+        }
+        skyline.erase(skyline.begin() + i);
+    }
+
+    // Merge neighbours of the same height
+
+    for (auto i = std::size_t(0); i + 1 < skyline.size();) {
+        if (skyline[i].y == skyline[i + 1].y) {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+// Copies rows with the edge texels extruded into the padding
+
+static void copyPadded(const MipLevel& mip, unsigned char* const pixels,
+        const int pageSize, const int x, const int y, const int paddedWidth,
+        const int paddedHeight, const int border) noexcept {
+    const auto pitch = static_cast<std::size_t>(pageSize)*4u;
+    for (auto row = -border; row < paddedHeight - border; ++row) {
+        const auto sourceRow = std::min(std::max(row, 0), mip.height - 1);
+        const auto source = mip.pixels.data() +
+                static_cast<std::size_t>(sourceRow)*mip.width*4u;
+        auto destination = pixels + (y + border + row)*pitch + x*4u;
+        for (auto column = -border; column < paddedWidth - border;
+                ++column) {
+            const auto sourceColumn = std::min(std::max(column, 0),
+                    mip.width - 1);
+            std::memcpy(destination, source + sourceColumn*4u, 4u);
+            destination += 4;
+        }
+    }
+}
+
+bool TextureAtlas::add(const MipChain& mips, AtlasRegion& region) noexcept {
+    if (mips.empty()) {
+        return false;
+    }
+    const auto width = mips[0].width;
+    const auto height = mips[0].height;
+    const auto paddedWidth = alignUp(width + 2*border, border);
+    const auto paddedHeight = alignUp(height + 2*border, border);
+    if (paddedWidth > size || paddedHeight > size) {
+        return false;
+    }
+
+    auto x = 0;
+    auto y = 0;
+    auto segment = std::size_t(0);
+    auto pageIndex = std::size_t(0);
+    for (; pageIndex < pages.size(); ++pageIndex) {
+        if (findPosition(pages[pageIndex], paddedWidth, paddedHeight,
+                x, y, segment)) {
+            break;
+        }
+    }
+    if (pageIndex == pages.size()) {
+        findPosition(newPage(), paddedWidth, paddedHeight, x, y, segment);
+    }
+    auto& page = pages[pageIndex];
+    place(page, segment, x, y, paddedWidth, paddedHeight);
+
+    // The grid keeps the padded rectangle whole at every page level
+
+    for (auto level = 0; level < levelCount; ++level) {
+        const auto& mip = mips[std::min(static_cast<std::size_t>(level),
+                mips.size() - 1)];
+        copyPadded(mip, page.levels[level].data(), size >> level,
+                x >> level, y >> level, paddedWidth >> level,
+                paddedHeight >> level, border >> level);
+    }
+    page.dirty = true;
+
+    region.page = static_cast<std::uint32_t>(pageIndex);
+    region.x = x + border;
+    region.y = y + border;
+    region.width = width;
+    region.height = height;
+    region.uvMin = glm::vec2(float(region.x)/size, float(region.y)/size);
+    region.uvMax = glm::vec2(float(region.x + width)/size,
+            float(region.y + height)/size);
+    return true;
+}
+
+void TextureAtlas::upload() noexcept {
+    for (auto& page : pages) {
+        if (!page.dirty) {
+            continue;
+        }
+        if (page.texture == 0u) {
+            glCreateTextures(GL_TEXTURE_2D, 1, &page.texture);
+            glTextureStorage2D(page.texture, levelCount, GL_RGBA8, size,
+                    size);
+            glTextureParameteri(page.texture, GL_TEXTURE_WRAP_S,
+                    GL_CLAMP_TO_EDGE);
+            glTextureParameteri(page.texture, GL_TEXTURE_WRAP_T,
+                    GL_CLAMP_TO_EDGE);
+            glTextureParameteri(page.texture, GL_TEXTURE_MAG_FILTER,
+                    GL_LINEAR);
+            glTextureParameteri(page.texture, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+        }
+        for (auto level = 0; level < levelCount; ++level) {
+            glTextureSubImage2D(page.texture, level, 0, 0, size >> level,
+                    size >> level, GL_RGBA, GL_UNSIGNED_BYTE,
+                    page.levels[level].data());
+        }
+        page.dirty = false;
+    }
+}
+
+void TextureAtlas::destroy() noexcept {
+    for (auto& page : pages) {
+        if (page.texture != 0u) {
+            glDeleteTextures(1, &page.texture);
+        }
+    }
+    pages.clear();
+}
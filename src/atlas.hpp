@@ -0,0 +1,78 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "mipgen.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct AtlasRegion {
+    std::uint32_t page = 0u;
+    int x = 0; // Texel rectangle of the image, padding excluded
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    glm::vec2 uvMin = glm::vec2(0.f);
+    glm::vec2 uvMax = glm::vec2(0.f);
+};
+
+// Packs small RGBA8 images into shared pages with a skyline bottom-left
+// heuristic. Every image is surrounded by a copy of its edge texels
+// padding wide and placed on a padding aligned grid, so a padding of 2^n
+// keeps the first n mips free of bleeding from neighbours. Pages have
+// those n + 1 levels only, filled from the images' own mip chains
+
+class TextureAtlas {
+public:
+    explicit TextureAtlas(const int pageSize = 1024,
+            const int padding = 4) noexcept;
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+    ~TextureAtlas() noexcept;
+
+    // Returns false if the image is larger than a page. Mips missing from
+    // the chain repeat its last one
+    bool add(const MipChain& mips, AtlasRegion& region) noexcept;
+
+    // Creates textures for new pages and re-uploads changed ones
+    void upload() noexcept;
+    void destroy() noexcept;
+
+    std::size_t pageCount() const noexcept { return pages.size(); }
+    GLuint pageTexture(const std::uint32_t page) const noexcept {
+        return pages[page].texture;
+    }
+
+    // Maps a 0..1 texcoord of the source image into the atlas
+    static glm::vec2 remap(const AtlasRegion& region,
+            const glm::vec2& texcoord) noexcept {
+        return region.uvMin + (region.uvMax - region.uvMin)*texcoord;
+    }
+
+private:
+    struct SkylineSegment {
+        int x;
+        int y;
+        int width;
+    };
+
+    struct Page {
+        std::vector<SkylineSegment> skyline;
+        std::vector<std::vector<unsigned char>> levels;
+        GLuint texture = 0u;
+        bool dirty = true;
+    };
+
+    bool findPosition(const Page& page, const int width, const int height,
+            int& bestX, int& bestY, std::size_t& bestSegment) const noexcept;
+    void place(Page& page, const std::size_t segment, const int x,
+            const int y, const int width, const int height) noexcept;
+    Page& newPage() noexcept;
+
+    std::vector<Page> pages;
+    int size;
+    int border;
+    int levelCount;
+};
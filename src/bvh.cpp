@@ -0,0 +1,380 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+constexpr auto binCount = 16;
+constexpr auto maxLeafObjects = 4u;
+constexpr auto stackSize = 64;
+
+// Traversal stacks hold at most one entry per level plus one
+constexpr auto maxDepth = stackSize - 2;
+
+// Subtrees larger than this are built on another thread
+constexpr auto parallelThreshold = 4096u;
+
+static auto emptyBox() noexcept {
+    const auto infinity = std::numeric_limits<float>::max();
+    return BoundingBox{ glm::vec3(infinity), glm::vec3(-infinity) };
+}
+
+static auto grow(BoundingBox& box, const BoundingBox& other) noexcept {
+    box.boxMin = glm::min(box.boxMin, other.boxMin);
+    box.boxMax = glm::max(box.boxMax, other.boxMax);
+}
+
+static auto halfArea(const BoundingBox& box) noexcept {
+    const auto extent = box.boxMax - box.boxMin;
+    if (extent.x < 0.f) {
+        return 0.f;
+    }
+    return extent.x*extent.y + extent.y*extent.z + extent.z*extent.x;
+}
+
+// 0 - outside, 1 - intersecting, 2 - inside
+
+static auto classify(const Frustum& frustum, const glm::vec3& boxMin,
+        const glm::vec3& boxMax) noexcept {
+    const auto center = (boxMin + boxMax)*.5f;
+    const auto extent = (boxMax - boxMin)*.5f;
+    auto result = 2;
+    for (const auto& plane : frustum.planes) {
+        const auto normal = glm::vec3(plane.x, plane.y, plane.z);
+        const auto d = glm::dot(normal, center) + plane.w;
+        const auto r = glm::dot(glm::abs(normal), extent);
+        if (d < -r) {
+            return 0;
+        }
+        if (d < r) {
+            result = 1;
+        }
+    }
+    return result;
+}
+
+static auto sphereOverlaps(const glm::vec3& boxMin, const glm::vec3& boxMax,
+        const glm::vec3& center, const float radius) noexcept {
+    const auto closest = glm::min(glm::max(center, boxMin), boxMax);
+    const auto delta = closest - center;
+    return glm::dot(delta, delta) <= radius*radius;
+}
+
+// Slab test, returns the entry distance or a negative value on a miss
+
+static auto rayDistance(const glm::vec3& boxMin, const glm::vec3& boxMax,
+        const glm::vec3& origin, const glm::vec3& inverseDirection,
+        const float maxDistance) noexcept {
+    const auto t0 = (boxMin - origin)*inverseDirection;
+    const auto t1 = (boxMax - origin)*inverseDirection;
+    const auto tNear = glm::min(t0, t1);
+    const auto tFar = glm::max(t0, t1);
+    const auto enter = std::max(std::max(tNear.x, tNear.y),
+            std::max(tNear.z, 0.f));
+    const auto exit = std::min(std::min(tFar.x, tFar.y),
+            std::min(tFar.z, maxDistance));
+    return enter <= exit ? enter : -1.f;
+}
+
+// Build
+
+void Bvh::build(const std::vector<BoundingBox>& objectBounds) noexcept {
+    bounds = objectBounds;
+    const auto objectCount = static_cast<std::uint32_t>(bounds.size());
+
+    bvhNodes.assign(std::max(1u, 2u*objectCount), BvhNode());
+    objectIndices.resize(objectCount);
+    auto centroids = std::vector<glm::vec3>(objectCount);
+    for (auto i = 0u; i < objectCount; ++i) {
+        objectIndices[i] = i;
+        centroids[i] = (bounds[i].boxMin + bounds[i].boxMax)*.5f;
+    }
+
+    auto& root = bvhNodes[0];
+    root.leftFirst = 0u;
+    root.count = objectCount;
+    nodesAllocated = 1u;
+    updateBounds(0u);
+    subdivide(0u, 0, centroids);
+    usedNodes = nodesAllocated;
+}
+
+void Bvh::updateBounds(const std::uint32_t nodeIndex) noexcept {
+    auto& node = bvhNodes[nodeIndex];
+    auto box = emptyBox();
+    for (auto i = 0u; i < node.count; ++i) {
+        grow(box, bounds[objectIndices[node.leftFirst + i]]);
+    }
+    node.boundsMin = box.boxMin;
+    node.boundsMax = box.boxMax;
+}
+
+void Bvh::subdivide(const std::uint32_t nodeIndex, const int depth,
+        const std::vector<glm::vec3>& centroids) noexcept {
+    auto& node = bvhNodes[nodeIndex];
+    if (node.count <= maxLeafObjects || depth >= maxDepth) {
+        return;
+    }
+    const auto first = node.leftFirst;
+    const auto count = node.count;
+
+    // Bin centroids along every axis and keep the cheapest plane
+
+    auto centroidMin = centroids[objectIndices[first]];
+    auto centroidMax = centroidMin;
+    for (auto i = 1u; i < count; ++i) {
+        const auto& centroid = centroids[objectIndices[first + i]];
+        centroidMin = glm::min(centroidMin, centroid);
+        centroidMax = glm::max(centroidMax, centroid);
+    }
+
+    auto bestCost = halfArea({ node.boundsMin, node.boundsMax })*count;
+    auto bestAxis = -1;
+    auto bestSplit = 0;
+    for (auto axis = 0; axis < 3; ++axis) {
+        const auto extent = centroidMax[axis] - centroidMin[axis];
+        if (extent <= 0.f) {
+            continue;
+        }
+        const auto scale = binCount/extent;
+
+        BoundingBox binBounds[binCount];
+        std::uint32_t binCounts[binCount] = {};
+        std::fill(std::begin(binBounds), std::end(binBounds), emptyBox());
+        for (auto i = 0u; i < count; ++i) {
+            const auto object = objectIndices[first + i];
+            const auto bin = std::min(binCount - 1, static_cast<int>(
+                    (centroids[object][axis] - centroidMin[axis])*scale));
+            ++binCounts[bin];
+            grow(binBounds[bin], bounds[object]);
+        }
+
+        float leftCosts[binCount - 1];
+        auto leftBox = emptyBox();
+        auto leftCount = 0u;
+        for (auto i = 0; i < binCount - 1; ++i) {
+            grow(leftBox, binBounds[i]);
+            leftCount += binCounts[i];
+            leftCosts[i] = halfArea(leftBox)*leftCount;
+        }
+        auto rightBox = emptyBox();
+        auto rightCount = 0u;
+        for (auto i = binCount - 1; i > 0; --i) {
+            grow(rightBox, binBounds[i]);
+            rightCount += binCounts[i];
+            const auto cost = leftCosts[i - 1] + halfArea(rightBox)*rightCount;
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = i;
+            }
+        }
+    }
+    if (bestAxis < 0) {
+        return;
+    }
+
+    const auto scale = binCount/(centroidMax[bestAxis] - centroidMin[bestAxis]);
+    const auto begin = objectIndices.begin() + first;
+    const auto middle = std::partition(begin, begin + count,
+            [&](const std::uint32_t object) {
+        const auto bin = std::min(binCount - 1, static_cast<int>(
+                (centroids[object][bestAxis] - centroidMin[bestAxis])*scale));
+        return bin < bestSplit;
+    });
+    const auto leftCount = static_cast<std::uint32_t>(middle - begin);
+    if (leftCount == 0u || leftCount == count) {
+        return;
+    }
+
+    // Children
+
+    const auto leftChild = nodesAllocated.fetch_add(2u);
+    bvhNodes[leftChild].leftFirst = first;
+    bvhNodes[leftChild].count = leftCount;
+    bvhNodes[leftChild + 1].leftFirst = first + leftCount;
+    bvhNodes[leftChild + 1].count = count - leftCount;
+    node.leftFirst = leftChild;
+    node.count = 0u;
+
+    updateBounds(leftChild);
+    updateBounds(leftChild + 1);
+
+    if (count > parallelThreshold) {
+        auto left = std::async(std::launch::async, [&] {
+            subdivide(leftChild, depth + 1, centroids);
+        });
+        subdivide(leftChild + 1, depth + 1, centroids);
+        left.wait();
+    }
+    else {
+        subdivide(leftChild, depth + 1, centroids);
+        subdivide(leftChild + 1, depth + 1, centroids);
+    }
+}
+
+void Bvh::refit(const std::vector<BoundingBox>& objectBounds) noexcept {
+    bounds = objectBounds;
+
+    // An empty root has no children to merge
+    if (objectIndices.empty()) {
+        return;
+    }
+    for (auto i = usedNodes; i-- > 0;) {
+        auto& node = bvhNodes[i];
+        if (node.count > 0u) {
+            updateBounds(static_cast<std::uint32_t>(i));
+            continue;
+        }
+        const auto& left = bvhNodes[node.leftFirst];
+        const auto& right = bvhNodes[node.leftFirst + 1];
+        node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+        node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+    }
+}
+
+// Queries
+
+void Bvh::collect(const std::uint32_t nodeIndex,
+        std::vector<std::uint32_t>& objects) const noexcept {
+    std::uint32_t stack[stackSize];
+    auto top = 0;
+    stack[top++] = nodeIndex;
+    while (top > 0) {
+        const auto& node = bvhNodes[stack[--top]];
+        if (node.count > 0u) {
+            objects.insert(objects.end(),
+                    objectIndices.begin() + node.leftFirst,
+                    objectIndices.begin() + node.leftFirst + node.count);
+            continue;
+        }
+        stack[top++] = node.leftFirst;
+        stack[top++] = node.leftFirst + 1;
+    }
+}
+
+void Bvh::queryFrustum(const Frustum& frustum,
+        std::vector<std::uint32_t>& objects) const noexcept {
+    objects.clear();
+    if (bounds.empty()) {
+        return;
+    }
+
+    std::uint32_t stack[stackSize];
+    auto top = 0;
+    stack[top++] = 0u;
+    while (top > 0) {
+        const auto nodeIndex = stack[--top];
+        const auto& node = bvhNodes[nodeIndex];
+        const auto result = classify(frustum, node.boundsMin, node.boundsMax);
+        if (result == 0) {
+            continue;
+        }
+        if (result == 2) {
+            collect(nodeIndex, objects);
+            continue;
+        }
+        if (node.count > 0u) {
+            for (auto i = 0u; i < node.count; ++i) {
+                const auto object = objectIndices[node.leftFirst + i];
+                if (classify(frustum, bounds[object].boxMin,
+                        bounds[object].boxMax) != 0) {
+                    objects.push_back(object);
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.leftFirst;
+        stack[top++] = node.leftFirst + 1;
+    }
+}
+
+void Bvh::querySphere(const glm::vec3& center, const float radius,
+        std::vector<std::uint32_t>& objects) const noexcept {
+    objects.clear();
+    if (bounds.empty()) {
+        return;
+    }
+
+    std::uint32_t stack[stackSize];
+    auto top = 0;
+    stack[top++] = 0u;
+    while (top > 0) {
+        const auto& node = bvhNodes[stack[--top]];
+        if (!sphereOverlaps(node.boundsMin, node.boundsMax, center, radius)) {
+            continue;
+        }
+        if (node.count > 0u) {
+            for (auto i = 0u; i < node.count; ++i) {
+                const auto object = objectIndices[node.leftFirst + i];
+                if (sphereOverlaps(bounds[object].boxMin,
+                        bounds[object].boxMax, center, radius)) {
+                    objects.push_back(object);
+                }
+            }
+            continue;
+        }
+        stack[top++] = node.leftFirst;
+        stack[top++] = node.leftFirst + 1;
+    }
+}
+
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction,
+        const float maxDistance, RayHit& hit) const noexcept {
+    if (bounds.empty()) {
+        return false;
+    }
+
+    const auto inverseDirection = glm::vec3(1.f/direction.x,
+            1.f/direction.y, 1.f/direction.z);
+    auto nearest = maxDistance;
+    auto found = false;
+
+    std::uint32_t stack[stackSize];
+    auto top = 0;
+    stack[top++] = 0u;
+    while (top > 0) {
+        const auto& node = bvhNodes[stack[--top]];
+        if (rayDistance(node.boundsMin, node.boundsMax,
+                origin, inverseDirection, nearest) < 0.f) {
+            continue;
+        }
+        if (node.count > 0u) {
+            for (auto i = 0u; i < node.count; ++i) {
+                const auto object = objectIndices[node.leftFirst + i];
+                const auto distance = rayDistance(bounds[object].boxMin,
+                        bounds[object].boxMax, origin, inverseDirection,
+                        nearest);
+                if (distance >= 0.f) {
+                    nearest = distance;
+                    hit.object = object;
+                    hit.distance = distance;
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so farther ones get rejected early
+
+        const auto& left = bvhNodes[node.leftFirst];
+        const auto& right = bvhNodes[node.leftFirst + 1];
+        const auto leftDistance = rayDistance(left.boundsMin,
+                left.boundsMax, origin, inverseDirection, nearest);
+        const auto rightDistance = rayDistance(right.boundsMin,
+                right.boundsMax, origin, inverseDirection, nearest);
+        const auto leftFirst = leftDistance >= 0.f &&
+                (rightDistance < 0.f || leftDistance <= rightDistance);
+        if (rightDistance >= 0.f && leftFirst) {
+            stack[top++] = node.leftFirst + 1;
+        }
+        if (leftDistance >= 0.f) {
+            stack[top++] = node.leftFirst;
+        }
+        if (rightDistance >= 0.f && !leftFirst) {
+            stack[top++] = node.leftFirst + 1;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BoundingBox {
+    glm::vec3 boxMin;
+    glm::vec3 boxMax;
+};
+
+struct BvhNode {
+    glm::vec3 boundsMin;
+    std::uint32_t leftFirst; // Left child if count == 0, else first object
+    glm::vec3 boundsMax;
+    std::uint32_t count;
+};
+
+struct RayHit {
+    std::uint32_t object = 0;
+    float distance = 0.f;
+};
+
+// Binned SAH bounding volume hierarchy over object boxes. Children are
+// always stored after their parent, refit walks the nodes backwards
+
+class Bvh {
+public:
+    void build(const std::vector<BoundingBox>& objectBounds) noexcept;
+
+    // Updates node bounds for moved objects, the topology is kept
+    void refit(const std::vector<BoundingBox>& objectBounds) noexcept;
+
+    void queryFrustum(const Frustum& frustum,
+            std::vector<std::uint32_t>& objects) const noexcept;
+    void querySphere(const glm::vec3& center, const float radius,
+            std::vector<std::uint32_t>& objects) const noexcept;
+
+    // Nearest object box hit along the ray, direction needs no normalizing
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction,
+            const float maxDistance, RayHit& hit) const noexcept;
+
+    std::size_t nodeCount() const noexcept { return usedNodes; }
+    const std::vector<BvhNode>& nodes() const noexcept { return bvhNodes; }
+
+private:
+    void subdivide(const std::uint32_t nodeIndex, const int depth,
+            const std::vector<glm::vec3>& centroids) noexcept;
+    void updateBounds(const std::uint32_t nodeIndex) noexcept;
+    void collect(const std::uint32_t nodeIndex,
+            std::vector<std::uint32_t>& objects) const noexcept;
+
+    std::vector<BvhNode> bvhNodes;
+    std::vector<BoundingBox> bounds;
+    std::vector<std::uint32_t> objectIndices;
+    std::atomic<std::uint32_t> nodesAllocated{ 0u };
+    std::size_t usedNodes = 0;
+};
@@ -0,0 +1,256 @@
+#include "commandbuffer.hpp"
+
+#include <GL/glew.h>
+
+#include "glstatecache.hpp"
+
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+struct BindProgramPacket {
+    std::uint32_t program;
+};
+
+struct BindVertexArrayPacket {
+    std::uint32_t vao;
+};
+
+struct BindTexturePacket {
+    std::uint32_t unit;
+    TextureTarget target;
+    std::uint32_t texture;
+};
+
+struct SetUniformUintPacket {
+    std::int32_t location;
+    std::uint32_t value;
+};
+
+struct SetUniformMat4Packet {
+    std::int32_t location;
+    float value[16];
+};
+
+// Followed by size bytes of data, padded to a word
+struct UpdateBufferPacket {
+    std::uint32_t buffer;
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+struct BindUniformBufferPacket {
+    std::uint32_t index;
+    std::uint32_t buffer;
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+constexpr auto typeBits = 8u;
+
+template <typename Payload>
+static constexpr auto payloadWords() noexcept {
+    static_assert(sizeof(Payload)%4u == 0u, "payload must fill whole words");
+    static_assert(std::is_trivially_copyable<Payload>::value,
+            "payload must be trivially copyable");
+    return static_cast<std::uint32_t>(sizeof(Payload)/4u);
+}
+
+template <typename Payload>
+static auto read(const std::uint32_t* const words) noexcept {
+    auto payload = Payload();
+    std::memcpy(static_cast<void*>(&payload), words, sizeof(Payload));
+    return payload;
+}
+
+static GLenum toGL(const TextureTarget target) noexcept {
+    switch (target) {
+    case TextureTarget::Texture2D:
+        return GL_TEXTURE_2D;
+    case TextureTarget::Texture2DArray:
+        return GL_TEXTURE_2D_ARRAY;
+    case TextureTarget::Texture3D:
+        return GL_TEXTURE_3D;
+    case TextureTarget::CubeMap:
+        return GL_TEXTURE_CUBE_MAP;
+    }
+    return GL_TEXTURE_2D;
+}
+
+static GLenum toGL(const PrimitiveTopology topology) noexcept {
+    switch (topology) {
+    case PrimitiveTopology::Points:
+        return GL_POINTS;
+    case PrimitiveTopology::Lines:
+        return GL_LINES;
+    case PrimitiveTopology::Triangles:
+        return GL_TRIANGLES;
+    case PrimitiveTopology::TriangleStrip:
+        return GL_TRIANGLE_STRIP;
+    }
+    return GL_TRIANGLES;
+}
+
+static GLenum toGL(const IndexType type) noexcept {
+    return type == IndexType::Uint16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+void CommandBuffer::clear() noexcept {
+    words.clear();
+    commands = 0u;
+}
+
+void CommandBuffer::clear(LinearArena& arena) noexcept {
+    if (!words.get_allocator().arena) {
+        words = ArenaVector<std::uint32_t>(&arena);
+    }
+    else {
+        // The old storage lies in an arena that was reset since, giving it
+        // back could release memory handed out again, so it is abandoned
+        new (&words) ArenaVector<std::uint32_t>(&arena);
+    }
+    commands = 0u;
+}
+
+void CommandBuffer::reserve(const std::size_t bytes) noexcept {
+    words.reserve((bytes + 3u)/4u);
+}
+
+template <typename Payload>
+void CommandBuffer::write(const CommandType type, const Payload& payload,
+        const void* const extra, const std::uint32_t extraSize) noexcept {
+    const auto extraWords = (extraSize + 3u)/4u;
+    const auto packetWords = 1u + payloadWords<Payload>() + extraWords;
+
+    const auto position = words.size();
+    words.resize(position + packetWords);
+    words[position] = static_cast<std::uint32_t>(type) |
+            (packetWords << typeBits);
+    std::memcpy(&words[position + 1u], &payload, sizeof(Payload));
+    if (extraSize != 0u) {
+        // resize() zeroed the padding
+        std::memcpy(&words[position + 1u + payloadWords<Payload>()],
+                extra, extraSize);
+    }
+    ++commands;
+}
+
+void CommandBuffer::bindProgram(const std::uint32_t program) noexcept {
+    write(CommandType::BindProgram, BindProgramPacket{ program });
+}
+
+void CommandBuffer::bindVertexArray(const std::uint32_t vao) noexcept {
+    write(CommandType::BindVertexArray, BindVertexArrayPacket{ vao });
+}
+
+void CommandBuffer::bindTexture(const std::uint32_t unit,
+        const TextureTarget target, const std::uint32_t texture) noexcept {
+    write(CommandType::BindTexture,
+            BindTexturePacket{ unit, target, texture });
+}
+
+void CommandBuffer::setUniform(const std::int32_t location,
+        const std::uint32_t value) noexcept {
+    write(CommandType::SetUniformUint, SetUniformUintPacket{ location, value });
+}
+
+void CommandBuffer::setUniform(const std::int32_t location,
+        const glm::mat4& value) noexcept {
+    auto packet = SetUniformMat4Packet();
+    packet.location = location;
+    std::memcpy(packet.value, &value[0][0], sizeof(packet.value));
+    write(CommandType::SetUniformMat4, packet);
+}
+
+void CommandBuffer::updateBuffer(const std::uint32_t buffer,
+        const std::uint32_t offset, const void* const data,
+        const std::uint32_t size) noexcept {
+    write(CommandType::UpdateBuffer,
+            UpdateBufferPacket{ buffer, offset, size }, data, size);
+}
+
+void CommandBuffer::bindUniformBuffer(const std::uint32_t index,
+        const std::uint32_t buffer, const std::uint32_t offset,
+        const std::uint32_t size) noexcept {
+    write(CommandType::BindUniformBuffer,
+            BindUniformBufferPacket{ index, buffer, offset, size });
+}
+
+void CommandBuffer::drawIndexed(const DrawIndexedCommand& draw) noexcept {
+    write(CommandType::DrawIndexed, draw);
+}
+
+void CommandBuffer::drawIndexedIndirect(
+        const DrawIndexedIndirectCommand& draw) noexcept {
+    write(CommandType::DrawIndexedIndirect, draw);
+}
+
+void replay(const CommandBuffer& commands, GLStateCache& stateCache,
+        const std::uint32_t indirectBase) noexcept {
+    const auto& words = commands.data();
+    auto position = std::size_t(0);
+
+    while (position < words.size()) {
+        const auto header = words[position];
+        const auto payload = &words[position + 1u];
+        position += header >> typeBits;
+
+        switch (static_cast<CommandType>(header & ((1u << typeBits) - 1u))) {
+        case CommandType::BindProgram:
+            stateCache.useProgram(read<BindProgramPacket>(payload).program);
+            break;
+        case CommandType::BindVertexArray:
+            stateCache.bindVertexArray(
+                    read<BindVertexArrayPacket>(payload).vao);
+            break;
+        case CommandType::BindTexture: {
+            const auto bind = read<BindTexturePacket>(payload);
+            stateCache.bindTextureUnit(bind.unit,
+                    toGL(bind.target), bind.texture);
+            break;
+        }
+        case CommandType::SetUniformUint: {
+            const auto uniform = read<SetUniformUintPacket>(payload);
+            glUniform1ui(uniform.location, uniform.value);
+            break;
+        }
+        case CommandType::SetUniformMat4: {
+            const auto uniform = read<SetUniformMat4Packet>(payload);
+            glUniformMatrix4fv(uniform.location, 1, GL_FALSE, uniform.value);
+            break;
+        }
+        case CommandType::UpdateBuffer: {
+            const auto update = read<UpdateBufferPacket>(payload);
+            glNamedBufferSubData(update.buffer, update.offset, update.size,
+                    payload + payloadWords<UpdateBufferPacket>());
+            break;
+        }
+        case CommandType::BindUniformBuffer: {
+            const auto bind = read<BindUniformBufferPacket>(payload);
+            glBindBufferRange(GL_UNIFORM_BUFFER, bind.index, bind.buffer,
+                    bind.offset, bind.size);
+            break;
+        }
+        case CommandType::DrawIndexed: {
+            const auto draw = read<DrawIndexedCommand>(payload);
+            glDrawElementsInstancedBaseVertex(toGL(draw.topology),
+                    static_cast<GLsizei>(draw.indexCount),
+                    toGL(draw.indexType),
+                    reinterpret_cast<const void*>(
+                            static_cast<std::uintptr_t>(draw.indexOffset)),
+                    static_cast<GLsizei>(draw.instanceCount),
+                    draw.baseVertex);
+            break;
+        }
+        case CommandType::DrawIndexedIndirect: {
+            const auto draw = read<DrawIndexedIndirectCommand>(payload);
+            glMultiDrawElementsIndirect(toGL(draw.topology),
+                    toGL(draw.indexType), reinterpret_cast<const void*>(
+                            static_cast<std::uintptr_t>(indirectBase) +
+                            draw.offset),
+                    static_cast<GLsizei>(draw.drawCount), 0);
+            break;
+        }
+        }
+    }
+}
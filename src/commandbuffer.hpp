@@ -0,0 +1,128 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "framearena.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class GLStateCache;
+
+// Commands are recorded without a context, so any thread may fill a buffer.
+// Objects are plain 32 bit names and enums are our own, only replay() knows
+// the API. Packets are a header word, type (8 bits) | words (24), followed
+// by the payload, all 4 byte aligned
+
+enum class CommandType : std::uint8_t {
+    BindProgram,
+    BindVertexArray,
+    BindTexture,
+    SetUniformUint,
+    SetUniformMat4,
+    UpdateBuffer,
+    BindUniformBuffer,
+    DrawIndexed,
+    DrawIndexedIndirect
+};
+
+enum class TextureTarget : std::uint32_t {
+    Texture2D,
+    Texture2DArray,
+    Texture3D,
+    CubeMap
+};
+
+enum class PrimitiveTopology : std::uint32_t {
+    Points,
+    Lines,
+    Triangles,
+    TriangleStrip
+};
+
+enum class IndexType : std::uint32_t {
+    Uint16,
+    Uint32
+};
+
+struct DrawIndexedCommand {
+    PrimitiveTopology topology = PrimitiveTopology::Triangles;
+    IndexType indexType = IndexType::Uint32;
+    std::uint32_t indexCount = 0u;
+    std::uint32_t instanceCount = 1u;
+    std::uint32_t indexOffset = 0u; // In bytes
+    std::int32_t baseVertex = 0;
+};
+
+// One draw as the GPU reads it from the draw indirect buffer
+struct IndexedIndirectArgs {
+    std::uint32_t indexCount = 0u;
+    std::uint32_t instanceCount = 1u;
+    std::uint32_t firstIndex = 0u; // In indices
+    std::int32_t baseVertex = 0;
+    std::uint32_t baseInstance = 0u;
+};
+
+// drawCount draws whose IndexedIndirectArgs are packed at offset
+struct DrawIndexedIndirectCommand {
+    PrimitiveTopology topology = PrimitiveTopology::Triangles;
+    IndexType indexType = IndexType::Uint32;
+    std::uint32_t offset = 0u; // In bytes, from replay()'s indirectBase
+    std::uint32_t drawCount = 0u;
+};
+
+class CommandBuffer {
+public:
+    // Keeps the storage, buffers are reused every frame
+    void clear() noexcept;
+
+    // Starts over in memory of a frame arena, the old storage is abandoned.
+    // Used to record on workers without touching the heap
+    void clear(LinearArena& arena) noexcept;
+
+    void reserve(const std::size_t bytes) noexcept;
+
+    void bindProgram(const std::uint32_t program) noexcept;
+    void bindVertexArray(const std::uint32_t vao) noexcept;
+    void bindTexture(const std::uint32_t unit, const TextureTarget target,
+            const std::uint32_t texture) noexcept;
+
+    // Uniforms of the bound program
+    void setUniform(const std::int32_t location,
+            const std::uint32_t value) noexcept;
+    void setUniform(const std::int32_t location,
+            const glm::mat4& value) noexcept;
+
+    // The data is copied into the buffer, size is in bytes
+    void updateBuffer(const std::uint32_t buffer, const std::uint32_t offset,
+            const void* const data, const std::uint32_t size) noexcept;
+    void bindUniformBuffer(const std::uint32_t index,
+            const std::uint32_t buffer, const std::uint32_t offset,
+            const std::uint32_t size) noexcept;
+
+    void drawIndexed(const DrawIndexedCommand& draw) noexcept;
+    void drawIndexedIndirect(
+            const DrawIndexedIndirectCommand& draw) noexcept;
+
+    bool empty() const noexcept { return words.empty(); }
+    std::size_t commandCount() const noexcept { return commands; }
+    std::size_t sizeBytes() const noexcept { return words.size()*4u; }
+
+    const ArenaVector<std::uint32_t>& data() const noexcept { return words; }
+
+private:
+    template <typename Payload>
+    void write(const CommandType type, const Payload& payload,
+            const void* const extra = nullptr,
+            const std::uint32_t extraSize = 0u) noexcept;
+
+    ArenaVector<std::uint32_t> words;
+    std::size_t commands = 0u;
+};
+
+// Issues the commands on the calling thread, which must own the context.
+// Indirect draws read the bound draw indirect buffer from indirectBase on,
+// the arguments are usually written once recording is done
+void replay(const CommandBuffer& commands, GLStateCache& stateCache,
+        const std::uint32_t indirectBase = 0u) noexcept;
@@ -0,0 +1,245 @@
+#include "cookedmesh.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstdio>
+#include <iostream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<Vertex>::value &&
+        std::is_trivially_copyable<Submesh>::value &&
+        std::is_trivially_copyable<MeshLod>::value &&
+        std::is_trivially_copyable<Meshlet>::value,
+        "Cooked sections are copied as bytes");
+static_assert(sizeof(CookedMeshHeader) == 120u && sizeof(Submesh) == 16u &&
+        sizeof(MeshLod) == 20u && sizeof(Meshlet) == 56u,
+        "Layout changed, bump cookedMeshVersion");
+
+static auto alignUp(const std::size_t value) noexcept {
+    return (value + cookedMeshAlignment - 1u)/cookedMeshAlignment*
+            cookedMeshAlignment;
+}
+
+static auto writeSection(std::FILE* const file, std::size_t& position,
+        const std::size_t offset, const void* const data,
+        const std::size_t size) noexcept {
+    static const char zeros[cookedMeshAlignment] = {};
+    if (std::fwrite(zeros, 1u, offset - position, file) !=
+            offset - position) {
+        return false;
+    }
+    position = offset + size;
+    return size == 0u || std::fwrite(data, 1u, size, file) == size;
+}
+
+bool cookMesh(const Mesh& mesh, const char* const fileName) noexcept {
+    auto indices = PackedIndices();
+    packIndices(mesh, indices);
+
+    auto header = CookedMeshHeader();
+    header.indexSize = indices.indexSize;
+    header.vertexCount = mesh.vertices.size();
+    header.indexCount = mesh.indices.size();
+    header.submeshCount = indices.submeshes.size();
+    header.vertexOffset = alignUp(sizeof(header));
+    header.indexOffset = alignUp(header.vertexOffset +
+            header.vertexCount*sizeof(Vertex));
+    header.submeshOffset = alignUp(header.indexOffset +
+            indices.data.size());
+    header.lodCount = indices.lods.size();
+    header.lodOffset = alignUp(header.submeshOffset +
+            header.submeshCount*sizeof(Submesh));
+    header.meshletCount = indices.meshlets.size();
+    header.meshletOffset = alignUp(header.lodOffset +
+            header.lodCount*sizeof(MeshLod));
+    for (auto axis = 0; axis < 3; ++axis) {
+        header.boundsMin[axis] = mesh.boundsMin[axis];
+        header.boundsMax[axis] = mesh.boundsMax[axis];
+    }
+
+    const auto file = std::fopen(fileName, "wb");
+    if (!file) {
+        std::cout << "Cooked mesh \"" << fileName << "\" can't be created\n";
+        return false;
+    }
+    auto position = std::size_t(0);
+    auto written = writeSection(file, position, 0u, &header, sizeof(header));
+    written = written && writeSection(file, position, header.vertexOffset,
+            mesh.vertices.data(), mesh.vertices.size()*sizeof(Vertex));
+    written = written && writeSection(file, position, header.indexOffset,
+            indices.data.data(), indices.data.size());
+    written = written && writeSection(file, position, header.submeshOffset,
+            indices.submeshes.data(),
+            indices.submeshes.size()*sizeof(Submesh));
+    written = written && writeSection(file, position, header.lodOffset,
+            indices.lods.data(), indices.lods.size()*sizeof(MeshLod));
+    written = written && writeSection(file, position, header.meshletOffset,
+            indices.meshlets.data(),
+            indices.meshlets.size()*sizeof(Meshlet));
+    written = std::fclose(file) == 0 && written;
+    if (!written) {
+        std::cout << "Cooked mesh \"" << fileName << "\" write failed\n";
+    }
+    return written;
+}
+
+CookedMesh::~CookedMesh() noexcept {
+    close();
+}
+
+// The section is aligned and its elements end inside the file
+static auto sectionFits(const std::uint64_t offset, const std::uint64_t count,
+        const std::size_t elementSize, const std::size_t fileSize) noexcept {
+    return offset%cookedMeshAlignment == 0u && offset <= fileSize &&
+            count <= (fileSize - offset)/elementSize;
+}
+
+bool CookedMesh::open(const char* const fileName) noexcept {
+    close();
+
+#ifdef _WIN32
+    file = CreateFileA(fileName, GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        file = nullptr;
+        return false;
+    }
+    auto fileSize = LARGE_INTEGER();
+    GetFileSizeEx(file, &fileSize);
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+    mapping = size != 0u ? CreateFileMappingA(file, nullptr, PAGE_READONLY,
+            0, 0, nullptr) : nullptr;
+    data = mapping ? static_cast<const unsigned char*>(
+            MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+    const auto descriptor = ::open(fileName, O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    struct stat status;
+    size = fstat(descriptor, &status) == 0 ?
+            static_cast<std::size_t>(status.st_size) : 0u;
+    if (size != 0u) {
+        const auto mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE,
+                descriptor, 0);
+        data = mapped != MAP_FAILED ?
+                static_cast<const unsigned char*>(mapped) : nullptr;
+    }
+    ::close(descriptor);
+#endif
+    if (!data) {
+        std::cout << "Cooked mesh \"" << fileName << "\" can't be mapped\n";
+        close();
+        return false;
+    }
+
+    // Everything view() hands out is checked here
+
+    const auto candidate = reinterpret_cast<const CookedMeshHeader*>(data);
+    auto valid = size >= sizeof(CookedMeshHeader) &&
+            candidate->magic == cookedMeshMagic &&
+            candidate->version == cookedMeshVersion &&
+            candidate->vertexStride == sizeof(Vertex) &&
+            (candidate->indexSize == sizeof(std::uint16_t) ||
+            candidate->indexSize == sizeof(std::uint32_t)) &&
+            candidate->vertexCount <= UINT32_MAX &&
+            sectionFits(candidate->vertexOffset, candidate->vertexCount,
+                    sizeof(Vertex), size) &&
+            sectionFits(candidate->indexOffset, candidate->indexCount,
+                    candidate->indexSize, size) &&
+            sectionFits(candidate->submeshOffset, candidate->submeshCount,
+                    sizeof(Submesh), size) &&
+            sectionFits(candidate->lodOffset, candidate->lodCount,
+                    sizeof(MeshLod), size) &&
+            sectionFits(candidate->meshletOffset, candidate->meshletCount,
+                    sizeof(Meshlet), size);
+    if (valid) {
+        const auto submeshes = reinterpret_cast<const Submesh*>(
+                data + candidate->submeshOffset);
+        for (auto i = std::uint64_t(0); i < candidate->submeshCount; ++i) {
+            valid = valid && std::uint64_t(submeshes[i].firstIndex) +
+                    submeshes[i].indexCount <= candidate->indexCount &&
+                    (submeshes[i].indexCount == 0u ||
+                    submeshes[i].baseVertex < candidate->vertexCount);
+        }
+        const auto lods = reinterpret_cast<const MeshLod*>(
+                data + candidate->lodOffset);
+        for (auto i = std::uint64_t(0); i < candidate->lodCount; ++i) {
+            valid = valid && std::uint64_t(lods[i].firstSubmesh) +
+                    lods[i].submeshCount <= candidate->submeshCount &&
+                    std::uint64_t(lods[i].firstMeshlet) +
+                    lods[i].meshletCount <= candidate->meshletCount;
+        }
+        const auto meshlets = reinterpret_cast<const Meshlet*>(
+                data + candidate->meshletOffset);
+        for (auto i = std::uint64_t(0); i < candidate->meshletCount; ++i) {
+            valid = valid && std::uint64_t(meshlets[i].firstIndex) +
+                    meshlets[i].indexCount <= candidate->indexCount &&
+                    meshlets[i].submesh < candidate->submeshCount;
+        }
+    }
+    if (!valid) {
+        std::cout << "Cooked mesh \"" << fileName <<
+                "\" is corrupt or from another version\n";
+        close();
+        return false;
+    }
+    header = candidate;
+    return true;
+}
+
+void CookedMesh::close() noexcept {
+#ifdef _WIN32
+    if (data) {
+        UnmapViewOfFile(data);
+    }
+    if (mapping) {
+        CloseHandle(mapping);
+    }
+    if (file) {
+        CloseHandle(file);
+    }
+    file = mapping = nullptr;
+#else
+    if (data) {
+        munmap(const_cast<unsigned char*>(data), size);
+    }
+#endif
+    data = nullptr;
+    size = 0u;
+    header = nullptr;
+}
+
+MeshView CookedMesh::view() const noexcept {
+    auto result = MeshView();
+    if (!header) {
+        return result;
+    }
+    result.vertices = reinterpret_cast<const Vertex*>(
+            data + header->vertexOffset);
+    result.vertexCount = header->vertexCount;
+    result.indices = data + header->indexOffset;
+    result.indexSize = header->indexSize;
+    result.indexCount = header->indexCount;
+    result.submeshes = reinterpret_cast<const Submesh*>(
+            data + header->submeshOffset);
+    result.submeshCount = header->submeshCount;
+    result.lods = reinterpret_cast<const MeshLod*>(data + header->lodOffset);
+    result.lodCount = header->lodCount;
+    result.meshlets = reinterpret_cast<const Meshlet*>(
+            data + header->meshletOffset);
+    result.meshletCount = header->meshletCount;
+    result.boundsMin = glm::vec3(header->boundsMin[0], header->boundsMin[1],
+            header->boundsMin[2]);
+    result.boundsMax = glm::vec3(header->boundsMax[0], header->boundsMax[1],
+            header->boundsMax[2]);
+    return result;
+}
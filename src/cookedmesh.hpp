@@ -0,0 +1,66 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Cooked mesh file: the header, then the vertices, the indices, the
+// submesh table, the level of detail table and the meshlets, each starting
+// at a multiple of cookedMeshAlignment. The
+// sections are stored exactly as the GPU and Mesh use them, native little
+// endian, so a mapped file is used as is. Indices are packed, 16-bit when
+// the submeshes allow
+
+constexpr auto cookedMeshMagic = 0x4853454du; // "MESH"
+constexpr auto cookedMeshVersion = 4u;
+constexpr auto cookedMeshAlignment = std::size_t(64);
+
+struct CookedMeshHeader {
+    std::uint32_t magic = cookedMeshMagic;
+    std::uint32_t version = cookedMeshVersion;
+    std::uint32_t vertexStride = sizeof(Vertex);
+    std::uint32_t indexSize = sizeof(std::uint32_t);
+    std::uint64_t vertexOffset = 0u;
+    std::uint64_t vertexCount = 0u;
+    std::uint64_t indexOffset = 0u;
+    std::uint64_t indexCount = 0u;
+    std::uint64_t submeshOffset = 0u;
+    std::uint64_t submeshCount = 0u;
+    std::uint64_t lodOffset = 0u;
+    std::uint64_t lodCount = 0u;
+    std::uint64_t meshletOffset = 0u;
+    std::uint64_t meshletCount = 0u;
+    float boundsMin[3] = {};
+    float boundsMax[3] = {};
+};
+
+bool cookMesh(const Mesh& mesh, const char* const fileName) noexcept;
+
+// Maps a cooked mesh read only. open() validates the header and the
+// section ranges, the index values are not scanned
+
+class CookedMesh {
+public:
+    CookedMesh() noexcept = default;
+    CookedMesh(const CookedMesh&) = delete;
+    CookedMesh& operator=(const CookedMesh&) = delete;
+    ~CookedMesh() noexcept;
+
+    bool open(const char* const fileName) noexcept;
+    void close() noexcept;
+
+    bool isOpen() const noexcept { return header != nullptr; }
+
+    // Valid until close()
+    MeshView view() const noexcept;
+
+private:
+    const unsigned char* data = nullptr;
+    std::size_t size = 0u;
+    const CookedMeshHeader* header = nullptr;
+#ifdef _WIN32
+    void* file = nullptr;
+    void* mapping = nullptr;
+#endif
+};
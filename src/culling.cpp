@@ -0,0 +1,466 @@
+#include "culling.hpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULLING_AVX 1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Below this count spawning workers costs more than the test itself
+constexpr auto parallelThreshold = std::size_t(8192);
+
+Frustum extractFrustum(const glm::mat4& viewProjectionMatrix) noexcept {
+    const auto& m = viewProjectionMatrix;
+    const auto row = [&m](const int i) {
+        return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    };
+
+    auto frustum = Frustum();
+    frustum.planes[0] = row(3) + row(0); // Left
+    frustum.planes[1] = row(3) - row(0); // Right
+    frustum.planes[2] = row(3) + row(1); // Bottom
+    frustum.planes[3] = row(3) - row(1); // Top
+    frustum.planes[4] = row(3) + row(2); // Near
+    frustum.planes[5] = row(3) - row(2); // Far
+
+    for (auto& plane : frustum.planes) {
+        const auto length = std::sqrt(plane.x*plane.x +
+                plane.y*plane.y + plane.z*plane.z);
+        plane /= length;
+    }
+    return frustum;
+}
+
+void BoundingSpheres::add(const glm::vec3& center,
+        const float sphereRadius) noexcept {
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    radius.push_back(sphereRadius);
+}
+
+void BoundingSpheres::clear() noexcept {
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+}
+
+void BoundingBoxes::add(const glm::vec3& boxMin,
+        const glm::vec3& boxMax) noexcept {
+    minX.push_back(boxMin.x);
+    minY.push_back(boxMin.y);
+    minZ.push_back(boxMin.z);
+    maxX.push_back(boxMax.x);
+    maxY.push_back(boxMax.y);
+    maxZ.push_back(boxMax.z);
+}
+
+void BoundingBoxes::clear() noexcept {
+    minX.clear();
+    minY.clear();
+    minZ.clear();
+    maxX.clear();
+    maxY.clear();
+    maxZ.clear();
+}
+
+void ClusterBounds::add(const glm::vec3& center, const float radius,
+        const glm::vec3& apex, const glm::vec3& axis,
+        const float coneCutoff) noexcept {
+    spheres.add(center, radius);
+    apexX.push_back(apex.x);
+    apexY.push_back(apex.y);
+    apexZ.push_back(apex.z);
+    axisX.push_back(axis.x);
+    axisY.push_back(axis.y);
+    axisZ.push_back(axis.z);
+    cutoff.push_back(coneCutoff);
+}
+
+void ClusterBounds::clear() noexcept {
+    spheres.clear();
+    apexX.clear();
+    apexY.clear();
+    apexZ.clear();
+    axisX.clear();
+    axisY.clear();
+    axisZ.clear();
+    cutoff.clear();
+}
+
+static auto bitCount(int mask) noexcept {
+    auto count = std::size_t(0);
+    for (; mask; mask &= mask - 1) {
+        ++count;
+    }
+    return count;
+}
+
+template <typename Visible>
+static auto pushMask(Visible& visible,
+        const std::size_t base, int mask) noexcept {
+    for (auto lane = base; mask; ++lane, mask >>= 1) {
+        if (mask & 1) {
+            visible.push_back(static_cast<std::uint32_t>(lane));
+        }
+    }
+}
+
+// Sphere kernel
+
+static auto sphereVisible(const Frustum& frustum, const float x,
+        const float y, const float z, const float r) noexcept {
+    for (const auto& plane : frustum.planes) {
+        if (plane.x*x + plane.y*y + plane.z*z + plane.w < -r) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Visible>
+static auto cullSpheresRange(const Frustum& frustum,
+        const BoundingSpheres& spheres, const std::size_t begin,
+        const std::size_t end, Visible& visible) noexcept {
+    auto i = begin;
+#if defined(CULLING_AVX)
+    for (; i + 8 <= end; i += 8) {
+        const auto x = _mm256_loadu_ps(spheres.centerX.data() + i);
+        const auto y = _mm256_loadu_ps(spheres.centerY.data() + i);
+        const auto z = _mm256_loadu_ps(spheres.centerZ.data() + i);
+        const auto r = _mm256_loadu_ps(spheres.radius.data() + i);
+        const auto negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            auto d = _mm256_add_ps(
+                    _mm256_mul_ps(x, _mm256_set1_ps(plane.x)),
+                    _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+            d = _mm256_add_ps(d, _mm256_set1_ps(plane.w));
+            inside = _mm256_and_ps(inside,
+                    _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+        pushMask(visible, i, _mm256_movemask_ps(inside));
+    }
+#elif defined(CULLING_SSE)
+    for (; i + 4 <= end; i += 4) {
+        const auto x = _mm_loadu_ps(spheres.centerX.data() + i);
+        const auto y = _mm_loadu_ps(spheres.centerY.data() + i);
+        const auto z = _mm_loadu_ps(spheres.centerZ.data() + i);
+        const auto r = _mm_loadu_ps(spheres.radius.data() + i);
+        const auto negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            auto d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                    _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+            d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+            d = _mm_add_ps(d, _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        pushMask(visible, i, _mm_movemask_ps(inside));
+    }
+#endif
+    for (; i < end; ++i) {
+        if (sphereVisible(frustum, spheres.centerX[i], spheres.centerY[i],
+                spheres.centerZ[i], spheres.radius[i])) {
+            visible.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+// Box kernel, tests the center/extents form against each plane
+
+static auto boxVisible(const Frustum& frustum, const BoundingBoxes& boxes,
+        const std::size_t i) noexcept {
+    const auto cx = (boxes.minX[i] + boxes.maxX[i])*.5f;
+    const auto cy = (boxes.minY[i] + boxes.maxY[i])*.5f;
+    const auto cz = (boxes.minZ[i] + boxes.maxZ[i])*.5f;
+    const auto ex = (boxes.maxX[i] - boxes.minX[i])*.5f;
+    const auto ey = (boxes.maxY[i] - boxes.minY[i])*.5f;
+    const auto ez = (boxes.maxZ[i] - boxes.minZ[i])*.5f;
+    for (const auto& plane : frustum.planes) {
+        const auto d = plane.x*cx + plane.y*cy + plane.z*cz + plane.w;
+        const auto r = std::fabs(plane.x)*ex + std::fabs(plane.y)*ey +
+                std::fabs(plane.z)*ez;
+        if (d < -r) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Visible>
+static auto cullBoxesRange(const Frustum& frustum,
+        const BoundingBoxes& boxes, const std::size_t begin,
+        const std::size_t end, Visible& visible) noexcept {
+    auto i = begin;
+#if defined(CULLING_AVX)
+    const auto half = _mm256_set1_ps(.5f);
+    for (; i + 8 <= end; i += 8) {
+        const auto minX = _mm256_loadu_ps(boxes.minX.data() + i);
+        const auto minY = _mm256_loadu_ps(boxes.minY.data() + i);
+        const auto minZ = _mm256_loadu_ps(boxes.minZ.data() + i);
+        const auto maxX = _mm256_loadu_ps(boxes.maxX.data() + i);
+        const auto maxY = _mm256_loadu_ps(boxes.maxY.data() + i);
+        const auto maxZ = _mm256_loadu_ps(boxes.maxZ.data() + i);
+        const auto cx = _mm256_mul_ps(_mm256_add_ps(minX, maxX), half);
+        const auto cy = _mm256_mul_ps(_mm256_add_ps(minY, maxY), half);
+        const auto cz = _mm256_mul_ps(_mm256_add_ps(minZ, maxZ), half);
+        const auto ex = _mm256_mul_ps(_mm256_sub_ps(maxX, minX), half);
+        const auto ey = _mm256_mul_ps(_mm256_sub_ps(maxY, minY), half);
+        const auto ez = _mm256_mul_ps(_mm256_sub_ps(maxZ, minZ), half);
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            auto d = _mm256_add_ps(
+                    _mm256_mul_ps(cx, _mm256_set1_ps(plane.x)),
+                    _mm256_mul_ps(cy, _mm256_set1_ps(plane.y)));
+            d = _mm256_add_ps(d,
+                    _mm256_mul_ps(cz, _mm256_set1_ps(plane.z)));
+            d = _mm256_add_ps(d, _mm256_set1_ps(plane.w));
+            auto r = _mm256_add_ps(
+                    _mm256_mul_ps(ex, _mm256_set1_ps(std::fabs(plane.x))),
+                    _mm256_mul_ps(ey, _mm256_set1_ps(std::fabs(plane.y))));
+            r = _mm256_add_ps(r,
+                    _mm256_mul_ps(ez, _mm256_set1_ps(std::fabs(plane.z))));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(d,
+                    _mm256_sub_ps(_mm256_setzero_ps(), r), _CMP_GE_OQ));
+        }
+        pushMask(visible, i, _mm256_movemask_ps(inside));
+    }
+#elif defined(CULLING_SSE)
+    const auto half = _mm_set1_ps(.5f);
+    for (; i + 4 <= end; i += 4) {
+        const auto minX = _mm_loadu_ps(boxes.minX.data() + i);
+        const auto minY = _mm_loadu_ps(boxes.minY.data() + i);
+        const auto minZ = _mm_loadu_ps(boxes.minZ.data() + i);
+        const auto maxX = _mm_loadu_ps(boxes.maxX.data() + i);
+        const auto maxY = _mm_loadu_ps(boxes.maxY.data() + i);
+        const auto maxZ = _mm_loadu_ps(boxes.maxZ.data() + i);
+        const auto cx = _mm_mul_ps(_mm_add_ps(minX, maxX), half);
+        const auto cy = _mm_mul_ps(_mm_add_ps(minY, maxY), half);
+        const auto cz = _mm_mul_ps(_mm_add_ps(minZ, maxZ), half);
+        const auto ex = _mm_mul_ps(_mm_sub_ps(maxX, minX), half);
+        const auto ey = _mm_mul_ps(_mm_sub_ps(maxY, minY), half);
+        const auto ez = _mm_mul_ps(_mm_sub_ps(maxZ, minZ), half);
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            auto d = _mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(plane.x)),
+                    _mm_mul_ps(cy, _mm_set1_ps(plane.y)));
+            d = _mm_add_ps(d, _mm_mul_ps(cz, _mm_set1_ps(plane.z)));
+            d = _mm_add_ps(d, _mm_set1_ps(plane.w));
+            auto r = _mm_add_ps(
+                    _mm_mul_ps(ex, _mm_set1_ps(std::fabs(plane.x))),
+                    _mm_mul_ps(ey, _mm_set1_ps(std::fabs(plane.y))));
+            r = _mm_add_ps(r, _mm_mul_ps(ez, _mm_set1_ps(std::fabs(plane.z))));
+            inside = _mm_and_ps(inside,
+                    _mm_cmpge_ps(d, _mm_sub_ps(_mm_setzero_ps(), r)));
+        }
+        pushMask(visible, i, _mm_movemask_ps(inside));
+    }
+#endif
+    for (; i < end; ++i) {
+        if (boxVisible(frustum, boxes, i)) {
+            visible.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+}
+
+// Cluster kernel, the sphere test and then the cone: the cluster faces
+// away when dot(apex - eye, axis) >= cutoff*length(apex - eye)
+
+static auto coneBackfacing(const ClusterBounds& clusters,
+        const glm::vec3& eye, const std::size_t i) noexcept {
+    const auto x = clusters.apexX[i] - eye.x;
+    const auto y = clusters.apexY[i] - eye.y;
+    const auto z = clusters.apexZ[i] - eye.z;
+    return x*clusters.axisX[i] + y*clusters.axisY[i] +
+            z*clusters.axisZ[i] >=
+            clusters.cutoff[i]*std::sqrt(x*x + y*y + z*z);
+}
+
+// Splits [0, count) across the cores, every worker fills its own list and
+// the lists are concatenated in order so the output stays sorted
+
+template <typename Kernel>
+static auto cullParallel(const std::size_t count,
+        std::vector<std::uint32_t>& visible, CullStats& stats,
+        JobSystem* const jobs, LinearArena* const arena,
+        const Kernel& kernel) noexcept {
+    visible.clear();
+    const auto workerCount = jobs ? jobs->workerCount() :
+            std::max(1u, std::thread::hardware_concurrency());
+    if (count < parallelThreshold || workerCount == 1) {
+        kernel(0, count, visible);
+    }
+    else {
+        // Chunks are multiples of 8 so no SIMD batch straddles two workers
+        const auto chunk = ((count + workerCount - 1)/workerCount + 7) &
+                ~std::size_t(7);
+        // Worker lists are reserved for the whole chunk up front, so the
+        // workers never allocate and can share the caller's arena
+        auto partials = ArenaVector<ArenaVector<std::uint32_t>>(arena);
+        partials.reserve(workerCount);
+        auto counter = JobCounter();
+        auto workers = std::vector<std::thread>();
+        for (auto worker = 0u; worker < workerCount; ++worker) {
+            partials.emplace_back(ArenaAllocator<std::uint32_t>(arena));
+        }
+        for (auto worker = 1u; worker < workerCount; ++worker) {
+            const auto begin = std::min(count, worker*chunk);
+            const auto end = std::min(count, begin + chunk);
+            partials[worker].reserve(end - begin);
+            const auto cullChunk = [&kernel, &partials, worker, begin, end] {
+                kernel(begin, end, partials[worker]);
+            };
+            if (jobs) {
+                jobs->run(counter, cullChunk);
+            }
+            else {
+                workers.emplace_back(cullChunk);
+            }
+        }
+        kernel(0, std::min(count, chunk), visible);
+        if (jobs) {
+            jobs->wait(counter);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        for (auto worker = 1u; worker < workerCount; ++worker) {
+            visible.insert(visible.end(),
+                    partials[worker].begin(), partials[worker].end());
+        }
+    }
+    stats.tested += count;
+    stats.visible += visible.size();
+}
+
+void cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres,
+        std::vector<std::uint32_t>& visible, CullStats& stats,
+        JobSystem* const jobs, LinearArena* const arena) noexcept {
+    cullParallel(spheres.size(), visible, stats, jobs, arena,
+            [&frustum, &spheres](const std::size_t begin,
+                    const std::size_t end, auto& out) {
+        cullSpheresRange(frustum, spheres, begin, end, out);
+    });
+}
+
+void cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes,
+        std::vector<std::uint32_t>& visible, CullStats& stats,
+        JobSystem* const jobs, LinearArena* const arena) noexcept {
+    cullParallel(boxes.size(), visible, stats, jobs, arena,
+            [&frustum, &boxes](const std::size_t begin,
+                    const std::size_t end, auto& out) {
+        cullBoxesRange(frustum, boxes, begin, end, out);
+    });
+}
+
+void cullClusters(const Frustum& frustum, const glm::vec3& eye,
+        const ClusterBounds& clusters, const std::size_t begin,
+        const std::size_t end, std::vector<std::uint32_t>& visible,
+        CullStats& stats) noexcept {
+    visible.clear();
+    const auto& spheres = clusters.spheres;
+    auto backfacing = std::size_t(0);
+    auto i = begin;
+#if defined(CULLING_AVX)
+    const auto eyeX = _mm256_set1_ps(eye.x);
+    const auto eyeY = _mm256_set1_ps(eye.y);
+    const auto eyeZ = _mm256_set1_ps(eye.z);
+    for (; i + 8 <= end; i += 8) {
+        const auto x = _mm256_loadu_ps(spheres.centerX.data() + i);
+        const auto y = _mm256_loadu_ps(spheres.centerY.data() + i);
+        const auto z = _mm256_loadu_ps(spheres.centerZ.data() + i);
+        const auto r = _mm256_loadu_ps(spheres.radius.data() + i);
+        const auto negR = _mm256_sub_ps(_mm256_setzero_ps(), r);
+        auto inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            auto d = _mm256_add_ps(
+                    _mm256_mul_ps(x, _mm256_set1_ps(plane.x)),
+                    _mm256_mul_ps(y, _mm256_set1_ps(plane.y)));
+            d = _mm256_add_ps(d, _mm256_mul_ps(z, _mm256_set1_ps(plane.z)));
+            d = _mm256_add_ps(d, _mm256_set1_ps(plane.w));
+            inside = _mm256_and_ps(inside,
+                    _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+        }
+        const auto dx = _mm256_sub_ps(
+                _mm256_loadu_ps(clusters.apexX.data() + i), eyeX);
+        const auto dy = _mm256_sub_ps(
+                _mm256_loadu_ps(clusters.apexY.data() + i), eyeY);
+        const auto dz = _mm256_sub_ps(
+                _mm256_loadu_ps(clusters.apexZ.data() + i), eyeZ);
+        auto d = _mm256_add_ps(
+                _mm256_mul_ps(dx, _mm256_loadu_ps(clusters.axisX.data() + i)),
+                _mm256_mul_ps(dy, _mm256_loadu_ps(clusters.axisY.data() + i)));
+        d = _mm256_add_ps(d,
+                _mm256_mul_ps(dz, _mm256_loadu_ps(clusters.axisZ.data() + i)));
+        auto length = _mm256_add_ps(_mm256_mul_ps(dx, dx),
+                _mm256_mul_ps(dy, dy));
+        length = _mm256_sqrt_ps(_mm256_add_ps(length, _mm256_mul_ps(dz, dz)));
+        const auto away = _mm256_and_ps(inside, _mm256_cmp_ps(d,
+                _mm256_mul_ps(_mm256_loadu_ps(clusters.cutoff.data() + i),
+                        length), _CMP_GE_OQ));
+        backfacing += bitCount(_mm256_movemask_ps(away));
+        pushMask(visible, i, _mm256_movemask_ps(
+                _mm256_andnot_ps(away, inside)));
+    }
+#elif defined(CULLING_SSE)
+    const auto eyeX = _mm_set1_ps(eye.x);
+    const auto eyeY = _mm_set1_ps(eye.y);
+    const auto eyeZ = _mm_set1_ps(eye.z);
+    for (; i + 4 <= end; i += 4) {
+        const auto x = _mm_loadu_ps(spheres.centerX.data() + i);
+        const auto y = _mm_loadu_ps(spheres.centerY.data() + i);
+        const auto z = _mm_loadu_ps(spheres.centerZ.data() + i);
+        const auto r = _mm_loadu_ps(spheres.radius.data() + i);
+        const auto negR = _mm_sub_ps(_mm_setzero_ps(), r);
+        auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            auto d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                    _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+            d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+            d = _mm_add_ps(d, _mm_set1_ps(plane.w));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        const auto dx = _mm_sub_ps(_mm_loadu_ps(clusters.apexX.data() + i),
+                eyeX);
+        const auto dy = _mm_sub_ps(_mm_loadu_ps(clusters.apexY.data() + i),
+                eyeY);
+        const auto dz = _mm_sub_ps(_mm_loadu_ps(clusters.apexZ.data() + i),
+                eyeZ);
+        auto d = _mm_add_ps(
+                _mm_mul_ps(dx, _mm_loadu_ps(clusters.axisX.data() + i)),
+                _mm_mul_ps(dy, _mm_loadu_ps(clusters.axisY.data() + i)));
+        d = _mm_add_ps(d,
+                _mm_mul_ps(dz, _mm_loadu_ps(clusters.axisZ.data() + i)));
+        auto length = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        length = _mm_sqrt_ps(_mm_add_ps(length, _mm_mul_ps(dz, dz)));
+        const auto away = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_mul_ps(
+                _mm_loadu_ps(clusters.cutoff.data() + i), length)));
+        backfacing += bitCount(_mm_movemask_ps(away));
+        pushMask(visible, i, _mm_movemask_ps(_mm_andnot_ps(away, inside)));
+    }
+#endif
+    for (; i < end; ++i) {
+        if (sphereVisible(frustum, spheres.centerX[i], spheres.centerY[i],
+                spheres.centerZ[i], spheres.radius[i])) {
+            if (coneBackfacing(clusters, eye, i)) {
+                ++backfacing;
+            }
+            else {
+                visible.push_back(static_cast<std::uint32_t>(i));
+            }
+        }
+    }
+    stats.tested += end - begin;
+    stats.visible += visible.size();
+    stats.backfacing += backfacing;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "framearena.hpp"
+#include "jobsystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Frustum planes as (normal, distance), normals point inside
+
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+Frustum extractFrustum(const glm::mat4& viewProjectionMatrix) noexcept;
+
+// Bounding volumes in SoA layout so that several objects are tested at once
+
+struct BoundingSpheres {
+    std::vector<float> centerX;
+    std::vector<float> centerY;
+    std::vector<float> centerZ;
+    std::vector<float> radius;
+
+    void add(const glm::vec3& center, const float sphereRadius) noexcept;
+    void clear() noexcept;
+    std::size_t size() const noexcept { return radius.size(); }
+};
+
+struct BoundingBoxes {
+    std::vector<float> minX;
+    std::vector<float> minY;
+    std::vector<float> minZ;
+    std::vector<float> maxX;
+    std::vector<float> maxY;
+    std::vector<float> maxZ;
+
+    void add(const glm::vec3& boxMin, const glm::vec3& boxMax) noexcept;
+    void clear() noexcept;
+    std::size_t size() const noexcept { return minX.size(); }
+};
+
+// Clusters of a mesh, spheres plus the cone of their triangles' normals,
+// see Meshlet
+struct ClusterBounds {
+    BoundingSpheres spheres;
+    std::vector<float> apexX;
+    std::vector<float> apexY;
+    std::vector<float> apexZ;
+    std::vector<float> axisX;
+    std::vector<float> axisY;
+    std::vector<float> axisZ;
+    std::vector<float> cutoff;
+
+    void add(const glm::vec3& center, const float radius,
+            const glm::vec3& apex, const glm::vec3& axis,
+            const float coneCutoff) noexcept;
+    void clear() noexcept;
+    std::size_t size() const noexcept { return cutoff.size(); }
+};
+
+struct CullStats {
+    std::size_t tested = 0;
+    std::size_t visible = 0;
+    std::size_t backfacing = 0; // Clusters in the frustum facing away
+};
+
+// Writes indices of the objects intersecting the frustum into visible
+// (ascending order) and adds to the stats counters. Large sets are split
+// across the job system's workers, or plain threads without one. The
+// workers' lists come from arena when given, the heap otherwise
+
+void cullSpheres(const Frustum& frustum, const BoundingSpheres& spheres,
+        std::vector<std::uint32_t>& visible, CullStats& stats,
+        JobSystem* const jobs = nullptr,
+        LinearArena* const arena = nullptr) noexcept;
+
+void cullBoxes(const Frustum& frustum, const BoundingBoxes& boxes,
+        std::vector<std::uint32_t>& visible, CullStats& stats,
+        JobSystem* const jobs = nullptr,
+        LinearArena* const arena = nullptr) noexcept;
+
+// Clusters [begin, end) that intersect the frustum and face the eye at
+// least partly, on the calling thread. Frustum and eye are in the
+// clusters' space, cones assume that space is not scaled non-uniformly
+void cullClusters(const Frustum& frustum, const glm::vec3& eye,
+        const ClusterBounds& clusters, const std::size_t begin,
+        const std::size_t end, std::vector<std::uint32_t>& visible,
+        CullStats& stats) noexcept;
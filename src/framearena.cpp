@@ -0,0 +1,111 @@
+#include "framearena.hpp"
+
+#include "jobsystem.hpp"
+
+#include <algorithm>
+
+constexpr auto minimumOverflowBlock = std::size_t(64) << 10;
+
+static auto alignUp(unsigned char* const pointer,
+        const std::size_t alignment) noexcept {
+    const auto address = reinterpret_cast<std::uintptr_t>(pointer);
+    return pointer + ((alignment - address%alignment)%alignment);
+}
+
+// Linear arena
+
+LinearArena::LinearArena(const std::size_t capacity) noexcept {
+    if (capacity != 0u) {
+        block = std::make_unique<unsigned char[]>(capacity);
+        begin = block.get();
+        top = begin;
+        end = begin + capacity;
+        arenaStats.capacity = capacity;
+    }
+}
+
+void LinearArena::grow(const std::size_t size,
+        const std::size_t alignment) noexcept {
+    const auto blockSize = std::max(size + alignment,
+            std::max(arenaStats.capacity, minimumOverflowBlock));
+    overflow.push_back(std::make_unique<unsigned char[]>(blockSize));
+    begin = overflow.back().get();
+    top = begin;
+    end = begin + blockSize;
+    ++arenaStats.heapAllocations;
+}
+
+void* LinearArena::allocate(const std::size_t size,
+        const std::size_t alignment) noexcept {
+    auto pointer = alignUp(top, alignment);
+    if (!top || pointer > end || size > std::size_t(end - pointer)) {
+        grow(size, alignment);
+        pointer = alignUp(top, alignment);
+    }
+    arenaStats.used += std::size_t(pointer - top) + size;
+    arenaStats.peak = std::max(arenaStats.peak, arenaStats.used);
+    top = pointer + size;
+    return pointer;
+}
+
+void LinearArena::deallocate(void* const pointer,
+        const std::size_t size) noexcept {
+    const auto bytes = static_cast<unsigned char*>(pointer);
+    if (bytes + size == top) {
+        top = bytes;
+        arenaStats.used -= size;
+    }
+}
+
+void LinearArena::reset() noexcept {
+    if (!overflow.empty()) {
+        // Room for the peak and the alignment padding of a different layout
+        const auto capacity = arenaStats.peak + arenaStats.peak/8u;
+        overflow.clear();
+        block = std::make_unique<unsigned char[]>(capacity);
+        arenaStats.capacity = capacity;
+    }
+    begin = block.get();
+    top = begin;
+    end = begin + arenaStats.capacity;
+    arenaStats.used = 0u;
+    arenaStats.heapAllocations = 0u;
+}
+
+// Frame arenas
+
+FrameArenas::FrameArenas(const int frameCount, const unsigned threadCount,
+        const std::size_t bytesPerArena) noexcept : threads(threadCount) {
+    arenas.reserve(std::size_t(frameCount)*threadCount);
+    for (auto index = 0u; index < unsigned(frameCount)*threadCount; ++index) {
+        arenas.emplace_back(bytesPerArena);
+    }
+}
+
+void FrameArenas::beginFrame(const int slot) noexcept {
+    if (currentSlot != -1) {
+        auto frameStats = ArenaStats();
+        for (auto thread = 0u; thread < threads; ++thread) {
+            const auto& stats = arena(thread).stats();
+            frameStats.used += stats.used;
+            frameStats.capacity += stats.capacity;
+            frameStats.heapAllocations += stats.heapAllocations;
+        }
+        peakBytes = std::max(peakBytes, frameStats.used);
+        frameStats.peak = peakBytes;
+        lastFrameStats = frameStats;
+    }
+
+    currentSlot = slot;
+    for (auto thread = 0u; thread < threads; ++thread) {
+        arena(thread).reset();
+    }
+}
+
+LinearArena& FrameArenas::local() noexcept {
+    return arena(JobSystem::workerIndex());
+}
+
+LinearArena& FrameArenas::arena(const unsigned thread) noexcept {
+    return arenas[std::size_t(currentSlot)*threads + thread];
+}
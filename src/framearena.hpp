@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+struct ArenaStats {
+    std::size_t used = 0u;            // Bytes handed out since the reset
+    std::size_t peak = 0u;            // Highest used of any frame
+    std::size_t capacity = 0u;
+    std::size_t heapAllocations = 0u; // Since the reset, 0 in steady state
+};
+
+// Bump allocator, reset() drops all allocations at once. When the block runs
+// out the arena takes overflow blocks from the heap, the next reset()
+// replaces them with one block that fits the peak so the following frames
+// do not touch the heap. Aligned so arenas of different threads do not
+// share cache lines
+
+class alignas(64) LinearArena {
+public:
+    explicit LinearArena(const std::size_t capacity = 0u) noexcept;
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+    LinearArena(LinearArena&&) noexcept = default;
+    LinearArena& operator=(LinearArena&&) noexcept = default;
+
+    void* allocate(const std::size_t size,
+            const std::size_t alignment = alignof(std::max_align_t)) noexcept;
+
+    // Only the most recent allocation is given back, which is what a
+    // growing vector does
+    void deallocate(void* const pointer, const std::size_t size) noexcept;
+
+    void reset() noexcept;
+
+    const ArenaStats& stats() const noexcept { return arenaStats; }
+
+private:
+    void grow(const std::size_t size, const std::size_t alignment) noexcept;
+
+    std::unique_ptr<unsigned char[]> block;
+    std::vector<std::unique_ptr<unsigned char[]>> overflow;
+    unsigned char* begin = nullptr;
+    unsigned char* top = nullptr;
+    unsigned char* end = nullptr;
+    ArenaStats arenaStats;
+};
+
+// STL allocator over an arena, a null arena means the general heap so
+// containers can be default constructed outside the frame
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    ArenaAllocator(LinearArena* const arena = nullptr) noexcept
+        : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+        : arena(other.arena) {}
+
+    T* allocate(const std::size_t count) noexcept {
+        if (arena) {
+            return static_cast<T*>(
+                    arena->allocate(count*sizeof(T), alignof(T)));
+        }
+        return static_cast<T*>(::operator new(count*sizeof(T)));
+    }
+
+    void deallocate(T* const pointer, const std::size_t count) noexcept {
+        if (arena) {
+            arena->deallocate(pointer, count*sizeof(T));
+        }
+        else {
+            ::operator delete(pointer);
+        }
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const noexcept {
+        return arena == other.arena;
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const noexcept {
+        return arena != other.arena;
+    }
+
+    LinearArena* arena;
+};
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// One arena per frame slot and worker thread. A slot is reset when it comes
+// around again, frameCount frames later, so data built for the render thread
+// stays valid until the render thread is done with the slot
+
+class FrameArenas {
+public:
+    FrameArenas(const int frameCount, const unsigned threadCount,
+            const std::size_t bytesPerArena = std::size_t(1) << 20) noexcept;
+
+    // Call from the thread that builds the frames, before any job of the
+    // frame runs. Also closes the stats of the previous frame
+    void beginFrame(const int slot) noexcept;
+
+    // Arena of the calling job system worker, threads outside the job
+    // system share worker 0's arena
+    LinearArena& local() noexcept;
+    LinearArena& arena(const unsigned thread) noexcept;
+
+    // Totals over the threads, lastFrame is the frame before the current one
+    const ArenaStats& lastFrame() const noexcept { return lastFrameStats; }
+    std::size_t peak() const noexcept { return peakBytes; }
+
+private:
+    std::vector<LinearArena> arenas;
+    unsigned threads;
+    int currentSlot = -1;
+    ArenaStats lastFrameStats;
+    std::size_t peakBytes = 0u;
+};
@@ -0,0 +1,105 @@
+#include "framepacer.hpp"
+
+#include <algorithm>
+#include <thread>
+
+// The OS wakes sleepers late by up to a scheduler tick, the rest of the
+// wait spins
+constexpr auto spinTime = std::chrono::microseconds(2000);
+
+FramePacer::FramePacer(const FramePacingOptions& options) noexcept
+    : pacing(options) {
+    pacing.maxFramesInFlight = std::min(std::max(pacing.maxFramesInFlight, 1),
+            maxFramesInFlight);
+}
+
+FramePacer::~FramePacer() noexcept {
+    destroy();
+}
+
+void FramePacer::applySwapMode() noexcept {
+    switch (pacing.swapMode) {
+    case SwapMode::VSync:
+        glfwSwapInterval(1);
+        break;
+    case SwapMode::AdaptiveVSync:
+        if (glfwExtensionSupported("WGL_EXT_swap_control_tear") ||
+                glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+            glfwSwapInterval(-1);
+        }
+        else {
+            glfwSwapInterval(1);
+        }
+        break;
+    case SwapMode::Uncapped:
+        glfwSwapInterval(0);
+        break;
+    }
+}
+
+void FramePacer::beginFrame() noexcept {
+    // The fence of the frame maxFramesInFlight frames ago
+    auto& fence = fences[fenceIndex];
+    if (!fence) {
+        return;
+    }
+
+    auto status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        const auto start = Clock::now();
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                    GLuint64(1000000));
+        } while (status == GL_TIMEOUT_EXPIRED);
+
+        ++pacingStats.gpuWaits;
+        pacingStats.gpuWaitMilliseconds += std::chrono::duration<double,
+                std::milli>(Clock::now() - start).count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void FramePacer::endFrame(const Clock::time_point inputTime) noexcept {
+    fences[fenceIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    fenceIndex = (fenceIndex + 1)%pacing.maxFramesInFlight;
+
+    const auto latency = std::chrono::duration<double, std::milli>(
+            Clock::now() - inputTime).count();
+    ++pacingStats.frames;
+    pacingStats.latencyMilliseconds += latency;
+    pacingStats.maxLatencyMilliseconds = std::max(
+            pacingStats.maxLatencyMilliseconds, latency);
+}
+
+void FramePacer::limitFrameRate() noexcept {
+    if (pacing.maxFrameRate <= 0.) {
+        return;
+    }
+    const auto period = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1./pacing.maxFrameRate));
+
+    const auto now = Clock::now();
+    if (nextFrame.time_since_epoch().count() == 0 || now - nextFrame > period) {
+        // First frame or far behind, do not try to catch up
+        nextFrame = now + period;
+        return;
+    }
+
+    if (nextFrame - now > spinTime) {
+        std::this_thread::sleep_until(nextFrame - spinTime);
+    }
+    while (Clock::now() < nextFrame) {
+        std::this_thread::yield();
+    }
+    nextFrame += period;
+}
+
+void FramePacer::destroy() noexcept {
+    for (auto& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstddef>
+
+enum class SwapMode {
+    VSync,
+    AdaptiveVSync, // Tears instead of waiting when a frame is late
+    Uncapped
+};
+
+struct FramePacingOptions {
+    SwapMode swapMode = SwapMode::VSync;
+
+    // Frames the GPU may have queued, 1 - lowest latency, the CPU waits for
+    // the GPU every frame, more - throughput
+    int maxFramesInFlight = 2;
+
+    // 0 - no cap
+    double maxFrameRate = 0.;
+};
+
+struct FramePacingStats {
+    std::size_t frames = 0u;
+    std::size_t gpuWaits = 0u; // beginFrame() found too many frames queued
+    double gpuWaitMilliseconds = 0.;
+    double latencyMilliseconds = 0.; // Sum over the frames
+    double maxLatencyMilliseconds = 0.;
+
+    double averageLatency() const noexcept {
+        return frames != 0u ? latencyMilliseconds/frames : 0.;
+    }
+};
+
+// Paces frames in three places: the swap interval, a fence per frame that
+// bounds how far the GPU queue may run behind, and an optional frame rate
+// cap for the thread that builds frames. Latency is measured from the input
+// sample to SwapBuffers returning, the point the frame is queued for
+// presentation
+
+class FramePacer {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr auto maxFramesInFlight = 4;
+
+    explicit FramePacer(
+            const FramePacingOptions& options = FramePacingOptions()) noexcept;
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+    ~FramePacer() noexcept;
+
+    // Context thread. Adaptive vsync falls back to vsync without the
+    // swap_control_tear extension
+    void applySwapMode() noexcept;
+
+    // Context thread, around the frame's GL work, endFrame() after swap
+    void beginFrame() noexcept;
+    void endFrame(const Clock::time_point inputTime) noexcept;
+
+    // Frame building thread, sleeps until the next frame is due
+    void limitFrameRate() noexcept;
+
+    // Context thread, deletes the fences
+    void destroy() noexcept;
+
+    const FramePacingOptions& options() const noexcept { return pacing; }
+    const FramePacingStats& stats() const noexcept { return pacingStats; }
+
+private:
+    FramePacingOptions pacing;
+    FramePacingStats pacingStats;
+    GLsync fences[maxFramesInFlight] = {};
+    int fenceIndex = 0;
+    Clock::time_point nextFrame;
+};
@@ -0,0 +1,101 @@
+#include "glstatecache.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+// Bindings nobody could have made, so the first real call always goes out
+constexpr auto unknown = GLuint(-1);
+
+static auto targetSlot(const GLenum target) noexcept {
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_2D_ARRAY:
+        return 1;
+    case GL_TEXTURE_CUBE_MAP:
+        return 2;
+    case GL_TEXTURE_3D:
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+GLStateCache::GLStateCache() noexcept {
+    invalidate();
+}
+
+void GLStateCache::useProgram(const GLuint newProgram) noexcept {
+    if (newProgram == program) {
+        ++cacheStats.filtered;
+        return;
+    }
+    glUseProgram(newProgram);
+    program = newProgram;
+    ++cacheStats.issued;
+}
+
+void GLStateCache::activeTexture(const GLenum texture) noexcept {
+    if (texture == activeUnit) {
+        ++cacheStats.filtered;
+        return;
+    }
+    glActiveTexture(texture);
+    activeUnit = texture;
+    ++cacheStats.issued;
+}
+
+void GLStateCache::bindTexture(const GLenum target,
+        const GLuint texture) noexcept {
+    const auto unit = activeUnit - GL_TEXTURE0;
+    const auto slot = targetSlot(target);
+    if (unit >= GLenum(maxTextureUnits) || slot < 0) {
+        glBindTexture(target, texture);
+        ++cacheStats.issued;
+        return;
+    }
+    if (textures[unit][slot] == texture) {
+        ++cacheStats.filtered;
+        return;
+    }
+    glBindTexture(target, texture);
+    textures[unit][slot] = texture;
+    ++cacheStats.issued;
+}
+
+void GLStateCache::bindTextureUnit(const GLuint unit, const GLenum target,
+        const GLuint texture) noexcept {
+    const auto slot = targetSlot(target);
+    if (unit < GLuint(maxTextureUnits) && slot >= 0 &&
+            textures[unit][slot] == texture) {
+        ++cacheStats.filtered;
+        return;
+    }
+    activeTexture(GL_TEXTURE0 + unit);
+    bindTexture(target, texture);
+}
+
+void GLStateCache::bindVertexArray(const GLuint vao) noexcept {
+    if (vao == vertexArray) {
+        ++cacheStats.filtered;
+        return;
+    }
+    glBindVertexArray(vao);
+    vertexArray = vao;
+    ++cacheStats.issued;
+}
+
+void GLStateCache::forgetTexture(const GLuint texture) noexcept {
+    for (auto& unit : textures) {
+        std::replace(std::begin(unit), std::end(unit), texture, GLuint(0));
+    }
+}
+
+void GLStateCache::invalidate() noexcept {
+    program = unknown;
+    activeUnit = unknown;
+    for (auto& unit : textures) {
+        std::fill(std::begin(unit), std::end(unit), unknown);
+    }
+    vertexArray = unknown;
+}
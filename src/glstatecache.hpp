@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+
+struct GLStateCacheStats {
+    std::size_t issued = 0;
+    std::size_t filtered = 0;
+};
+
+// Shadow copy of the bindings we change often. Calls that would not change
+// the state are dropped. Code that binds through plain GL calls must call
+// invalidate() afterwards
+
+class GLStateCache {
+public:
+    static constexpr auto maxTextureUnits = 32;
+
+    GLStateCache() noexcept;
+
+    void useProgram(const GLuint program) noexcept;
+    void activeTexture(const GLenum texture) noexcept;
+    void bindTexture(const GLenum target, const GLuint texture) noexcept;
+    void bindTextureUnit(const GLuint unit, const GLenum target,
+            const GLuint texture) noexcept;
+    void bindVertexArray(const GLuint vao) noexcept;
+
+    // Deleting a texture unbinds it and frees its name for reuse, call
+    // this before glDeleteTextures
+    void forgetTexture(const GLuint texture) noexcept;
+
+    void invalidate() noexcept;
+
+    const GLStateCacheStats& stats() const noexcept { return cacheStats; }
+    void resetStats() noexcept { cacheStats = GLStateCacheStats(); }
+
+private:
+    static constexpr auto cachedTargets = 4;
+
+    GLuint program;
+    GLenum activeUnit;
+    GLuint textures[maxTextureUnits][cachedTargets];
+    GLuint vertexArray;
+    GLStateCacheStats cacheStats;
+};
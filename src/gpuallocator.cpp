@@ -0,0 +1,464 @@
+#include "gpuallocator.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+
+constexpr auto granularity = 4u;
+
+static auto highestBit(const std::uint32_t value) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse(&index, value);
+    return static_cast<std::uint32_t>(index);
+#else
+    return static_cast<std::uint32_t>(31 - __builtin_clz(value));
+#endif
+}
+
+static auto lowestBit(const std::uint32_t value) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<std::uint32_t>(index);
+#else
+    return static_cast<std::uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+static auto roundUp(const std::uint32_t value,
+        const std::uint32_t multiple) noexcept {
+    return (value + multiple - 1u)/multiple*multiple;
+}
+
+// TLSF
+
+TlsfAllocator::TlsfAllocator(const std::uint32_t capacity) noexcept
+    : totalSize(capacity/granularity*granularity) {
+    for (auto& firstLevel : heads) {
+        std::fill(std::begin(firstLevel), std::end(firstLevel), invalid);
+    }
+    if (totalSize != 0u) {
+        insertFree(createBlock(0u, totalSize));
+    }
+}
+
+std::uint32_t TlsfAllocator::createBlock(const std::uint32_t offset,
+        const std::uint32_t size) noexcept {
+    auto block = invalid;
+    if (!unusedBlocks.empty()) {
+        block = unusedBlocks.back();
+        unusedBlocks.pop_back();
+    }
+    else {
+        block = static_cast<std::uint32_t>(blocks.size());
+        blocks.emplace_back();
+    }
+    blocks[block] = Block{ offset, size, invalid, invalid,
+            invalid, invalid, false };
+    return block;
+}
+
+void TlsfAllocator::destroyBlock(const std::uint32_t block) noexcept {
+    unusedBlocks.push_back(block);
+}
+
+// Size class of a block, the first level is the power of two and the
+// second level the next secondLevelBits bits. Sizes below
+// 1 << firstLevelShift share first level 0 in steps of granularity
+
+static auto sizeClass(const std::uint32_t size, const unsigned secondBits,
+        const unsigned firstShift, std::uint32_t& firstLevel,
+        std::uint32_t& secondLevel) noexcept {
+    if (size < (1u << firstShift)) {
+        firstLevel = 0u;
+        secondLevel = size/granularity;
+    }
+    else {
+        const auto bit = highestBit(size);
+        firstLevel = bit - firstShift + 1u;
+        secondLevel = (size >> (bit - secondBits)) ^ (1u << secondBits);
+    }
+}
+
+void TlsfAllocator::insertFree(const std::uint32_t block) noexcept {
+    auto firstLevel = 0u;
+    auto secondLevel = 0u;
+    sizeClass(blocks[block].size, secondLevelBits, firstLevelShift,
+            firstLevel, secondLevel);
+
+    auto& head = heads[firstLevel][secondLevel];
+    blocks[block].free = true;
+    blocks[block].previousFree = invalid;
+    blocks[block].nextFree = head;
+    if (head != invalid) {
+        blocks[head].previousFree = block;
+    }
+    head = block;
+
+    firstLevelMap |= 1u << firstLevel;
+    secondLevelMaps[firstLevel] |= 1u << secondLevel;
+    ++freeBlocks;
+}
+
+void TlsfAllocator::removeFree(const std::uint32_t block) noexcept {
+    auto firstLevel = 0u;
+    auto secondLevel = 0u;
+    sizeClass(blocks[block].size, secondLevelBits, firstLevelShift,
+            firstLevel, secondLevel);
+
+    auto& node = blocks[block];
+    if (node.previousFree != invalid) {
+        blocks[node.previousFree].nextFree = node.nextFree;
+    }
+    else {
+        heads[firstLevel][secondLevel] = node.nextFree;
+    }
+    if (node.nextFree != invalid) {
+        blocks[node.nextFree].previousFree = node.previousFree;
+    }
+    node.free = false;
+
+    if (heads[firstLevel][secondLevel] == invalid) {
+        secondLevelMaps[firstLevel] &= ~(1u << secondLevel);
+        if (secondLevelMaps[firstLevel] == 0u) {
+            firstLevelMap &= ~(1u << firstLevel);
+        }
+    }
+    --freeBlocks;
+}
+
+std::uint32_t TlsfAllocator::findFree(const std::uint32_t size) const noexcept {
+    // Round up to the next class boundary, then every block of the class
+    // found is large enough
+    auto search = std::uint64_t(size);
+    if (size >= (1u << firstLevelShift)) {
+        search += (std::uint64_t(1) << (highestBit(size) -
+                secondLevelBits)) - 1u;
+        if (search > UINT32_MAX) {
+            return invalid;
+        }
+    }
+    auto firstLevel = 0u;
+    auto secondLevel = 0u;
+    sizeClass(static_cast<std::uint32_t>(search), secondLevelBits,
+            firstLevelShift, firstLevel, secondLevel);
+
+    auto secondMap = secondLevelMaps[firstLevel] &
+            (secondLevel < 32u ? ~0u << secondLevel : 0u);
+    if (secondMap == 0u) {
+        const auto firstMap = firstLevel + 1u < 32u ?
+                firstLevelMap & (~0u << (firstLevel + 1u)) : 0u;
+        if (firstMap == 0u) {
+            return invalid;
+        }
+        firstLevel = lowestBit(firstMap);
+        secondMap = secondLevelMaps[firstLevel];
+    }
+    return heads[firstLevel][lowestBit(secondMap)];
+}
+
+std::uint32_t TlsfAllocator::split(const std::uint32_t block,
+        const std::uint32_t headSize) noexcept {
+    const auto head = createBlock(blocks[block].offset, headSize);
+    auto& tail = blocks[block];
+    blocks[head].previousPhysical = tail.previousPhysical;
+    blocks[head].nextPhysical = block;
+    if (tail.previousPhysical != invalid) {
+        blocks[tail.previousPhysical].nextPhysical = head;
+    }
+    tail.previousPhysical = head;
+    tail.offset += headSize;
+    tail.size -= headSize;
+    return head;
+}
+
+std::uint32_t TlsfAllocator::allocate(const std::uint32_t size,
+        const std::uint32_t alignment) noexcept {
+    if (size == 0u || size > totalSize) {
+        return invalid;
+    }
+    const auto blockSize = roundUp(size, granularity);
+    const auto blockAlignment = std::max(roundUp(alignment, granularity),
+            granularity);
+
+    // Any free block this size can be aligned by skipping its head. An
+    // empty allocator is a single block at offset 0, aligned to anything
+    const auto padded = std::uint64_t(blockSize) + blockAlignment -
+            granularity;
+    auto block = padded <= totalSize ?
+            findFree(static_cast<std::uint32_t>(padded)) : invalid;
+    if (block == invalid && used == 0u) {
+        auto firstLevel = 0u;
+        auto secondLevel = 0u;
+        sizeClass(totalSize, secondLevelBits, firstLevelShift,
+                firstLevel, secondLevel);
+        block = heads[firstLevel][secondLevel];
+    }
+    if (block == invalid) {
+        return invalid;
+    }
+    removeFree(block);
+
+    const auto misalignment = blocks[block].offset%blockAlignment;
+    if (misalignment != 0u) {
+        insertFree(split(block, blockAlignment - misalignment));
+    }
+    if (blocks[block].size > blockSize) {
+        // The tail stays free, so the block keeps its index
+        const auto head = split(block, blockSize);
+        insertFree(block);
+        block = head;
+    }
+    used += blocks[block].size;
+    return block;
+}
+
+void TlsfAllocator::free(std::uint32_t block) noexcept {
+    used -= blocks[block].size;
+
+    // Merge with free neighbours in memory
+    const auto previous = blocks[block].previousPhysical;
+    if (previous != invalid && blocks[previous].free) {
+        removeFree(previous);
+        blocks[block].offset = blocks[previous].offset;
+        blocks[block].size += blocks[previous].size;
+        blocks[block].previousPhysical = blocks[previous].previousPhysical;
+        if (blocks[block].previousPhysical != invalid) {
+            blocks[blocks[block].previousPhysical].nextPhysical = block;
+        }
+        destroyBlock(previous);
+    }
+    const auto next = blocks[block].nextPhysical;
+    if (next != invalid && blocks[next].free) {
+        removeFree(next);
+        blocks[block].size += blocks[next].size;
+        blocks[block].nextPhysical = blocks[next].nextPhysical;
+        if (blocks[block].nextPhysical != invalid) {
+            blocks[blocks[block].nextPhysical].previousPhysical = block;
+        }
+        destroyBlock(next);
+    }
+    insertFree(block);
+}
+
+std::uint32_t TlsfAllocator::largestFreeBlock() const noexcept {
+    if (firstLevelMap == 0u) {
+        return 0u;
+    }
+    const auto firstLevel = highestBit(firstLevelMap);
+    const auto secondLevel = highestBit(secondLevelMaps[firstLevel]);
+    auto largest = 0u;
+    for (auto block = heads[firstLevel][secondLevel]; block != invalid;
+            block = blocks[block].nextFree) {
+        largest = std::max(largest, blocks[block].size);
+    }
+    return largest;
+}
+
+// GPU buffers
+
+GpuBufferAllocator::GpuBufferAllocator(const std::uint32_t blockSize) noexcept
+    : blockSize(roundUp(blockSize, granularity)) {}
+
+GpuBufferAllocator::~GpuBufferAllocator() noexcept {
+    destroy();
+}
+
+std::uint32_t GpuBufferAllocator::createBlock(
+        const std::uint32_t size) noexcept {
+    auto block = std::uint32_t(0);
+    while (block < blocks.size() && blocks[block].buffer != 0u) {
+        ++block;
+    }
+    if (block == blocks.size()) {
+        blocks.emplace_back();
+    }
+
+    glCreateBuffers(1, &blocks[block].buffer);
+    glNamedBufferStorage(blocks[block].buffer, size, nullptr,
+            GL_DYNAMIC_STORAGE_BIT);
+    blocks[block].tlsf = TlsfAllocator(size);
+    return block;
+}
+
+void GpuBufferAllocator::destroyBlock(const std::uint32_t block) noexcept {
+    glDeleteBuffers(1, &blocks[block].buffer);
+    blocks[block].buffer = 0u;
+    blocks[block].tlsf = TlsfAllocator();
+}
+
+bool GpuBufferAllocator::place(Allocation& allocation,
+        const std::uint32_t except) noexcept {
+    for (auto block = 0u; block < blocks.size(); ++block) {
+        if (block == except || blocks[block].buffer == 0u) {
+            continue;
+        }
+        const auto node = blocks[block].tlsf.allocate(allocation.size,
+                allocation.alignment);
+        if (node != TlsfAllocator::invalid) {
+            allocation.block = block;
+            allocation.node = node;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::uint32_t GpuBufferAllocator::allocate(const std::uint32_t size,
+        const std::uint32_t alignment) noexcept {
+    if (size == 0u || alignment%granularity != 0u) {
+        std::cout << "GPU allocation of " << size << " bytes aligned to " <<
+                alignment << " is not supported\n";
+        return invalid;
+    }
+
+    auto allocation = Allocation();
+    allocation.size = size;
+    allocation.alignment = std::max(alignment, granularity);
+    if (!place(allocation, invalid)) {
+        // Offset 0 of a new buffer is aligned to anything
+        const auto block = createBlock(std::max(blockSize,
+                roundUp(size, granularity)));
+        allocation.block = block;
+        allocation.node = blocks[block].tlsf.allocate(size,
+                allocation.alignment);
+        if (allocation.node == TlsfAllocator::invalid) {
+            std::cout << "GPU allocation of " << size << " bytes failed\n";
+            destroyBlock(block);
+            return invalid;
+        }
+    }
+
+    auto handle = invalid;
+    if (!freeHandles.empty()) {
+        handle = freeHandles.back();
+        freeHandles.pop_back();
+        allocations[handle] = allocation;
+    }
+    else {
+        handle = static_cast<std::uint32_t>(allocations.size());
+        allocations.push_back(allocation);
+    }
+    return handle;
+}
+
+void GpuBufferAllocator::free(const std::uint32_t handle) noexcept {
+    auto& allocation = allocations[handle];
+    auto& block = blocks[allocation.block];
+    block.tlsf.free(allocation.node);
+
+    // Keep one empty buffer around for the next allocations
+    if (block.tlsf.usedBytes() == 0u) {
+        const auto otherEmpty = std::any_of(blocks.begin(), blocks.end(),
+                [&block](const Block& other) {
+            return &other != &block && other.buffer != 0u &&
+                    other.tlsf.usedBytes() == 0u;
+        });
+        if (otherEmpty || block.tlsf.capacity() > blockSize) {
+            destroyBlock(allocation.block);
+        }
+    }
+
+    allocation = Allocation();
+    freeHandles.push_back(handle);
+}
+
+GpuRange GpuBufferAllocator::range(const std::uint32_t handle) const noexcept {
+    const auto& allocation = allocations[handle];
+    const auto& block = blocks[allocation.block];
+    return GpuRange{ block.buffer, block.tlsf.offset(allocation.node),
+            allocation.size };
+}
+
+void GpuBufferAllocator::upload(const std::uint32_t handle,
+        const void* const data) noexcept {
+    const auto target = range(handle);
+    glNamedBufferSubData(target.buffer, target.offset, target.size, data);
+}
+
+std::size_t GpuBufferAllocator::defragment(
+        const std::size_t maxBytes) noexcept {
+    // The least used buffer is the cheapest to empty, an empty one has
+    // nothing to move
+    auto source = invalid;
+    auto sourceUsed = UINT32_MAX;
+    auto liveBlocks = 0u;
+    for (auto block = 0u; block < blocks.size(); ++block) {
+        if (blocks[block].buffer == 0u) {
+            continue;
+        }
+        ++liveBlocks;
+        const auto used = blocks[block].tlsf.usedBytes();
+        if (used != 0u && used < sourceUsed) {
+            source = block;
+            sourceUsed = blocks[block].tlsf.usedBytes();
+        }
+    }
+    if (liveBlocks < 2u || source == invalid) {
+        return 0u;
+    }
+
+    auto moved = std::size_t(0);
+    for (auto& allocation : allocations) {
+        if (allocation.block != source) {
+            continue;
+        }
+        if (moved >= maxBytes) {
+            return moved;
+        }
+
+        auto target = allocation;
+        if (!place(target, source)) {
+            return moved;
+        }
+        glCopyNamedBufferSubData(blocks[source].buffer,
+                blocks[target.block].buffer,
+                blocks[source].tlsf.offset(allocation.node),
+                blocks[target.block].tlsf.offset(target.node),
+                allocation.size);
+        blocks[source].tlsf.free(allocation.node);
+        allocation = target;
+
+        moved += allocation.size;
+        movedBytes += allocation.size;
+        ++moves;
+    }
+
+    if (blocks[source].tlsf.usedBytes() == 0u) {
+        destroyBlock(source);
+    }
+    return moved;
+}
+
+GpuAllocatorStats GpuBufferAllocator::stats() const noexcept {
+    auto result = GpuAllocatorStats();
+    for (const auto& block : blocks) {
+        if (block.buffer == 0u) {
+            continue;
+        }
+        ++result.buffers;
+        result.capacity += block.tlsf.capacity();
+        result.usedBytes += block.tlsf.usedBytes();
+        result.freeRanges += block.tlsf.freeBlockCount();
+        result.largestFree = std::max<std::size_t>(result.largestFree,
+                block.tlsf.largestFreeBlock());
+    }
+    result.allocations = allocations.size() - freeHandles.size();
+    result.movedBytes = movedBytes;
+    return result;
+}
+
+void GpuBufferAllocator::destroy() noexcept {
+    for (auto block = 0u; block < blocks.size(); ++block) {
+        if (blocks[block].buffer != 0u) {
+            destroyBlock(block);
+        }
+    }
+    blocks.clear();
+    allocations.clear();
+    freeHandles.clear();
+}
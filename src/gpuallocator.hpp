@@ -0,0 +1,156 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two level segregated fit allocator (Masmano et al., 2004) over offsets
+// in [0, capacity), the memory itself lives elsewhere. Allocation and free
+// are O(1): free blocks are kept in lists by size class, first level is the
+// power of two, second level splits it in 16. Sizes and offsets are in
+// multiples of 4 bytes, alignments may be any multiple of 4
+
+class TlsfAllocator {
+public:
+    static constexpr auto invalid = UINT32_MAX;
+
+    explicit TlsfAllocator(const std::uint32_t capacity = 0u) noexcept;
+
+    // Returns a block index, invalid when no free block fits
+    std::uint32_t allocate(const std::uint32_t size,
+            const std::uint32_t alignment = 4u) noexcept;
+    void free(const std::uint32_t block) noexcept;
+
+    std::uint32_t offset(const std::uint32_t block) const noexcept {
+        return blocks[block].offset;
+    }
+    std::uint32_t size(const std::uint32_t block) const noexcept {
+        return blocks[block].size;
+    }
+
+    std::uint32_t capacity() const noexcept { return totalSize; }
+    std::uint32_t usedBytes() const noexcept { return used; }
+    std::uint32_t largestFreeBlock() const noexcept;
+    std::uint32_t freeBlockCount() const noexcept { return freeBlocks; }
+
+private:
+    static constexpr auto secondLevelBits = 4u;
+    static constexpr auto secondLevelCount = 1u << secondLevelBits;
+    static constexpr auto firstLevelShift = secondLevelBits + 2u;
+    static constexpr auto firstLevelCount = 32u - firstLevelShift + 1u;
+
+    struct Block {
+        std::uint32_t offset;
+        std::uint32_t size;
+        std::uint32_t previousPhysical;
+        std::uint32_t nextPhysical;
+        std::uint32_t previousFree;
+        std::uint32_t nextFree;
+        bool free;
+    };
+
+    std::uint32_t createBlock(const std::uint32_t offset,
+            const std::uint32_t size) noexcept;
+    void destroyBlock(const std::uint32_t block) noexcept;
+    void insertFree(const std::uint32_t block) noexcept;
+    void removeFree(const std::uint32_t block) noexcept;
+    std::uint32_t findFree(const std::uint32_t size) const noexcept;
+
+    // Splits the head of block off into a block of its own, returns it
+    std::uint32_t split(const std::uint32_t block,
+            const std::uint32_t headSize) noexcept;
+
+    std::vector<Block> blocks;
+    std::vector<std::uint32_t> unusedBlocks;
+    std::uint32_t heads[firstLevelCount][secondLevelCount];
+    std::uint32_t firstLevelMap = 0u;
+    std::uint32_t secondLevelMaps[firstLevelCount] = {};
+    std::uint32_t totalSize = 0u;
+    std::uint32_t used = 0u;
+    std::uint32_t freeBlocks = 0u;
+};
+
+// Where an allocation currently lives, offset in bytes into buffer
+struct GpuRange {
+    GLuint buffer = 0u;
+    std::uint32_t offset = 0u;
+    std::uint32_t size = 0u;
+};
+
+struct GpuAllocatorStats {
+    std::size_t buffers = 0u;
+    std::size_t capacity = 0u;
+    std::size_t usedBytes = 0u;
+    std::size_t allocations = 0u;
+    std::size_t freeRanges = 0u;   // Fragmentation, 1 per buffer is ideal
+    std::size_t largestFree = 0u;
+    std::size_t movedBytes = 0u;   // By defragment(), since creation
+};
+
+// Shares a few large buffer objects between many meshes. Allocations are
+// handles rather than ranges since defragment() may move them, owners check
+// generation() and fetch the range again when it changed. Allocations larger
+// than the block size get a buffer of their own
+
+class GpuBufferAllocator {
+public:
+    static constexpr auto invalid = UINT32_MAX;
+
+    explicit GpuBufferAllocator(
+            const std::uint32_t blockSize = 64u << 20) noexcept;
+    GpuBufferAllocator(const GpuBufferAllocator&) = delete;
+    GpuBufferAllocator& operator=(const GpuBufferAllocator&) = delete;
+    ~GpuBufferAllocator() noexcept;
+
+    // Use GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT or the vertex stride as
+    // alignment where it matters. Returns invalid on failure
+    std::uint32_t allocate(const std::uint32_t size,
+            const std::uint32_t alignment = 4u) noexcept;
+    void free(const std::uint32_t allocation) noexcept;
+
+    GpuRange range(const std::uint32_t allocation) const noexcept;
+
+    // data must hold the allocation's size
+    void upload(const std::uint32_t allocation,
+            const void* const data) noexcept;
+
+    // Moves allocations out of the least used buffer into the others, up to
+    // maxBytes per call, and deletes the buffer once it is empty. The copies
+    // happen on the GPU in command order, so draws issued before still read
+    // the old place. Returns the bytes moved
+    std::size_t defragment(
+            const std::size_t maxBytes = std::size_t(4) << 20) noexcept;
+
+    // Changes whenever an allocation moves
+    std::uint32_t generation() const noexcept { return moves; }
+
+    GpuAllocatorStats stats() const noexcept;
+
+    void destroy() noexcept;
+
+private:
+    struct Block {
+        GLuint buffer = 0u; // 0 - slot free for reuse
+        TlsfAllocator tlsf;
+    };
+
+    struct Allocation {
+        std::uint32_t block = invalid; // invalid - handle free for reuse
+        std::uint32_t node = 0u;
+        std::uint32_t size = 0u;
+        std::uint32_t alignment = 0u;
+    };
+
+    std::uint32_t createBlock(const std::uint32_t size) noexcept;
+    void destroyBlock(const std::uint32_t block) noexcept;
+    bool place(Allocation& allocation, const std::uint32_t except) noexcept;
+
+    std::vector<Block> blocks;
+    std::vector<Allocation> allocations;
+    std::vector<std::uint32_t> freeHandles;
+    std::uint32_t blockSize;
+    std::uint32_t moves = 0u;
+    std::size_t movedBytes = 0u;
+};
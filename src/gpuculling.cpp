@@ -0,0 +1,217 @@
+#include "gpuculling.hpp"
+
+#include "shaders.hpp"
+
+#include <iostream>
+
+constexpr auto workGroupSize = 64u;
+
+// SSBO binding points used by the culling shaders
+
+constexpr auto boundsBinding = 0u;
+constexpr auto commandBinding = 1u;
+constexpr auto visibleBinding = 2u;
+constexpr auto compactedBinding = 3u;
+constexpr auto drawCountBinding = 4u;
+
+GpuCuller::~GpuCuller() noexcept {
+    destroy();
+}
+
+bool GpuCuller::create(const std::vector<DrawElementsIndirectCommand>& draws,
+        const GLuint maxInstances) noexcept {
+    destroy();
+
+    cullProgram = loadComputeShaders("shaders/cullinstances.glsl");
+    if (cullProgram == static_cast<GLuint>(-1)) {
+        cullProgram = 0u;
+        return false;
+    }
+    frustumLocation = glGetUniformLocation(cullProgram, "frustumPlanes");
+    instanceCountLocation = glGetUniformLocation(cullProgram, "instanceCount");
+    drawCountLocation = glGetUniformLocation(cullProgram, "drawCount");
+    visibleCapacityLocation = glGetUniformLocation(
+            cullProgram, "visibleCapacity");
+    occlusionEnabledLocation = glGetUniformLocation(
+            cullProgram, "occlusionEnabled");
+    occlusionMatrixLocation = glGetUniformLocation(
+            cullProgram, "occlusionMatrix");
+    hiZSizeLocation = glGetUniformLocation(cullProgram, "hiZSize");
+    hiZLevelsLocation = glGetUniformLocation(cullProgram, "hiZLevels");
+
+    // Without ARB_indirect_parameters empty draws stay in the command list
+    // and are skipped by the driver, so compaction is only needed with it
+
+    indirectCount = GLEW_ARB_indirect_parameters;
+    if (indirectCount) {
+        compactProgram = loadComputeShaders("shaders/compactdraws.glsl");
+        if (compactProgram == static_cast<GLuint>(-1)) {
+            compactProgram = 0u;
+            indirectCount = false;
+        }
+        else {
+            commandCountLocation = glGetUniformLocation(
+                    compactProgram, "commandCount");
+        }
+    }
+
+    // Every draw reserves a range of the visible list, zero instances
+
+    auto commands = draws;
+    auto capacity = 0u;
+    for (auto& command : commands) {
+        command.baseInstance = capacity;
+        capacity += command.instanceCount;
+        command.instanceCount = 0u;
+    }
+    drawCount = static_cast<GLuint>(commands.size());
+    instanceCapacity = maxInstances;
+    visibleCapacity = capacity;
+
+    if (drawCount == 0u || capacity == 0u) {
+        std::cout << "GPU culler has nothing to draw\n";
+        destroy();
+        return false;
+    }
+
+    const auto commandsSize = static_cast<GLsizeiptr>(
+            commands.size()*sizeof(DrawElementsIndirectCommand));
+
+    glCreateBuffers(1, &boundsBuffer);
+    glNamedBufferStorage(boundsBuffer,
+            maxInstances*sizeof(InstanceBounds), nullptr,
+            GL_DYNAMIC_STORAGE_BIT);
+
+    glCreateBuffers(1, &templateBuffer);
+    glNamedBufferStorage(templateBuffer, commandsSize, commands.data(), 0);
+
+    glCreateBuffers(1, &commandBuffer);
+    glNamedBufferStorage(commandBuffer, commandsSize, nullptr, 0);
+
+    glCreateBuffers(1, &visibleBuffer);
+    glNamedBufferStorage(visibleBuffer, capacity*sizeof(GLuint), nullptr, 0);
+
+    if (indirectCount) {
+        glCreateBuffers(1, &compactedBuffer);
+        glNamedBufferStorage(compactedBuffer, commandsSize, nullptr, 0);
+
+        glCreateBuffers(1, &drawCountBuffer);
+        glNamedBufferStorage(drawCountBuffer, sizeof(GLuint), nullptr, 0);
+    }
+    return true;
+}
+
+void GpuCuller::destroy() noexcept {
+    if (cullProgram == 0u) {
+        return;
+    }
+
+    const GLuint buffers[] = { boundsBuffer, templateBuffer, commandBuffer,
+            compactedBuffer, drawCountBuffer, visibleBuffer };
+    glDeleteBuffers(sizeof(buffers)/sizeof(buffers[0]), buffers);
+    glDeleteProgram(cullProgram);
+    glDeleteProgram(compactProgram);
+
+    cullProgram = compactProgram = 0u;
+    boundsBuffer = templateBuffer = commandBuffer = 0u;
+    compactedBuffer = drawCountBuffer = visibleBuffer = 0u;
+    drawCount = instanceCapacity = visibleCapacity = instanceCount = 0u;
+    indirectCount = false;
+    occlusionPyramid = nullptr;
+}
+
+void GpuCuller::setOcclusion(const HiZPyramid* const pyramid,
+        const glm::mat4& viewProjectionMatrix) noexcept {
+    occlusionPyramid = pyramid;
+    occlusionMatrix = viewProjectionMatrix;
+}
+
+void GpuCuller::updateBounds(const InstanceBounds* const bounds,
+        const GLuint count) noexcept {
+    instanceCount = count < instanceCapacity ? count : instanceCapacity;
+    glNamedBufferSubData(boundsBuffer, 0,
+            instanceCount*sizeof(InstanceBounds), bounds);
+}
+
+void GpuCuller::bindInstanceAttribute(const GLuint vao,
+        const GLuint attribIndex, const GLuint bindingIndex) const noexcept {
+    glVertexArrayVertexBuffer(vao, bindingIndex,
+            visibleBuffer, 0, sizeof(GLuint));
+    glVertexArrayBindingDivisor(vao, bindingIndex, 1);
+    glVertexArrayAttribIFormat(vao, attribIndex, 1, GL_UNSIGNED_INT, 0);
+    glVertexArrayAttribBinding(vao, attribIndex, bindingIndex);
+    glEnableVertexArrayAttrib(vao, attribIndex);
+}
+
+void GpuCuller::cull(const Frustum& frustum,
+        GLStateCache& stateCache) noexcept {
+    // Reset instance counters
+
+    glCopyNamedBufferSubData(templateBuffer, commandBuffer, 0, 0,
+            drawCount*sizeof(DrawElementsIndirectCommand));
+
+    // Cull instances, survivors append themselves to their draw
+
+    stateCache.useProgram(cullProgram);
+    glUniform4fv(frustumLocation, 6, &frustum.planes[0].x);
+    glUniform1ui(instanceCountLocation, instanceCount);
+    glUniform1ui(drawCountLocation, drawCount);
+    glUniform1ui(visibleCapacityLocation, visibleCapacity);
+
+    const auto occlusion = occlusionPyramid != nullptr &&
+            occlusionPyramid->texture() != 0u;
+    glUniform1i(occlusionEnabledLocation, occlusion);
+    if (occlusion) {
+        glUniformMatrix4fv(occlusionMatrixLocation, 1, GL_FALSE,
+                &occlusionMatrix[0][0]);
+        glUniform2i(hiZSizeLocation, occlusionPyramid->width(),
+                occlusionPyramid->height());
+        glUniform1i(hiZLevelsLocation, occlusionPyramid->levels());
+        stateCache.bindTextureUnit(0u, GL_TEXTURE_2D,
+                occlusionPyramid->texture());
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, boundsBinding, boundsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, commandBinding, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, visibleBinding, visibleBuffer);
+
+    glDispatchCompute((instanceCount + workGroupSize - 1)/workGroupSize, 1, 1);
+
+    // Drop draws that ended up empty
+
+    if (indirectCount) {
+        const auto zero = 0u;
+        glClearNamedBufferData(drawCountBuffer, GL_R32UI,
+                GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        stateCache.useProgram(compactProgram);
+        glUniform1ui(commandCountLocation, drawCount);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                compactedBinding, compactedBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                drawCountBinding, drawCountBuffer);
+
+        glDispatchCompute((drawCount + workGroupSize - 1)/workGroupSize, 1, 1);
+    }
+
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT |
+            GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::draw(const GLenum mode,
+        const GLenum indexType) const noexcept {
+    if (indirectCount) {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, compactedBuffer);
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, drawCountBuffer);
+        glMultiDrawElementsIndirectCountARB(mode, indexType,
+                nullptr, 0, drawCount, sizeof(DrawElementsIndirectCommand));
+        glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0u);
+    }
+    else {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glMultiDrawElementsIndirect(mode, indexType,
+                nullptr, drawCount, sizeof(DrawElementsIndirectCommand));
+    }
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0u);
+}
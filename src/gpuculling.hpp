@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "culling.hpp"
+#include "glstatecache.hpp"
+#include "hiz.hpp"
+
+#include <vector>
+
+// Layouts match the std430 structs in shaders/cullinstances.glsl
+
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+struct InstanceBounds {
+    glm::vec4 sphere; // xyz - center, w - radius
+    GLuint drawId;
+    GLuint instance; // Written to the visible list, indexes instance data
+    GLuint padding[2];
+};
+
+// Culls instance bounds in a compute pass and draws the survivors with one
+// indirect call. Every draw owns a range of the visible instance buffer,
+// its instances read their id through a per-instance vertex attribute. An
+// object drawn by several draws has bounds for each, with the same
+// instance
+
+class GpuCuller {
+public:
+    GpuCuller() noexcept = default;
+    GpuCuller(const GpuCuller&) = delete;
+    GpuCuller& operator=(const GpuCuller&) = delete;
+    ~GpuCuller() noexcept;
+
+    // instanceCount of every draw is the maximum instances it may get,
+    // baseInstance is assigned here
+    bool create(const std::vector<DrawElementsIndirectCommand>& draws,
+            const GLuint maxInstances) noexcept;
+    void destroy() noexcept;
+
+    void updateBounds(const InstanceBounds* const bounds,
+            const GLuint count) noexcept;
+
+    // Binds the visible instance ids as an integer attribute with divisor 1
+    void bindInstanceAttribute(const GLuint vao, const GLuint attribIndex,
+            const GLuint bindingIndex) const noexcept;
+
+    // Instances hidden behind the pyramid's depth are culled as well.
+    // viewProjectionMatrix is the one the pyramid's depth was drawn with,
+    // nullptr disables the occlusion test
+    void setOcclusion(const HiZPyramid* const pyramid,
+            const glm::mat4& viewProjectionMatrix) noexcept;
+
+    void cull(const Frustum& frustum, GLStateCache& stateCache) noexcept;
+
+    // Expects the program and VAO to be bound
+    void draw(const GLenum mode,
+            const GLenum indexType = GL_UNSIGNED_INT) const noexcept;
+
+    GLuint visibleInstanceBuffer() const noexcept { return visibleBuffer; }
+
+private:
+    GLuint cullProgram = 0u;
+    GLuint compactProgram = 0u;
+    GLint frustumLocation = -1;
+    GLint instanceCountLocation = -1;
+    GLint drawCountLocation = -1;
+    GLint visibleCapacityLocation = -1;
+    GLint commandCountLocation = -1;
+    GLint occlusionEnabledLocation = -1;
+    GLint occlusionMatrixLocation = -1;
+    GLint hiZSizeLocation = -1;
+    GLint hiZLevelsLocation = -1;
+
+    const HiZPyramid* occlusionPyramid = nullptr;
+    glm::mat4 occlusionMatrix = glm::mat4(1.f);
+
+    GLuint boundsBuffer = 0u;
+    GLuint templateBuffer = 0u;
+    GLuint commandBuffer = 0u;
+    GLuint compactedBuffer = 0u;
+    GLuint drawCountBuffer = 0u;
+    GLuint visibleBuffer = 0u;
+
+    GLuint drawCount = 0u;
+    GLuint instanceCapacity = 0u;
+    GLuint visibleCapacity = 0u;
+    GLuint instanceCount = 0u;
+    bool indirectCount = false;
+};
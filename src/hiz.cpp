@@ -0,0 +1,174 @@
+#include "hiz.hpp"
+
+#include "shaders.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+constexpr auto workGroupSize = 8;
+
+static auto levelSize(const int size, const int level) noexcept {
+    return std::max(1, size >> level);
+}
+
+// Depth format of a framebuffer's depth attachment, 0 - no depth
+static auto depthFormat(const GLuint framebuffer) noexcept {
+    const auto depth = framebuffer == 0u ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+    const auto stencil = framebuffer == 0u ? GL_STENCIL :
+            GL_STENCIL_ATTACHMENT;
+    auto depthBits = 0;
+    auto stencilBits = 0;
+    auto componentType = 0;
+    glGetNamedFramebufferAttachmentParameteriv(framebuffer, depth,
+            GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &depthBits);
+    glGetNamedFramebufferAttachmentParameteriv(framebuffer, depth,
+            GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+    glGetNamedFramebufferAttachmentParameteriv(framebuffer, stencil,
+            GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencilBits);
+
+    if (componentType == GL_FLOAT) {
+        return GLenum(stencilBits != 0 ? GL_DEPTH32F_STENCIL8 :
+                GL_DEPTH_COMPONENT32F);
+    }
+    switch (depthBits) {
+    case 16:
+        return GLenum(GL_DEPTH_COMPONENT16);
+    case 24:
+        return GLenum(stencilBits != 0 ? GL_DEPTH24_STENCIL8 :
+                GL_DEPTH_COMPONENT24);
+    case 32:
+        return GLenum(GL_DEPTH_COMPONENT32);
+    default:
+        return GLenum(0);
+    }
+}
+
+HiZPyramid::~HiZPyramid() noexcept {
+    destroy();
+}
+
+bool HiZPyramid::create(const int width, const int height,
+        const GLuint sourceFramebuffer) noexcept {
+    if (downsampleProgram != 0u &&
+            width == pyramidWidth && height == pyramidHeight) {
+        return true;
+    }
+    destroy();
+
+    const auto format = depthFormat(sourceFramebuffer);
+    if (format == 0u) {
+        std::cout << "Hi-Z source framebuffer has no depth\n";
+        return false;
+    }
+
+    downsampleProgram = loadComputeShaders("shaders/hizdownsample.glsl");
+    if (downsampleProgram == static_cast<GLuint>(-1)) {
+        downsampleProgram = 0u;
+        return false;
+    }
+    copyDepthLocation = glGetUniformLocation(downsampleProgram, "copyDepth");
+    sourceLevelLocation = glGetUniformLocation(
+            downsampleProgram, "sourceLevel");
+    sourceSizeLocation = glGetUniformLocation(
+            downsampleProgram, "sourceSize");
+
+    pyramidWidth = std::max(1, width);
+    pyramidHeight = std::max(1, height);
+    levelCount = 1;
+    while ((std::max(pyramidWidth, pyramidHeight) >> levelCount) > 0) {
+        ++levelCount;
+    }
+
+    // Depth copy target, in the source's format so the blit is allowed
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &depthTexture);
+    glTextureStorage2D(depthTexture, 1, format, pyramidWidth, pyramidHeight);
+    glTextureParameteri(depthTexture, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTextureParameteri(depthTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(depthTexture, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+    glCreateFramebuffers(1, &depthFramebuffer);
+    const auto withStencil = format == GL_DEPTH24_STENCIL8 ||
+            format == GL_DEPTH32F_STENCIL8;
+    glNamedFramebufferTexture(depthFramebuffer, withStencil ?
+            GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT,
+            depthTexture, 0);
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &pyramidTexture);
+    glTextureStorage2D(pyramidTexture, levelCount, GL_R32F,
+            pyramidWidth, pyramidHeight);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_MIN_FILTER,
+            GL_NEAREST_MIPMAP_NEAREST);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(pyramidTexture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    if (glCheckNamedFramebufferStatus(depthFramebuffer, GL_FRAMEBUFFER) !=
+            GL_FRAMEBUFFER_COMPLETE) {
+        std::cout << "Hi-Z depth framebuffer is incomplete\n";
+        destroy();
+        return false;
+    }
+    return true;
+}
+
+void HiZPyramid::destroy() noexcept {
+    if (downsampleProgram == 0u) {
+        return;
+    }
+
+    glDeleteProgram(downsampleProgram);
+    glDeleteFramebuffers(1, &depthFramebuffer);
+    glDeleteTextures(1, &depthTexture);
+    glDeleteTextures(1, &pyramidTexture);
+
+    downsampleProgram = depthFramebuffer = 0u;
+    depthTexture = pyramidTexture = 0u;
+    pyramidWidth = pyramidHeight = levelCount = 0;
+}
+
+void HiZPyramid::build(GLStateCache& stateCache,
+        const GLuint sourceFramebuffer) noexcept {
+    if (downsampleProgram == 0u) {
+        return;
+    }
+
+    glBlitNamedFramebuffer(sourceFramebuffer, depthFramebuffer,
+            0, 0, pyramidWidth, pyramidHeight,
+            0, 0, pyramidWidth, pyramidHeight,
+            GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    stateCache.useProgram(downsampleProgram);
+
+    // Level 0 is a straight copy of the depth buffer
+
+    stateCache.bindTextureUnit(0u, GL_TEXTURE_2D, depthTexture);
+    glUniform1i(copyDepthLocation, GL_TRUE);
+    glUniform1i(sourceLevelLocation, 0);
+    glUniform2i(sourceSizeLocation, pyramidWidth, pyramidHeight);
+    glBindImageTexture(0, pyramidTexture, 0, GL_FALSE, 0,
+            GL_WRITE_ONLY, GL_R32F);
+    glDispatchCompute((pyramidWidth + workGroupSize - 1)/workGroupSize,
+            (pyramidHeight + workGroupSize - 1)/workGroupSize, 1);
+
+    // Every next level takes the max of the level above
+
+    stateCache.bindTextureUnit(0u, GL_TEXTURE_2D, pyramidTexture);
+    glUniform1i(copyDepthLocation, GL_FALSE);
+    for (auto level = 1; level < levelCount; ++level) {
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        const auto width = levelSize(pyramidWidth, level);
+        const auto height = levelSize(pyramidHeight, level);
+        glUniform1i(sourceLevelLocation, level - 1);
+        glUniform2i(sourceSizeLocation, levelSize(pyramidWidth, level - 1),
+                levelSize(pyramidHeight, level - 1));
+        glBindImageTexture(0, pyramidTexture, level, GL_FALSE, 0,
+                GL_WRITE_ONLY, GL_R32F);
+        glDispatchCompute((width + workGroupSize - 1)/workGroupSize,
+                (height + workGroupSize - 1)/workGroupSize, 1);
+    }
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glBindImageTexture(0, 0u, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+}
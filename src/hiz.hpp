@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "glstatecache.hpp"
+
+// Hierarchical depth built from a framebuffer's depth, every texel of a
+// level holds the farthest depth of the texels it covers one level below
+
+class HiZPyramid {
+public:
+    HiZPyramid() noexcept = default;
+    HiZPyramid(const HiZPyramid&) = delete;
+    HiZPyramid& operator=(const HiZPyramid&) = delete;
+    ~HiZPyramid() noexcept;
+
+    // The depth copy matches the source framebuffer's depth format, which
+    // blitting needs
+    bool create(const int width, const int height,
+            const GLuint sourceFramebuffer = 0u) noexcept;
+    void destroy() noexcept;
+
+    // Copies depth out of the framebuffer (0 - default) and downsamples it.
+    // Call after the frame is drawn, the result is used by the next frame
+    void build(GLStateCache& stateCache,
+            const GLuint sourceFramebuffer = 0u) noexcept;
+
+    GLuint texture() const noexcept { return pyramidTexture; }
+    int width() const noexcept { return pyramidWidth; }
+    int height() const noexcept { return pyramidHeight; }
+    int levels() const noexcept { return levelCount; }
+
+private:
+    GLuint downsampleProgram = 0u;
+    GLint copyDepthLocation = -1;
+    GLint sourceLevelLocation = -1;
+    GLint sourceSizeLocation = -1;
+
+    GLuint depthTexture = 0u;
+    GLuint depthFramebuffer = 0u;
+    GLuint pyramidTexture = 0u;
+
+    int pyramidWidth = 0;
+    int pyramidHeight = 0;
+    int levelCount = 0;
+};
@@ -0,0 +1,807 @@
+#include "imagedecoder.hpp"
+
+#include <SOIL2/SOIL2.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DECODER_SSE 1
+#endif
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+// Inflate (RFC 1951)
+
+// Codes up to this many bits are decoded with one table lookup
+constexpr auto fastBits = 10;
+
+constexpr std::uint16_t lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+constexpr std::uint8_t lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+constexpr std::uint16_t distanceBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+};
+constexpr std::uint8_t distanceExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+constexpr std::uint8_t codeLengthOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+// Least significant bit first, refilled 8 bytes at a time away from the end
+class BitReader {
+public:
+    BitReader(const unsigned char* const data, const std::size_t size) noexcept
+        : data(data), size(size) {
+    }
+
+    void refill() noexcept {
+        if (position + 8u <= size) {
+            std::uint64_t word;
+            std::memcpy(&word, data + position, 8u);
+            bits |= word << count;
+            position += (63 - count) >> 3;
+            count |= 56;
+            return;
+        }
+        while (count <= 56) {
+            if (position < size) {
+                bits |= std::uint64_t(data[position]) << count;
+            }
+            else {
+                ++overrun;
+            }
+            ++position;
+            count += 8;
+        }
+    }
+
+    std::uint32_t peek(const int n) const noexcept {
+        return static_cast<std::uint32_t>(
+                bits & ((std::uint64_t(1) << n) - 1u));
+    }
+
+    void consume(const int n) noexcept {
+        bits >>= n;
+        count -= n;
+    }
+
+    std::uint32_t read(const int n) noexcept {
+        if (count < n) {
+            refill();
+        }
+        const auto value = peek(n);
+        consume(n);
+        return value;
+    }
+
+    void alignToByte() noexcept {
+        consume(count & 7);
+    }
+
+    // Hands the buffered whole bytes back for a stored block
+    std::size_t bytePosition() const noexcept {
+        return position - static_cast<std::size_t>(count >> 3);
+    }
+
+    void seek(const std::size_t bytePosition) noexcept {
+        position = bytePosition;
+        bits = 0u;
+        count = 0;
+    }
+
+    // More than the padding bytes made up past the end were used
+    bool exhausted() const noexcept {
+        return overrun*8 > count;
+    }
+
+private:
+    const unsigned char* data;
+    std::size_t size;
+    std::size_t position = 0;
+    std::uint64_t bits = 0u;
+    int count = 0;
+    int overrun = 0;
+};
+
+class Huffman {
+public:
+    bool build(const std::uint8_t* const lengths,
+            const int symbolCount) noexcept {
+        std::fill(std::begin(counts), std::end(counts), std::uint16_t(0));
+        for (auto symbol = 0; symbol < symbolCount; ++symbol) {
+            ++counts[lengths[symbol]];
+        }
+        counts[0] = 0;
+
+        // Over-subscribed sets are invalid, incomplete ones are allowed
+        auto left = 1;
+        for (auto length = 1; length <= 15; ++length) {
+            left = (left << 1) - counts[length];
+            if (left < 0) {
+                return false;
+            }
+        }
+
+        std::uint16_t offsets[16];
+        offsets[1] = 0;
+        for (auto length = 1; length < 15; ++length) {
+            offsets[length + 1] = offsets[length] + counts[length];
+        }
+        for (auto symbol = 0; symbol < symbolCount; ++symbol) {
+            if (lengths[symbol] != 0) {
+                symbols[offsets[lengths[symbol]]++] =
+                        static_cast<std::uint16_t>(symbol);
+            }
+        }
+
+        // Canonical codes are stored bit reversed in the stream, every
+        // table slot whose low bits match a short code maps to it
+        std::fill(std::begin(fast), std::end(fast), std::uint16_t(0));
+        auto code = 0u;
+        auto index = 0;
+        for (auto length = 1; length <= fastBits; ++length) {
+            for (auto i = 0; i < counts[length]; ++i, ++index, ++code) {
+                auto reversed = 0u;
+                for (auto bit = 0; bit < length; ++bit) {
+                    reversed |= ((code >> bit) & 1u) << (length - 1 - bit);
+                }
+                for (auto slot = reversed; slot < (1u << fastBits);
+                        slot += 1u << length) {
+                    fast[slot] = static_cast<std::uint16_t>(
+                            (symbols[index] << 4) | length);
+                }
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    // Expects at least 15 buffered bits
+    int decode(BitReader& reader) const noexcept {
+        const auto entry = fast[reader.peek(fastBits)];
+        if (entry != 0u) {
+            reader.consume(entry & 15);
+            return entry >> 4;
+        }
+
+        auto bits = reader.peek(15);
+        auto code = 0;
+        auto first = 0;
+        auto index = 0;
+        for (auto length = 1; length <= 15; ++length) {
+            code |= static_cast<int>(bits & 1u);
+            bits >>= 1;
+            const auto count = counts[length];
+            if (code - count < first) {
+                reader.consume(length);
+                return symbols[index + (code - first)];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+private:
+    std::uint16_t counts[16];
+    std::uint16_t symbols[288];
+    std::uint16_t fast[1 << fastBits];
+};
+
+static bool inflateBlock(BitReader& reader, const Huffman& literals,
+        const Huffman& distances, unsigned char* const out,
+        const std::size_t capacity, std::size_t& written) noexcept {
+    auto position = written;
+    while (true) {
+        reader.refill();
+        const auto symbol = literals.decode(reader);
+        if (symbol < 0) {
+            return false;
+        }
+        if (symbol < 256) {
+            if (position == capacity) {
+                return false;
+            }
+            out[position++] = static_cast<unsigned char>(symbol);
+            continue;
+        }
+        if (symbol == 256) {
+            written = position;
+            return !reader.exhausted();
+        }
+
+        const auto lengthSymbol = symbol - 257;
+        if (lengthSymbol >= 29) {
+            return false;
+        }
+        const auto length = std::size_t(lengthBase[lengthSymbol]) +
+                reader.read(lengthExtra[lengthSymbol]);
+        reader.refill();
+        const auto distanceSymbol = distances.decode(reader);
+        if (distanceSymbol < 0 || distanceSymbol >= 30) {
+            return false;
+        }
+        const auto distance = std::size_t(distanceBase[distanceSymbol]) +
+                reader.read(distanceExtra[distanceSymbol]);
+        if (distance > position || length > capacity - position) {
+            return false;
+        }
+
+        // Distances of 8 or more never overlap within one 8 byte copy
+        auto target = out + position;
+        auto source = target - distance;
+        if (distance >= 8u && position + length + 8u <= capacity) {
+            for (auto copied = std::size_t(0); copied < length; copied += 8u) {
+                std::memcpy(target + copied, source + copied, 8u);
+            }
+        }
+        else {
+            for (auto i = std::size_t(0); i < length; ++i) {
+                target[i] = source[i];
+            }
+        }
+        position += length;
+    }
+}
+
+static bool inflate(const unsigned char* const data, const std::size_t size,
+        unsigned char* const out, const std::size_t capacity) noexcept {
+    // zlib header: deflate method, no preset dictionary
+    if (size < 2u || (data[0] & 15) != 8 || (data[1] & 32) != 0 ||
+            ((data[0] << 8) | data[1]) % 31 != 0) {
+        return false;
+    }
+
+    static const auto fixedTables = [] {
+        auto tables = std::pair<Huffman, Huffman>();
+        std::uint8_t lengths[288];
+        std::fill(lengths, lengths + 144, std::uint8_t(8));
+        std::fill(lengths + 144, lengths + 256, std::uint8_t(9));
+        std::fill(lengths + 256, lengths + 280, std::uint8_t(7));
+        std::fill(lengths + 280, lengths + 288, std::uint8_t(8));
+        tables.first.build(lengths, 288);
+        std::fill(lengths, lengths + 30, std::uint8_t(5));
+        tables.second.build(lengths, 30);
+        return tables;
+    }();
+
+    auto reader = BitReader(data + 2, size - 2u);
+    auto written = std::size_t(0);
+    auto literals = Huffman();
+    auto distances = Huffman();
+    auto last = 0u;
+    while (!last) {
+        last = reader.read(1);
+        const auto type = reader.read(2);
+
+        if (type == 0u) {
+            reader.alignToByte();
+            const auto start = reader.bytePosition();
+            if (start + 4u > size - 2u) {
+                return false;
+            }
+            const auto block = data + 2 + start;
+            const auto length = std::size_t(block[0] | (block[1] << 8));
+            const auto check = std::size_t(block[2] | (block[3] << 8));
+            if ((length ^ 0xffffu) != check ||
+                    start + 4u + length > size - 2u ||
+                    length > capacity - written) {
+                return false;
+            }
+            std::memcpy(out + written, block + 4, length);
+            written += length;
+            reader.seek(start + 4u + length);
+        }
+        else if (type == 1u) {
+            if (!inflateBlock(reader, fixedTables.first, fixedTables.second,
+                    out, capacity, written)) {
+                return false;
+            }
+        }
+        else if (type == 2u) {
+            const auto literalCount = static_cast<int>(reader.read(5)) + 257;
+            const auto distanceCount = static_cast<int>(reader.read(5)) + 1;
+            const auto lengthCount = static_cast<int>(reader.read(4)) + 4;
+
+            std::uint8_t codeLengths[19] = {};
+            for (auto i = 0; i < lengthCount; ++i) {
+                codeLengths[codeLengthOrder[i]] =
+                        static_cast<std::uint8_t>(reader.read(3));
+            }
+            auto lengthCodes = Huffman();
+            if (!lengthCodes.build(codeLengths, 19)) {
+                return false;
+            }
+
+            std::uint8_t lengths[288 + 32] = {};
+            auto index = 0;
+            while (index < literalCount + distanceCount) {
+                reader.refill();
+                const auto symbol = lengthCodes.decode(reader);
+                if (symbol < 0) {
+                    return false;
+                }
+                if (symbol < 16) {
+                    lengths[index++] = static_cast<std::uint8_t>(symbol);
+                    continue;
+                }
+                auto repeated = std::uint8_t(0);
+                auto repeat = 0;
+                if (symbol == 16) {
+                    if (index == 0) {
+                        return false;
+                    }
+                    repeated = lengths[index - 1];
+                    repeat = 3 + static_cast<int>(reader.read(2));
+                }
+                else if (symbol == 17) {
+                    repeat = 3 + static_cast<int>(reader.read(3));
+                }
+                else {
+                    repeat = 11 + static_cast<int>(reader.read(7));
+                }
+                if (index + repeat > literalCount + distanceCount) {
+                    return false;
+                }
+                std::fill(lengths + index, lengths + index + repeat, repeated);
+                index += repeat;
+            }
+            if (lengths[256] == 0 ||
+                    !literals.build(lengths, literalCount) ||
+                    !distances.build(lengths + literalCount, distanceCount) ||
+                    !inflateBlock(reader, literals, distances,
+                    out, capacity, written)) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+    }
+    return written == capacity;
+}
+
+// PNG unfiltering, bpp is 1 to 4 bytes per pixel
+
+static inline unsigned char paeth(const int a, const int b,
+        const int c) noexcept {
+    const auto pa = std::abs(b - c);
+    const auto pb = std::abs(a - c);
+    const auto pc = std::abs(a + b - 2*c);
+    if (pa <= pb && pa <= pc) {
+        return static_cast<unsigned char>(a);
+    }
+    return static_cast<unsigned char>(pb <= pc ? b : c);
+}
+
+static void unfilterSub(unsigned char* const row, const std::size_t bytes,
+        const int bpp) noexcept {
+    for (auto x = std::size_t(bpp); x < bytes; ++x) {
+        row[x] = static_cast<unsigned char>(row[x] + row[x - bpp]);
+    }
+}
+
+static void unfilterAverage(unsigned char* const row,
+        const unsigned char* const up, const std::size_t bytes,
+        const int bpp) noexcept {
+    for (auto x = std::size_t(0); x < bytes; ++x) {
+        const auto left = x >= std::size_t(bpp) ? row[x - bpp] : 0;
+        row[x] = static_cast<unsigned char>(row[x] + ((left + up[x]) >> 1));
+    }
+}
+
+static void unfilterPaeth(unsigned char* const row,
+        const unsigned char* const up, const std::size_t bytes,
+        const int bpp) noexcept {
+    for (auto x = std::size_t(0); x < bytes; ++x) {
+        const auto left = x >= std::size_t(bpp) ? row[x - bpp] : 0;
+        const auto upLeft = x >= std::size_t(bpp) ? up[x - bpp] : 0;
+        row[x] = static_cast<unsigned char>(row[x] +
+                paeth(left, up[x], upLeft));
+    }
+}
+
+#if defined(DECODER_SSE)
+
+// Sub, Avg and Paeth depend on the pixel to the left, so the SIMD versions
+// go one pixel per step with all its channels at once. Only used for RGBA,
+// the odd sized loads and stores of RGB cost more than they save
+
+template <int bpp>
+static inline __m128i loadPixel(const unsigned char* const pixel) noexcept {
+    auto value = 0;
+    std::memcpy(&value, pixel, bpp);
+    return _mm_cvtsi32_si128(value);
+}
+
+template <int bpp>
+static inline void storePixel(unsigned char* const pixel,
+        const __m128i value) noexcept {
+    const auto packed = _mm_cvtsi128_si32(value);
+    std::memcpy(pixel, &packed, bpp);
+}
+
+template <int bpp>
+static void unfilterSubSse(unsigned char* const row,
+        const std::size_t bytes) noexcept {
+    auto left = _mm_setzero_si128();
+    for (auto x = std::size_t(0); x + bpp <= bytes; x += bpp) {
+        left = _mm_add_epi8(left, loadPixel<bpp>(row + x));
+        storePixel<bpp>(row + x, left);
+    }
+}
+
+template <int bpp>
+static void unfilterAverageSse(unsigned char* const row,
+        const unsigned char* const up, const std::size_t bytes) noexcept {
+    const auto one = _mm_set1_epi8(1);
+    auto left = _mm_setzero_si128();
+    for (auto x = std::size_t(0); x + bpp <= bytes; x += bpp) {
+        // floor((a + b)/2) = avg_epu8 rounding up, minus the odd bit
+        const auto above = loadPixel<bpp>(up + x);
+        const auto average = _mm_sub_epi8(_mm_avg_epu8(left, above),
+                _mm_and_si128(_mm_xor_si128(left, above), one));
+        left = _mm_add_epi8(average, loadPixel<bpp>(row + x));
+        storePixel<bpp>(row + x, left);
+    }
+}
+
+template <int bpp>
+static void unfilterPaethSse(unsigned char* const row,
+        const unsigned char* const up, const std::size_t bytes) noexcept {
+    const auto zero = _mm_setzero_si128();
+    const auto absolute = [zero](const __m128i x) {
+        return _mm_max_epi16(x, _mm_sub_epi16(zero, x));
+    };
+    const auto select = [](const __m128i mask, const __m128i a,
+            const __m128i b) {
+        return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+    };
+
+    auto a = zero;
+    auto c = zero;
+    for (auto x = std::size_t(0); x + bpp <= bytes; x += bpp) {
+        const auto b = _mm_unpacklo_epi8(loadPixel<bpp>(up + x), zero);
+        const auto pa = absolute(_mm_sub_epi16(b, c));
+        const auto pb = absolute(_mm_sub_epi16(a, c));
+        const auto pc = absolute(_mm_add_epi16(_mm_sub_epi16(b, c),
+                _mm_sub_epi16(a, c)));
+        const auto smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+        // Ties favour a over b over c
+        const auto nearest = select(_mm_cmpeq_epi16(smallest, pa), a,
+                select(_mm_cmpeq_epi16(smallest, pb), b, c));
+        const auto value = _mm_add_epi8(_mm_packus_epi16(nearest, nearest),
+                loadPixel<bpp>(row + x));
+        storePixel<bpp>(row + x, value);
+        a = _mm_unpacklo_epi8(value, zero);
+        c = b;
+    }
+}
+
+#endif
+
+// up is a zero row for the first row
+static bool unfilterRow(const unsigned char filter, unsigned char* const row,
+        const unsigned char* const up, const std::size_t bytes,
+        const int bpp) noexcept {
+    switch (filter) {
+    case 0:
+        return true;
+    case 1:
+#if defined(DECODER_SSE)
+        if (bpp == 4) {
+            unfilterSubSse<4>(row, bytes);
+            return true;
+        }
+#endif
+        unfilterSub(row, bytes, bpp);
+        return true;
+    case 2:
+        for (auto x = std::size_t(0); x < bytes; ++x) {
+            row[x] = static_cast<unsigned char>(row[x] + up[x]);
+        }
+        return true;
+    case 3:
+#if defined(DECODER_SSE)
+        if (bpp == 4) {
+            unfilterAverageSse<4>(row, up, bytes);
+            return true;
+        }
+#endif
+        unfilterAverage(row, up, bytes, bpp);
+        return true;
+    case 4:
+#if defined(DECODER_SSE)
+        if (bpp == 4) {
+            unfilterPaethSse<4>(row, up, bytes);
+            return true;
+        }
+#endif
+        unfilterPaeth(row, up, bytes, bpp);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// PNG
+
+constexpr unsigned char pngSignature[8] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+};
+
+static auto readBigEndian(const unsigned char* const bytes) noexcept {
+    return (std::uint32_t(bytes[0]) << 24) | (std::uint32_t(bytes[1]) << 16) |
+            (std::uint32_t(bytes[2]) << 8) | std::uint32_t(bytes[3]);
+}
+
+struct PngHeader {
+    std::uint32_t width;
+    std::uint32_t height;
+    int bitDepth;
+    int colorType;
+    int interlace;
+};
+
+static auto channelCount(const int colorType) noexcept {
+    switch (colorType) {
+    case 0: // Grey
+    case 3: // Palette
+        return 1;
+    case 4: // Grey, alpha
+        return 2;
+    case 2: // RGB
+        return 3;
+    case 6: // RGBA
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static bool readPngHeader(const unsigned char* const data,
+        const std::size_t size, PngHeader& header) noexcept {
+    if (size < 33u || std::memcmp(data, pngSignature, 8u) != 0 ||
+            std::memcmp(data + 12, "IHDR", 4u) != 0) {
+        return false;
+    }
+    header.width = readBigEndian(data + 16);
+    header.height = readBigEndian(data + 20);
+    header.bitDepth = data[24];
+    header.colorType = data[25];
+    header.interlace = data[28];
+    return header.width > 0u && header.height > 0u &&
+            header.width <= 1u << 15 && header.height <= 1u << 15 &&
+            header.bitDepth == 8 && header.interlace == 0 &&
+            channelCount(header.colorType) > 0;
+}
+
+bool PngDecoder::accepts(const unsigned char* const data,
+        const std::size_t size) const noexcept {
+    auto header = PngHeader();
+    return readPngHeader(data, size, header);
+}
+
+bool PngDecoder::decode(const unsigned char* const data,
+        const std::size_t size, const ImageStaging& staging) const noexcept {
+    auto header = PngHeader();
+    if (!readPngHeader(data, size, header)) {
+        return false;
+    }
+
+    // Gather the compressed stream and the palette
+
+    auto compressed = std::vector<unsigned char>();
+    unsigned char palette[256][4] = {};
+    for (auto& entry : palette) {
+        entry[3] = 255;
+    }
+    auto transparency = false;
+    auto offset = std::size_t(8);
+    while (offset + 12u <= size) {
+        const auto length = std::size_t(readBigEndian(data + offset));
+        const auto type = data + offset + 4;
+        const auto chunk = data + offset + 8;
+        if (length > size - offset - 12u) {
+            return false;
+        }
+        if (std::memcmp(type, "IDAT", 4u) == 0) {
+            compressed.insert(compressed.end(), chunk, chunk + length);
+        }
+        else if (std::memcmp(type, "PLTE", 4u) == 0) {
+            for (auto i = std::size_t(0); i < std::min<std::size_t>(
+                    length/3u, 256u); ++i) {
+                std::memcpy(palette[i], chunk + i*3u, 3u);
+            }
+        }
+        else if (std::memcmp(type, "tRNS", 4u) == 0) {
+            transparency = true;
+            if (header.colorType == 3) {
+                for (auto i = std::size_t(0); i < std::min<std::size_t>(
+                        length, 256u); ++i) {
+                    palette[i][3] = chunk[i];
+                }
+            }
+        }
+        else if (std::memcmp(type, "IEND", 4u) == 0) {
+            break;
+        }
+        offset += length + 12u;
+    }
+
+    // Colour keys aren't handled, SOIL2 takes those
+    if (transparency && header.colorType != 3) {
+        return false;
+    }
+
+    const auto width = static_cast<int>(header.width);
+    const auto height = static_cast<int>(header.height);
+    const auto bpp = channelCount(header.colorType);
+    const auto rowBytes = static_cast<std::size_t>(width)*bpp;
+    auto filtered = std::vector<unsigned char>((rowBytes + 1u)*height);
+    if (!inflate(compressed.data(), compressed.size(),
+            filtered.data(), filtered.size())) {
+        return false;
+    }
+
+    const auto pixels = staging(width, height);
+    if (!pixels) {
+        return false;
+    }
+
+    // RGBA rows are final once unfiltered, so they are unfiltered in place.
+    // Other types go through a row buffer and are expanded to RGBA
+
+    const auto zeroRow = std::vector<unsigned char>(rowBytes);
+    auto rows = std::vector<unsigned char>(header.colorType == 6 ?
+            0u : rowBytes*2u);
+    for (auto y = 0; y < height; ++y) {
+        const auto source = filtered.data() + (rowBytes + 1u)*y;
+        const auto outRow = pixels + static_cast<std::size_t>(y)*width*4u;
+
+        if (header.colorType == 6) {
+            std::memcpy(outRow, source + 1, rowBytes);
+            const auto up = y > 0 ? outRow - rowBytes : zeroRow.data();
+            if (!unfilterRow(source[0], outRow, up, rowBytes, bpp)) {
+                return false;
+            }
+            continue;
+        }
+
+        const auto row = rows.data() + (y & 1)*rowBytes;
+        const auto up = y > 0 ? rows.data() + ((y - 1) & 1)*rowBytes :
+                zeroRow.data();
+        std::memcpy(row, source + 1, rowBytes);
+        if (!unfilterRow(source[0], row, up, rowBytes, bpp)) {
+            return false;
+        }
+
+        auto out = outRow;
+        switch (header.colorType) {
+        case 0:
+            for (auto x = 0; x < width; ++x, out += 4) {
+                out[0] = out[1] = out[2] = row[x];
+                out[3] = 255;
+            }
+            break;
+        case 2:
+            for (auto x = 0; x < width; ++x, out += 4) {
+                out[0] = row[x*3];
+                out[1] = row[x*3 + 1];
+                out[2] = row[x*3 + 2];
+                out[3] = 255;
+            }
+            break;
+        case 3:
+            for (auto x = 0; x < width; ++x, out += 4) {
+                std::memcpy(out, palette[row[x]], 4u);
+            }
+            break;
+        case 4:
+            for (auto x = 0; x < width; ++x, out += 4) {
+                out[0] = out[1] = out[2] = row[x*2];
+                out[3] = row[x*2 + 1];
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+// SOIL2
+
+bool SoilDecoder::accepts(const unsigned char* const,
+        const std::size_t size) const noexcept {
+    return size > 0u;
+}
+
+bool SoilDecoder::decode(const unsigned char* const data,
+        const std::size_t size, const ImageStaging& staging) const noexcept {
+    auto width = 0;
+    auto height = 0;
+    const auto image = SOIL_load_image_from_memory(data,
+            static_cast<int>(size), &width, &height, nullptr, SOIL_LOAD_RGBA);
+    if (!image) {
+        return false;
+    }
+    const auto pixels = staging(width, height);
+    if (pixels) {
+        std::memcpy(pixels, image, static_cast<std::size_t>(width)*height*4u);
+    }
+    SOIL_free_image_data(image);
+    return pixels != nullptr;
+}
+
+// Registry
+
+ImageDecoders::ImageDecoders() noexcept {
+    decoders.push_back(std::make_unique<PngDecoder>());
+    decoders.push_back(std::make_unique<SoilDecoder>());
+    builtIn = decoders.size();
+}
+
+void ImageDecoders::add(std::unique_ptr<ImageDecoder> decoder) noexcept {
+    decoders.insert(decoders.end() - static_cast<std::ptrdiff_t>(builtIn),
+            std::move(decoder));
+}
+
+bool ImageDecoders::decode(const unsigned char* const data,
+        const std::size_t size, const ImageStaging& staging) const noexcept {
+    for (const auto& decoder : decoders) {
+        if (decoder->accepts(data, size) &&
+                decoder->decode(data, size, staging)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ImageDecoders::load(const char* const fileName,
+        std::vector<unsigned char>& rgba, int& width,
+        int& height) const noexcept {
+    const auto file = std::fopen(fileName, "rb");
+    if (!file) {
+        std::cout << "Image \"" << fileName << "\" not found\n";
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    const auto size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    auto data = std::vector<unsigned char>(size > 0 ?
+            static_cast<std::size_t>(size) : 0u);
+    const auto read = std::fread(data.data(), 1u, data.size(), file);
+    std::fclose(file);
+    if (read != data.size()) {
+        std::cout << "Image \"" << fileName << "\" can't be read\n";
+        return false;
+    }
+
+    const auto decoded = decode(data.data(), data.size(),
+            [&](const int imageWidth, const int imageHeight) {
+        width = imageWidth;
+        height = imageHeight;
+        rgba.resize(static_cast<std::size_t>(width)*height*4u);
+        return rgba.data();
+    });
+    if (!decoded) {
+        std::cout << "Image \"" << fileName << "\" can't be decoded\n";
+    }
+    return decoded;
+}
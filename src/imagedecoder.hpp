@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Called by a decoder once the size is known, returns where the RGBA8
+// pixels (width*height*4 bytes, rows top to bottom) go, e.g. a mapped
+// pixel buffer. Returning nullptr cancels decoding
+using ImageStaging = std::function<unsigned char*(const int width,
+        const int height)>;
+
+class ImageDecoder {
+public:
+    virtual ~ImageDecoder() noexcept = default;
+
+    virtual const char* name() const noexcept = 0;
+
+    // Cheap check of the signature and header, no decoding
+    virtual bool accepts(const unsigned char* const data,
+            const std::size_t size) const noexcept = 0;
+
+    virtual bool decode(const unsigned char* const data,
+            const std::size_t size,
+            const ImageStaging& staging) const noexcept = 0;
+};
+
+// 8 bit, non-interlaced PNG of any colour type. Inflate and unfiltering
+// are done here, RGBA rows are unfiltered in place in the staging memory
+class PngDecoder : public ImageDecoder {
+public:
+    const char* name() const noexcept override { return "png"; }
+    bool accepts(const unsigned char* const data,
+            const std::size_t size) const noexcept override;
+    bool decode(const unsigned char* const data, const std::size_t size,
+            const ImageStaging& staging) const noexcept override;
+};
+
+// Everything SOIL2 reads, decoded into its own memory and copied
+class SoilDecoder : public ImageDecoder {
+public:
+    const char* name() const noexcept override { return "soil2"; }
+    bool accepts(const unsigned char* const data,
+            const std::size_t size) const noexcept override;
+    bool decode(const unsigned char* const data, const std::size_t size,
+            const ImageStaging& staging) const noexcept override;
+};
+
+// Decoders are tried in order, added ones before the PNG fast path and
+// SOIL2 last. Decoding is const and may run on several threads at once
+class ImageDecoders {
+public:
+    ImageDecoders() noexcept;
+
+    void add(std::unique_ptr<ImageDecoder> decoder) noexcept;
+
+    // The first decoder that accepts and decodes the data wins
+    bool decode(const unsigned char* const data, const std::size_t size,
+            const ImageStaging& staging) const noexcept;
+
+    // Reads the file and decodes into rgba, keeping its capacity
+    bool load(const char* const fileName, std::vector<unsigned char>& rgba,
+            int& width, int& height) const noexcept;
+
+private:
+    std::vector<std::unique_ptr<ImageDecoder>> decoders;
+    std::size_t builtIn = 0;
+};
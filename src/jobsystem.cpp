@@ -0,0 +1,214 @@
+#include "jobsystem.hpp"
+
+#include <cassert>
+#include <cstring>
+
+// Spins before a worker with nothing to do goes to sleep
+constexpr auto idleSpins = 64;
+
+// Which worker of which system the calling thread is
+thread_local const JobSystem* currentSystem = nullptr;
+thread_local unsigned currentWorker = 0u;
+
+// Deque
+
+bool WorkStealingDeque::push(Job* const job) noexcept {
+    const auto b = bottom.load(std::memory_order_relaxed);
+    const auto t = top.load(std::memory_order_acquire);
+    if (b - t >= capacity) {
+        return false;
+    }
+    jobs[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+    bottom.store(b + 1, std::memory_order_release);
+    return true;
+}
+
+Job* WorkStealingDeque::pop() noexcept {
+    const auto b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto t = top.load(std::memory_order_relaxed);
+
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto job = jobs[b & (capacity - 1)].load(std::memory_order_relaxed);
+    if (t == b) {
+        // Last job, race the thieves for it
+        if (!top.compare_exchange_strong(t, t + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job* WorkStealingDeque::steal() noexcept {
+    auto t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+        return nullptr;
+    }
+    const auto job = jobs[t & (capacity - 1)].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1,
+            std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+// System
+
+JobSystem::JobSystem(const unsigned requestedWorkers) noexcept {
+    workersCount = requestedWorkers != 0u ? requestedWorkers :
+            std::max(1u, std::thread::hardware_concurrency());
+    workers = std::make_unique<Worker[]>(workersCount);
+    for (auto index = 0u; index < workersCount; ++index) {
+        workers[index].jobs = std::make_unique<Job[]>(jobsPerWorker);
+        workers[index].random = 2654435761u*(index + 1u);
+    }
+
+    currentSystem = this;
+    currentWorker = 0u;
+    for (auto index = 1u; index < workersCount; ++index) {
+        workers[index].thread = std::thread(&JobSystem::workerMain,
+                this, index);
+    }
+}
+
+JobSystem::~JobSystem() noexcept {
+    {
+        const auto lock = std::lock_guard<std::mutex>(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto index = 1u; index < workersCount; ++index) {
+        workers[index].thread.join();
+    }
+    if (currentSystem == this) {
+        currentSystem = nullptr;
+    }
+}
+
+unsigned JobSystem::workerIndex() noexcept {
+    return currentSystem ? currentWorker : 0u;
+}
+
+JobSystem::Worker& JobSystem::current() noexcept {
+    // Other threads would share worker 0's deque and ring with it
+    assert(currentSystem == this && "jobs started outside the system");
+    return workers[currentSystem == this ? currentWorker : 0u];
+}
+
+Job& JobSystem::allocate() noexcept {
+    auto& worker = current();
+    auto& job = worker.jobs[worker.allocated++ % jobsPerWorker];
+    while (job.live.load(std::memory_order_acquire)) {
+        if (const auto other = find(worker)) {
+            execute(*other);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+    job.live.store(true, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::submit(Job& job) noexcept {
+    job.counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    // A full deque means the job is run right away
+    if (!current().deque.push(&job)) {
+        execute(job);
+        return;
+    }
+
+    queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+    if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        // Taking the lock orders this after a sleeper's last check
+        { const auto lock = std::lock_guard<std::mutex>(sleepMutex); }
+        wake.notify_one();
+    }
+}
+
+Job* JobSystem::find(Worker& worker) noexcept {
+    if (const auto job = worker.deque.pop()) {
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+        return job;
+    }
+
+    // Random victim first, then everyone in order
+    worker.random ^= worker.random << 13;
+    worker.random ^= worker.random >> 17;
+    worker.random ^= worker.random << 5;
+    const auto first = worker.random % workersCount;
+    for (auto offset = 0u; offset < workersCount; ++offset) {
+        auto& victim = workers[(first + offset) % workersCount];
+        if (&victim == &worker) {
+            continue;
+        }
+        if (const auto job = victim.deque.steal()) {
+            queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(Job& job) noexcept {
+    // Runs from a copy so the slot is free while the job runs, a job
+    // waiting on others never holds up its thread's ring
+    auto local = Job();
+    local.function = job.function;
+    local.counter = job.counter;
+    std::memcpy(local.data, job.data, Job::dataSize);
+    job.live.store(false, std::memory_order_release);
+
+    const auto counter = local.counter;
+    local.function(local);
+    counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void JobSystem::wait(const JobCounter& counter) noexcept {
+    auto& worker = current();
+    while (!counter.done()) {
+        if (const auto job = find(worker)) {
+            execute(*job);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::workerMain(const unsigned index) noexcept {
+    currentSystem = this;
+    currentWorker = index;
+    auto& worker = workers[index];
+
+    auto idle = 0;
+    while (!stopping.load(std::memory_order_relaxed)) {
+        if (const auto job = find(worker)) {
+            execute(*job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < idleSpins) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        auto lock = std::unique_lock<std::mutex>(sleepMutex);
+        sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        wake.wait(lock, [this] {
+            return stopping.load(std::memory_order_relaxed) ||
+                    queuedJobs.load(std::memory_order_seq_cst) > 0;
+        });
+        sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        idle = 0;
+    }
+}
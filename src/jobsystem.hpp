@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// Counts unfinished jobs. A job may wait on the counter of the jobs it
+// depends on, waiting runs other jobs meanwhile
+class JobCounter {
+public:
+    bool done() const noexcept {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> pending{0};
+};
+
+struct Job {
+    static constexpr auto dataSize = 48u;
+
+    void (*function)(Job& job) noexcept;
+    JobCounter* counter;
+    std::atomic<bool> live{false}; // Queued, the slot is taken
+    alignas(16) unsigned char data[dataSize];
+};
+
+// Chase-Lev work-stealing deque of fixed capacity (Le, Pop, Cohen and
+// Zappa Nardelli, 2013). The owner pushes and pops at the bottom, other
+// workers steal from the top
+class WorkStealingDeque {
+public:
+    static constexpr auto capacity = std::int64_t(4096);
+
+    bool push(Job* const job) noexcept;
+    Job* pop() noexcept;
+    Job* steal() noexcept;
+
+private:
+    alignas(64) std::atomic<std::int64_t> top{0};
+    alignas(64) std::atomic<std::int64_t> bottom{0};
+    alignas(64) std::atomic<Job*> jobs[capacity];
+};
+
+// One worker per core, the thread that creates the system is worker 0 and
+// runs jobs while it waits. Jobs may be started from worker 0 and from
+// inside jobs, no other thread. Each thread recycles a ring of Job slots,
+// a job leaves its slot when it starts running. When the next slot's job
+// is still queued the thread runs other jobs until it is taken
+
+class JobSystem {
+public:
+    static constexpr auto jobsPerWorker = 4096u;
+    static constexpr auto maxParallelForJobs = jobsPerWorker/4u;
+
+    // 0 - one worker per hardware thread
+    explicit JobSystem(unsigned workerCount = 0u) noexcept;
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem() noexcept;
+
+    unsigned workerCount() const noexcept { return workersCount; }
+
+    // Worker the calling thread runs as, 0 for threads outside any system
+    static unsigned workerIndex() noexcept;
+
+    // function is copied into the job, it must fit Job::dataSize
+    template <typename Function>
+    void run(JobCounter& counter, Function function) noexcept {
+        static_assert(sizeof(Function) <= Job::dataSize,
+                "job function too large");
+        static_assert(alignof(Function) <= 16, "job function overaligned");
+        static_assert(std::is_trivially_copyable<Function>::value,
+                "job function must be trivially copyable");
+
+        auto& job = allocate();
+        new (job.data) Function(std::move(function));
+        job.function = [](Job& self) noexcept {
+            (*std::launder(reinterpret_cast<Function*>(self.data)))();
+        };
+        job.counter = &counter;
+        submit(job);
+    }
+
+    // Calls function(begin, end) over [0, count) in chunks of grain, or
+    // larger ones so at most maxParallelForJobs jobs are started
+    template <typename Function>
+    void parallelFor(const std::size_t count, const std::size_t grain,
+            const Function& function) noexcept {
+        auto counter = JobCounter();
+        const auto step = std::max<std::size_t>(grain,
+                (count + maxParallelForJobs - 1u)/maxParallelForJobs);
+        for (auto begin = std::size_t(0); begin < count; begin += step) {
+            const auto end = std::min(count, begin + step);
+            run(counter, [&function, begin, end] { function(begin, end); });
+        }
+        wait(counter);
+    }
+
+    void wait(const JobCounter& counter) noexcept;
+
+private:
+    struct Worker {
+        WorkStealingDeque deque;
+        std::unique_ptr<Job[]> jobs;
+        unsigned allocated = 0u;
+        std::uint32_t random = 0u;
+        std::thread thread;
+    };
+
+    Job& allocate() noexcept;
+    void submit(Job& job) noexcept;
+    Job* find(Worker& worker) noexcept;
+    void execute(Job& job) noexcept;
+    void workerMain(const unsigned index) noexcept;
+    Worker& current() noexcept;
+
+    std::unique_ptr<Worker[]> workers;
+    unsigned workersCount = 0u;
+
+    // Sleeping when idle
+    std::atomic<int> queuedJobs{0};
+    std::atomic<int> sleepingWorkers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<bool> stopping{false};
+};
@@ -4,14 +4,43 @@
 #include <glm/vec3.hpp>
 #include <glm/vec2.hpp>
 #include <glm/ext.hpp>
-#include <SOIL2/SOIL2.h>
 
+#include "atlas.hpp"
+#include "bvh.hpp"
+#include "commandbuffer.hpp"
+#include "cookedmesh.hpp"
+#include "culling.hpp"
+#include "framearena.hpp"
+#include "framepacer.hpp"
+#include "glstatecache.hpp"
+#include "gpuallocator.hpp"
+#include "gpuculling.hpp"
+#include "hiz.hpp"
+#include "imagedecoder.hpp"
+#include "jobsystem.hpp"
+#include "materials.hpp"
+#include "mesh.hpp"
+#include "meshlet.hpp"
+#include "meshloader.hpp"
+#include "meshlod.hpp"
+#include "meshoptimizer.hpp"
+#include "mipgen.hpp"
+#include "renderqueue.hpp"
+#include "renderthread.hpp"
+#include "residency.hpp"
+#include "shaders.hpp"
+#include "streambuffer.hpp"
+#include "virtualtexture.hpp"
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <fstream>
 #include <iostream>
 #include <streambuf>
 #include <type_traits>
+#include <vector>
 
 class GLFWRAII {
 public:
@@ -23,142 +52,203 @@ public:
     }
 };
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 color;
-    glm::vec2 texcoord;
+// The cooked model is mapped and uploaded as is, the source model is
+// imported, given levels of detail, optimized and split in meshlets when
+// it is missing and the quad when both are
+constexpr auto cookedModelName = "rsc/model.mesh";
+constexpr auto modelName = "rsc/model.obj";
+
+// Copies of the model in rows going away from the camera. They are culled
+// and drawn from the CPU or, toggled with G, culled by a compute pass and
+// drawn instanced with one indirect call
+constexpr auto objectColumns = 5u;
+constexpr auto objectRows = 4u;
+constexpr auto objectCount = objectColumns*objectRows;
+
+// The sample's image cooked into tiles by texturecooker, the CPU path's
+// objects sample it instead of their material when toggled with V
+constexpr auto virtualTextureName = "rsc/ilufan.vtex";
+constexpr auto virtualTextureBudgetTiles = 64;
+
+// Draws recorded per command buffer, one buffer is one job
+constexpr auto drawsPerCommandBuffer = std::size_t(256);
+
+// Per-frame uniforms and the meshlet draws' arguments are streamed,
+// matches FrameUniforms in the shaders
+constexpr auto frameUniformsBinding = 0u;
+constexpr auto streamBytesPerFrame = std::uint32_t(1) << 20;
+
+// Half the frame's stream goes to meshlet draws, objects past it are drawn
+// by submesh
+constexpr auto maxIndirectDraws = streamBytesPerFrame/2u/
+        sizeof(IndexedIndirectArgs);
+
+// Per-instance data of the GPU culled path, see shaders/vertexinstanced.glsl
+constexpr auto instanceTransformsBinding = 5u;
+constexpr auto instanceMaterialsBinding = 7u;
+constexpr auto instanceIdAttribute = 3u;
+constexpr auto instanceIdBinding = 1u;
+
+struct FrameUniforms {
+    glm::mat4 viewMatrix;
+    glm::mat4 projectionMatrix;
 };
 
-static auto readAll(const char* const fileName) noexcept {
-    auto file = std::ifstream(fileName);
-    file.seekg(0, std::ios::end);
-    auto buffer = std::string(static_cast<size_t>(file.tellg()), '\0');
-    file.seekg(0, std::ios::beg);
-    buffer.assign((std::istreambuf_iterator<char>(file)),
-            std::istreambuf_iterator<char>());
-    return buffer;
-}
+// Built by the main thread, drawn by the render thread
+struct FrameData {
+    FramePacer::Clock::time_point inputTime;
+    FrameUniforms uniforms;
+    int width = 0;
+    int height = 0;
+    std::vector<glm::mat4> objectMatrices;
+    bool gpuCulling = false;
+    bool virtualTexturing = false;
+    float textureScreenSize = 0.f; // Largest object on screen, in pixels
+    Frustum frustum;
+    std::vector<InstanceBounds> instanceBounds;
+    RenderQueue renderQueue;
+    std::vector<IndexedIndirectArgs> indirectDraws;
+    std::vector<CommandBuffer> commandBuffers;
+    std::size_t commandBufferCount = 0u;
+};
 
-static auto compileShader(const int shaderFlag,
-        const char* const srcName) noexcept {
-    const auto shaderId = glCreateShader(shaderFlag);
-    auto fileContent = readAll(srcName);
-    const GLchar* shadersSrcs[] = { fileContent.data() };
-    glShaderSource(shaderId, 1, shadersSrcs, nullptr);
-    glCompileShader(shaderId);
-    return shaderId;
+static auto makeQuadMesh() noexcept {
+    auto mesh = Mesh();
+    mesh.vertices = {
+        { glm::vec3(.5f, -.5f, .0f), glm::vec3(1.f, 0.f, 0.f),
+                glm::vec2(1.f, 0.f) },
+        { glm::vec3(.5f, .5f, .0f), glm::vec3(1.f, 1.f, 0.f),
+                glm::vec2(1.f, 1.f) },
+        { glm::vec3(-.5f, .5f, .0f), glm::vec3(0.f, 1.f, 0.f),
+                glm::vec2(0.f, 1.f) },
+        { glm::vec3(-.5f, -.5f, .0f), glm::vec3(0.f, 0.f, 1.f),
+                glm::vec2(0.f, 0.f) }
+    };
+    mesh.indices = {
+        0, 1, 2,
+        0, 2, 3
+    };
+    mesh.submeshes.push_back(Submesh{ 0u, 6u, 0u });
+    computeBounds(mesh);
+    return mesh;
 }
 
-static auto showShaderCompileError(const GLint shaderId) noexcept {
-    const auto bufferSize = 512;
-    char buffer[bufferSize];
-    glGetShaderInfoLog(shaderId,
-            bufferSize, nullptr, buffer);
-    std::cout << "Shader compiling error! Log:\n" <<
-            buffer << std::endl;
-}
+struct InputState {
+    bool gpuCulling = false;
+    bool togglePressed = false;
+    bool virtualTexturing = false;
+    bool virtualTogglePressed = false;
+    bool pick = false; // Clicked this frame
+    bool pickPressed = false;
+};
 
-static auto loadShader(const int shaderFlag,
-        const char* const srcName) noexcept {
-    const auto shaderId = compileShader(shaderFlag, srcName);
-    GLint success;
-    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        showShaderCompileError(shaderId);
-        return static_cast<decltype(shaderId)>(-1);
+static auto processWindowInput(GLFWwindow* const window,
+        InputState& input) noexcept {
+    if (glfwGetKey(window, GLFW_KEY_BACKSPACE) == GLFW_PRESS) {
+        glfwSetWindowShouldClose(window, GLFW_TRUE);
     }
-    return shaderId;
-}
 
-static auto showProgramLinkError(const GLint programId) noexcept {
-    const auto bufferSize = 512;
-    char buffer[bufferSize];
-    glGetProgramInfoLog(programId,
-            bufferSize, nullptr, buffer);
-    std::cout << "Program linking error! Log:\n" <<
-            buffer << std::endl;
+    // Toggles once per press, not every frame the key is down
+    const auto toggle = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+    if (toggle && !input.togglePressed) {
+        input.gpuCulling = !input.gpuCulling;
+    }
+    input.togglePressed = toggle;
+
+    const auto virtualToggle = glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS;
+    if (virtualToggle && !input.virtualTogglePressed) {
+        input.virtualTexturing = !input.virtualTexturing;
+    }
+    input.virtualTogglePressed = virtualToggle;
+
+    const auto click = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) ==
+            GLFW_PRESS;
+    input.pick = click && !input.pickPressed;
+    input.pickPressed = click;
 }
 
-using RType = std::result_of_t<decltype(glCreateProgram)()>;
+// Ray from the eye through the cursor, in world space
+static auto cursorRay(GLFWwindow* const window,
+        const glm::mat4& viewProjectionMatrix) noexcept {
+    auto cursorX = 0.;
+    auto cursorY = 0.;
+    auto windowWidth = 0;
+    auto windowHeight = 0;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+
+    const auto x = float(cursorX)/std::max(windowWidth, 1)*2.f - 1.f;
+    const auto y = 1.f - float(cursorY)/std::max(windowHeight, 1)*2.f;
+    const auto inverse = glm::inverse(viewProjectionMatrix);
+    const auto nearPoint = inverse*glm::vec4(x, y, -1.f, 1.f);
+    const auto farPoint = inverse*glm::vec4(x, y, 1.f, 1.f);
+    return glm::normalize(glm::vec3(farPoint)/farPoint.w -
+            glm::vec3(nearPoint)/nearPoint.w);
+}
 
-static auto loadShaders() noexcept {
-    // Load
+// Events are polled on the main thread, GL calls go to the render thread
+// once it runs
 
-    const auto vertexShaderId = loadShader(
-            GL_VERTEX_SHADER, "shaders/vertexcore.glsl");
-    if (vertexShaderId == -1) {
-        glUseProgram(0u);
-        return static_cast<RType>(-1);
+static auto frameBufferResizeCallback(GLFWwindow* const window,
+        const int frameWidth, const int frameHeight) noexcept {
+    const auto renderThread = static_cast<RenderThread*>(
+            glfwGetWindowUserPointer(window));
+    if (renderThread) {
+        renderThread->resize(frameWidth, frameHeight);
     }
-    const auto fragmentShaderId = loadShader(
-            GL_FRAGMENT_SHADER, "shaders/fragmentcore.glsl");
-    if (fragmentShaderId == -1) {
-        glDeleteShader(vertexShaderId);
-        glUseProgram(0u);
-        return static_cast<RType>(-1);
+    else {
+        glViewport(0, 0, frameWidth, frameHeight);
     }
+}
 
-    // Program
+static auto createVertexArray(const GLuint vertexBuffer,
+        const GLuint indexBuffer) noexcept {
+    GLuint vao;
+    glCreateVertexArrays(1, &vao);
+    glVertexArrayVertexBuffer(vao, 0, vertexBuffer, 0, sizeof(Vertex));
+    glVertexArrayElementBuffer(vao, indexBuffer);
 
-    const auto programId = glCreateProgram();
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
+    // Vertex attribute formats (input assembly)
 
-    glLinkProgram(programId);
-    
-    GLint success;
-    glGetProgramiv(programId, GL_LINK_STATUS, &success);
-    if (!success) {
-        showProgramLinkError(programId);
-    }
+    // vertex_position
 
-    // Exit
+    glVertexArrayAttribFormat(vao, 0, 3, GL_FLOAT, GL_TRUE,
+            offsetof(Vertex, position));
+    glVertexArrayAttribBinding(vao, 0, 0);
+    glEnableVertexArrayAttrib(vao, 0);
 
-    glUseProgram(0u);
-    glDeleteShader(vertexShaderId);
-    glDeleteShader(fragmentShaderId);
-    return programId;
-}
+    // vertex_color
 
-static auto processWindowInput(GLFWwindow* const window) noexcept {
-    if (glfwGetKey(window, GLFW_KEY_BACKSPACE) == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, GLFW_TRUE);
-    }
-}
+    glVertexArrayAttribFormat(vao, 1, 3, GL_FLOAT, GL_TRUE,
+            offsetof(Vertex, color));
+    glVertexArrayAttribBinding(vao, 1, 0);
+    glEnableVertexArrayAttrib(vao, 1);
 
-static auto frameBufferResizeCallback(GLFWwindow* const window,
-        const int frameWidth, const int frameHeight) noexcept {
-    glViewport(0, 0, frameWidth, frameHeight);
+    // vertex_texcoord
+
+    glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_TRUE,
+            offsetof(Vertex, texcoord));
+    glVertexArrayAttribBinding(vao, 2, 0);
+    glEnableVertexArrayAttrib(vao, 2);
+    return vao;
 }
 
-static auto loadTexture(const char* const imageName) noexcept {
+// Runs on a worker thread, decoding and mip generation stay off the GL thread
+
+static auto decodeTexture(const ImageDecoders& decoders,
+        const char* const imageName) noexcept {
+    auto image = std::vector<unsigned char>();
     auto imageWidth = 0;
     auto imageHeight = 0;
-    const auto image = SOIL_load_image(imageName,
-            &imageWidth, &imageHeight, nullptr, SOIL_LOAD_RGBA);
-
-    GLuint texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-
-    if (image) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-            imageWidth, imageHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    }
-    else {
+    if (!decoders.load(imageName, image, imageWidth, imageHeight)) {
         std::cout << "Texture \"" << imageName << "\" loading failed\n";
+        return MipChain();
     }
 
-    glActiveTexture(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
-    SOIL_free_image_data(image);
-    return texture;
+    auto options = MipOptions();
+    options.srgb = true;
+    options.premultiplyAlpha = true;
+    return generateMips(image.data(), imageWidth, imageHeight, options);
 }
 
 int main() noexcept {
@@ -215,89 +305,202 @@ int main() noexcept {
 
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
-    // Init shaders
-
-    const auto programId = loadShaders();
+    // State cache, every bind below goes through it
 
-    // Model
+    auto stateCache = GLStateCache();
 
-    // Vertices
+    // Job system, the main thread is worker 0
 
-    Vertex vertices[] = {
-        glm::vec3(.5f, -.5f, .0f),
-        glm::vec3(1.f, 0.f, 0.f),
-        glm::vec2(1.f, 0.f),
+    auto jobs = JobSystem();
 
-        glm::vec3(.5f, .5f, .0f),
-        glm::vec3(1.f, 1.f, 0.f),
-        glm::vec2(1.f, 1.f),
+    // Start decoding textures while the rest is set up
 
-        glm::vec3(-.5f, .5f, .0f),
-        glm::vec3(0.f, 1.f, 0.f),
-        glm::vec2(0.f, 1.f),
+    const auto imageDecoders = ImageDecoders();
+    auto ilufanMips = MipChain();
+    auto boxMips = MipChain();
+    auto texturesDecoded = JobCounter();
+    jobs.run(texturesDecoded, [&imageDecoders, &ilufanMips] {
+        ilufanMips = decodeTexture(imageDecoders, "rsc/ilufan.png");
+    });
+    jobs.run(texturesDecoded, [&imageDecoders, &boxMips] {
+        boxMips = decodeTexture(imageDecoders, "rsc/box.png");
+    });
 
-        glm::vec3(-.5f, -.5f, .0f),
-        glm::vec3(0.f, 0.f, 1.f),
-        glm::vec2(0.f, 0.f)
-    };
-    constexpr auto verticesCount = sizeof(vertices)/sizeof(vertices[0]);
-
-    GLuint indeces[] = {
-        0, 1, 2,
-        0, 2, 3
-    };
-    constexpr auto indecesCount = sizeof(indeces)/sizeof(indeces[0]); 
-
-    // VAO, VBO, EBO
-    // Gen VAO and Bind
-
-    GLuint vao;
-    glCreateVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    // Gen VBO and Bind and send data
-
-    GLuint vbo;
-    glGenBuffers(1, &vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-            sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    // Gen EBO and Bind and send data
-
-    GLuint ebo;
-    glGenBuffers(1, &ebo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            sizeof(indeces), indeces, GL_STATIC_DRAW);
-
-    // Set vertex attribute pointers and enbale (input assembly)
+    // Model
 
-    // vertex_position
+    auto cookedMesh = CookedMesh();
+    auto importedMesh = Mesh();
+    auto importedIndices = PackedIndices();
+    auto mesh = MeshView();
+    if (cookedMesh.open(cookedModelName)) {
+        mesh = cookedMesh.view();
+    }
+    else {
+        if (loadMesh(modelName, importedMesh, &jobs)) {
+            generateLods(importedMesh);
+            optimizeMesh(importedMesh);
+            buildMeshlets(importedMesh);
+        }
+        else {
+            importedMesh = makeQuadMesh();
+        }
+        packIndices(importedMesh, importedIndices);
+        mesh = view(importedMesh, importedIndices);
+    }
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_TRUE, sizeof(Vertex),
-            reinterpret_cast<void*>(offsetof(Vertex, position)));
-    glEnableVertexAttribArray(0);
+    // Mesh buffers, meshes get ranges of a few shared buffer objects
 
-    // vertex_color
+    auto meshBuffers = GpuBufferAllocator();
+    const auto vertexAllocation = meshBuffers.allocate(
+            mesh.vertexCount*sizeof(Vertex), sizeof(Vertex));
+    // 16-bit indices too, the allocator works in 4 byte units
+    const auto indexAllocation = meshBuffers.allocate(
+            mesh.indexCount*mesh.indexSize, std::max(mesh.indexSize, 4u));
+    if (vertexAllocation == GpuBufferAllocator::invalid ||
+            indexAllocation == GpuBufferAllocator::invalid) {
+        return 0;
+    }
+    meshBuffers.upload(vertexAllocation, mesh.vertices);
+    meshBuffers.upload(indexAllocation, mesh.indices);
+    const auto vertexRange = meshBuffers.range(vertexAllocation);
+    const auto indexRange = meshBuffers.range(indexAllocation);
+
+    // VAO per buffer pair, the meshes sharing it are picked by the base
+    // vertex and index offset of the draw
+
+    const auto vao = createVertexArray(vertexRange.buffer, indexRange.buffer);
+
+    // Texture init, images that fit share atlas pages, the others are
+    // streamed, their finer mips only become resident when they are needed
+
+    jobs.wait(texturesDecoded);
+    MipChain* const quadMips[] = { &ilufanMips, &boxMips };
+    constexpr auto quadTextureCount = sizeof(quadMips)/sizeof(quadMips[0]);
+    auto atlas = TextureAtlas();
+    AtlasRegion atlasRegions[quadTextureCount];
+    bool packed[quadTextureCount];
+    for (auto i = std::size_t(0); i < quadTextureCount; ++i) {
+        packed[i] = atlas.add(*quadMips[i], atlasRegions[i]);
+    }
+    atlas.upload();
+
+    // Materials
+
+    auto materials = MaterialSystem();
+    auto residency = TextureResidency();
+    auto quadMaterial = Material();
+    // Residency ids and the material textures sampling them
+    auto streamedTextures = std::vector<std::uint32_t>();
+    auto streamedMaterialTextures = std::vector<std::uint32_t>();
+    for (auto i = std::size_t(0); i < quadTextureCount; ++i) {
+        if (packed[i]) {
+            const auto& region = atlasRegions[i];
+            quadMaterial.textures[i] = materials.addTexture(
+                    atlas.pageTexture(region.page), glm::vec4(region.uvMin,
+                    region.uvMax - region.uvMin));
+        }
+        else {
+            const auto fullSize = quadMips[i]->empty() ? glm::ivec2(0) :
+                    glm::ivec2(quadMips[i]->front().width,
+                    quadMips[i]->front().height);
+            const auto id = residency.add(std::move(*quadMips[i]));
+            if (id == UINT32_MAX) {
+                return 0;
+            }
+            quadMaterial.textures[i] = materials.addTexture(
+                    residency.texture(id), glm::vec4(0.f, 0.f, 1.f, 1.f),
+                    fullSize);
+            streamedTextures.push_back(id);
+            streamedMaterialTextures.push_back(quadMaterial.textures[i]);
+        }
+    }
+    const auto quadMaterialId = materials.addMaterial(quadMaterial);
+    if (!materials.build()) {
+        return 0;
+    }
 
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_TRUE, sizeof(Vertex),
-            reinterpret_cast<void*>(offsetof(Vertex, color)));
-    glEnableVertexAttribArray(1);
+    // Init shaders (the material path is picked by defines)
 
-    // vertex_texcoord
+    const auto programId = loadShaders("shaders/vertexcore.glsl",
+            "shaders/fragmentcore.glsl", materials.shaderDefines());
+    const auto instancedProgramId = loadShaders(
+            "shaders/vertexinstanced.glsl", "shaders/fragmentcore.glsl",
+            materials.shaderDefines());
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_TRUE, sizeof(Vertex),
-            reinterpret_cast<void*>(offsetof(Vertex, texcoord)));
-    glEnableVertexAttribArray(2);
+    // Virtual texturing, the draws sampling it mark the tiles they need
+    // and the texture streams them in from the cooked file
 
-    // Bind VAO 0
-    glBindVertexArray(0u);
+    auto virtualTexture = VirtualTexture();
+    auto virtualProgramId = static_cast<GLuint>(-1);
+    if (virtualTexture.create(virtualTextureName, virtualTextureBudgetTiles,
+            stateCache)) {
+        virtualProgramId = loadShaders("shaders/vertexcore.glsl",
+                "shaders/fragmentvirtual.glsl",
+                virtualTexture.shaderDefines());
+    }
+    const auto virtualTexturingAvailable =
+            virtualProgramId != static_cast<GLuint>(-1);
+    if (virtualTexturingAvailable) {
+        virtualTexture.applyUniforms(virtualProgramId);
+    }
+    else {
+        std::cout << "Virtual texturing unavailable, V does nothing\n";
+    }
 
-    // Texture init
-    
-    const auto ilufanTexture = loadTexture("rsc/ilufan.png");
-    const auto boxTexture = loadTexture("rsc/box.png");
+    // GPU culling, every submesh of the finest level is one draw with room
+    // for all objects. Levels of detail and meshlets are CPU path only
+
+    const auto indexType = mesh.indexSize == sizeof(std::uint16_t) ?
+            GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    const auto finestLod = lod(mesh, 0u);
+    auto gpuDraws = std::vector<DrawElementsIndirectCommand>();
+    for (auto submesh = mesh.submeshes + finestLod.firstSubmesh;
+            submesh != mesh.submeshes + finestLod.firstSubmesh +
+            finestLod.submeshCount; ++submesh) {
+        gpuDraws.push_back(DrawElementsIndirectCommand{ submesh->indexCount,
+                objectCount, indexRange.offset/mesh.indexSize +
+                submesh->firstIndex, static_cast<GLint>(
+                vertexRange.offset/sizeof(Vertex) + submesh->baseVertex),
+                0u });
+    }
+    const auto instanceCount = static_cast<GLuint>(gpuDraws.size())*
+            objectCount;
+    auto gpuCuller = GpuCuller();
+    const auto gpuCullingAvailable =
+            instancedProgramId != static_cast<GLuint>(-1) &&
+            gpuCuller.create(gpuDraws, instanceCount);
+    const auto instancedVao = createVertexArray(vertexRange.buffer,
+            indexRange.buffer);
+    GLuint instanceMaterials;
+    glCreateBuffers(1, &instanceMaterials);
+    {
+        const auto materialIds = std::vector<GLuint>(objectCount,
+                quadMaterialId);
+        glNamedBufferStorage(instanceMaterials,
+                materialIds.size()*sizeof(GLuint), materialIds.data(), 0);
+    }
+    if (gpuCullingAvailable) {
+        gpuCuller.bindInstanceAttribute(instancedVao, instanceIdAttribute,
+                instanceIdBinding);
+    }
+    else {
+        std::cout << "GPU culling unavailable, G does nothing\n";
+    }
+    auto storageAlignment = GLint(16);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT,
+            &storageAlignment);
+
+    // The GPU path also tests occlusion against a Hi-Z of the previous
+    // frame's depth, drawn with hiZMatrix. Render thread only once it runs
+
+    auto hiZ = HiZPyramid();
+    auto hiZAvailable = gpuCullingAvailable &&
+            hiZ.create(frameBufferWidth, frameBufferHeight);
+    auto hiZBuilt = false;
+    auto hiZMatrix = glm::mat4(1.f);
+    if (gpuCullingAvailable && !hiZAvailable) {
+        std::cout << "Hi-Z unavailable, GPU culling without occlusion\n";
+    }
 
     // Init metrics
 
@@ -325,29 +528,81 @@ int main() noexcept {
             static_cast<float>(frameBufferWidth)/frameBufferHeight,
             nearPlane, farPlane);
 
-    glUseProgram(programId);
+    stateCache.useProgram(programId);
 
-    glUniformMatrix4fv(glGetUniformLocation(programId, "modelMatrix"),
-            1, GL_FALSE, glm::value_ptr(modelMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(programId, "viewMatrix"),
-            1, GL_FALSE, glm::value_ptr(viewMatrix));
-    glUniformMatrix4fv(glGetUniformLocation(programId, "projectionMatrix"),
-            1, GL_FALSE, glm::value_ptr(projectionMatrix));
+    const auto modelMatrixLocation = glGetUniformLocation(
+            programId, "modelMatrix");
+    const auto materialIdLocation = glGetUniformLocation(
+            programId, "materialId");
+    const auto virtualModelMatrixLocation = glGetUniformLocation(
+            virtualProgramId, "modelMatrix");
 
-    glUseProgram(0);
+    materials.bind(stateCache);
 
-    // Main loop
+    // Streamed per-frame data
 
-    while (!glfwWindowShouldClose(window)) {
-        // Process events
+    auto streamBuffer = StreamBuffer();
+    if (!streamBuffer.create(streamBytesPerFrame)) {
+        return 0;
+    }
 
-        glfwPollEvents();
+    // Culling
+
+    // The sphere is centred on the model's origin
+    const auto meshRadius = glm::length(glm::max(glm::abs(mesh.boundsMin),
+            glm::abs(mesh.boundsMax)));
+    auto input = InputState();
+    auto objectBounds = BoundingSpheres();
+    auto objectBoxes = std::vector<BoundingBox>();
+    auto objectBvh = Bvh();
+    auto visibleObjects = std::vector<std::uint32_t>();
+    auto cullStats = CullStats();
+
+    // Meshlets of all levels, culled against the frustum and their cones
+    // before their triangles reach the vertex shader. This is the CPU path,
+    // per visible object into streamed multi-draws. GpuCuller's compute
+    // pass culls whole instances and leaves meshlets to it
+
+    auto clusterBounds = ClusterBounds();
+    for (auto meshlet = mesh.meshlets;
+            meshlet != mesh.meshlets + mesh.meshletCount; ++meshlet) {
+        clusterBounds.add(glm::make_vec3(meshlet->center), meshlet->radius,
+                glm::make_vec3(meshlet->coneApex),
+                glm::make_vec3(meshlet->coneAxis), meshlet->coneCutoff);
+    }
+    auto visibleClusters = std::vector<std::uint32_t>();
+    auto clusterStats = CullStats();
 
-        // Process input
+    // Levels of detail, kept per object for the hysteresis
+
+    const auto lodSelection = LodSelection();
+    auto objectLods = std::vector<std::size_t>(objectCount, 0u);
 
-        processWindowInput(window);
+    // Frames are built here and drawn by the render thread, which owns the
+    // context until it is stopped. Transient frame data comes from arenas
+    // that rotate with the frame slots
 
-        // Redraw
+    auto frameArenas = FrameArenas(RenderThread::frameSlots,
+            jobs.workerCount());
+    FrameData frames[RenderThread::frameSlots];
+    auto renderThread = RenderThread();
+    glfwSetWindowUserPointer(window, &renderThread);
+
+    // Frame pacing, the swap interval belongs to the context so it is set
+    // before the context moves. The stream buffer's regions cover the
+    // frames in flight, it never waits on its own
+
+    auto pacingOptions = FramePacingOptions();
+    pacingOptions.swapMode = SwapMode::VSync;
+    pacingOptions.maxFramesInFlight = 2;
+    pacingOptions.maxFrameRate = 0.;
+    auto framePacer = FramePacer(pacingOptions);
+    framePacer.applySwapMode();
+
+    glfwMakeContextCurrent(nullptr);
+    renderThread.start(window, [&](const int slot) {
+        auto& frame = frames[slot];
+        framePacer.beginFrame();
 
         // Clear screen
 
@@ -355,20 +610,123 @@ int main() noexcept {
         glClear(GL_COLOR_BUFFER_BIT |
                 GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
 
-        // Use program
+        // Update uniforms
 
-        glUseProgram(programId);
+        // Stream the textures in or out, the materials follow their new GL
+        // names before anything is drawn
+
+        for (const auto id : streamedTextures) {
+            residency.request(id, frame.textureScreenSize);
+        }
+        residency.update(stateCache);
+        for (auto i = std::size_t(0); i < streamedTextures.size(); ++i) {
+            materials.updateTexture(streamedMaterialTextures[i],
+                    residency.texture(streamedTextures[i]));
+        }
+
+        streamBuffer.beginFrame();
+        const auto uniformsOffset = streamBuffer.write(&frame.uniforms,
+                sizeof(frame.uniforms));
+        glBindBufferRange(GL_UNIFORM_BUFFER, frameUniformsBinding,
+                streamBuffer.buffer(), uniformsOffset, sizeof(frame.uniforms));
+
+        // Objects culled and drawn by the GPU, their matrices are streamed
+
+        if (frame.gpuCulling) {
+            const auto transformsSize = static_cast<std::uint32_t>(
+                    frame.objectMatrices.size()*sizeof(glm::mat4));
+            const auto transformsOffset = streamBuffer.write(
+                    frame.objectMatrices.data(), transformsSize,
+                    static_cast<std::uint32_t>(storageAlignment));
+            if (transformsOffset != UINT32_MAX) {
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER,
+                        instanceTransformsBinding, streamBuffer.buffer(),
+                        transformsOffset, transformsSize);
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                        instanceMaterialsBinding, instanceMaterials);
+                gpuCuller.updateBounds(frame.instanceBounds.data(),
+                        static_cast<GLuint>(frame.instanceBounds.size()));
+                gpuCuller.setOcclusion(hiZBuilt ? &hiZ : nullptr, hiZMatrix);
+                gpuCuller.cull(frame.frustum, stateCache);
+
+                stateCache.useProgram(instancedProgramId);
+                stateCache.bindVertexArray(instancedVao);
+                gpuCuller.draw(GL_TRIANGLES, indexType);
+            }
+        }
+
+        // Meshlet draws' arguments, maxIndirectDraws makes room for them
+
+        auto indirectBase = 0u;
+        if (!frame.indirectDraws.empty()) {
+            indirectBase = streamBuffer.write(frame.indirectDraws.data(),
+                    static_cast<std::uint32_t>(frame.indirectDraws.size()*
+                    sizeof(IndexedIndirectArgs)), sizeof(std::uint32_t));
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, streamBuffer.buffer());
+        }
+
+        // Tiles the previous frames asked for are uploaded before the draws
+        // ask for this frame's
+
+        if (frame.virtualTexturing) {
+            virtualTexture.update(stateCache);
+            virtualTexture.bind(stateCache);
+            virtualTexture.beginFeedback();
+        }
+
+        // Draw, the buffers were recorded by the workers
+
+        for (auto buffer = std::size_t(0);
+                buffer < frame.commandBufferCount; ++buffer) {
+            replay(frame.commandBuffers[buffer], stateCache, indirectBase);
+        }
+        if (frame.virtualTexturing) {
+            virtualTexture.endFeedback();
+        }
+        streamBuffer.endFrame();
+
+        // The depth is complete, its Hi-Z culls the next frame. Objects
+        // uncovered since show a frame late. Frames after the CPU path have
+        // no Hi-Z to test against
+
+        hiZBuilt = false;
+        if (frame.gpuCulling && hiZAvailable) {
+            hiZAvailable = hiZ.create(frame.width, frame.height);
+            if (hiZAvailable) {
+                hiZ.build(stateCache);
+                hiZMatrix = frame.uniforms.projectionMatrix*
+                        frame.uniforms.viewMatrix;
+                hiZBuilt = true;
+            }
+        }
 
+        // End draw
 
-        // Update uniforms
+        materials.endFrame();
+        glfwSwapBuffers(window);
+        framePacer.endFrame(frame.inputTime);
+    });
 
-        const auto ilufanTextureLocation = glGetUniformLocation(
-                programId, "ilufanTexture");
-        glUniform1i(ilufanTextureLocation, 0);
+    // Main loop
 
-        const auto boxTextureLocation = glGetUniformLocation(
-            programId, "boxTexture");
-        glUniform1i(boxTextureLocation, 1);
+    while (!glfwWindowShouldClose(window)) {
+        // Build the frame in a slot the render thread is done with. Waiting
+        // for it and for the frame rate cap comes before sampling input, so
+        // the frame is built from the freshest input
+
+        const auto slot = renderThread.beginFrame();
+        auto& frame = frames[slot];
+        frameArenas.beginFrame(slot);
+        framePacer.limitFrameRate();
+
+        // Process events
+
+        glfwPollEvents();
+        frame.inputTime = FramePacer::Clock::now();
+
+        // Process input
+
+        processWindowInput(window, input);
 
         // Move, rotate, scale matrix
 
@@ -379,43 +737,237 @@ int main() noexcept {
         //modelMatrix = glm::rotate(modelMatrix,
         //        glm::radians(.1f), glm::vec3(0.f, 0.f, 1.f));
         modelMatrix = glm::scale(modelMatrix, glm::vec3(1.001f));
-        const auto unipos = glGetUniformLocation(programId, "modelMatrix");
-        glUniformMatrix4fv(unipos, 1, GL_FALSE, glm::value_ptr(modelMatrix));
 
         glfwGetFramebufferSize(window, &frameBufferWidth, &frameBufferHeight);
 
         projectionMatrix = glm::perspective(glm::radians(fov),
                 static_cast<float>(frameBufferWidth) / frameBufferHeight,
                 nearPlane, farPlane);
-
-        glUniformMatrix4fv(glGetUniformLocation(programId, "projectionMatrix"),
-                1, GL_FALSE, glm::value_ptr(projectionMatrix));
-
-        // Activate texture
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ilufanTexture);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, boxTexture);
-
-        // Bind vertex array object
-
-        glBindVertexArray(vao);
-
-        // Draw
-
-        // glDrawArrays(GL_TRIANGLES, 0, verticesCount);
-        glDrawElements(GL_TRIANGLES, indecesCount, GL_UNSIGNED_INT, 0);
-
-        // End draw
-
-        glfwSwapBuffers(window);        
-        glFlush(); // Rud
+        frame.uniforms.viewMatrix = viewMatrix;
+        frame.uniforms.projectionMatrix = projectionMatrix;
+        frame.width = frameBufferWidth;
+        frame.height = frameBufferHeight;
+
+        // Place the objects, spaced by their current size
+
+        const auto modelScale = std::max(glm::length(glm::vec3(modelMatrix[0])),
+                std::max(glm::length(glm::vec3(modelMatrix[1])),
+                glm::length(glm::vec3(modelMatrix[2]))));
+        const auto objectRadius = meshRadius*modelScale;
+        frame.objectMatrices.clear();
+        objectBounds.clear();
+        for (auto object = 0u; object < objectCount; ++object) {
+            const auto column = float(object%objectColumns) -
+                    (objectColumns - 1u)*.5f;
+            const auto row = float(object/objectColumns);
+            auto objectMatrix = modelMatrix;
+            objectMatrix[3] += glm::vec4(column*2.5f*objectRadius, 0.f,
+                    -row*2.5f*objectRadius, 0.f);
+            frame.objectMatrices.push_back(objectMatrix);
+            objectBounds.add(glm::vec3(objectMatrix[3]), objectRadius);
+        }
+
+        // A click picks the nearest object under the cursor. The objects
+        // only spread out, so the hierarchy built at the first click is
+        // refitted after that
+
+        if (input.pick) {
+            objectBoxes.clear();
+            for (const auto& objectMatrix : frame.objectMatrices) {
+                const auto center = glm::vec3(objectMatrix[3]);
+                objectBoxes.push_back(BoundingBox{
+                        center - glm::vec3(objectRadius),
+                        center + glm::vec3(objectRadius) });
+            }
+            if (objectBvh.nodeCount() == 0u) {
+                objectBvh.build(objectBoxes);
+            }
+            else {
+                objectBvh.refit(objectBoxes);
+            }
+
+            auto hit = RayHit();
+            if (objectBvh.raycast(camPosition, cursorRay(window,
+                    projectionMatrix*viewMatrix), farPlane, hit)) {
+                std::cout << "Picked object " << hit.object << ", " <<
+                        hit.distance << " away\n";
+            }
+        }
+
+        frame.renderQueue.clear();
+        frame.indirectDraws.clear();
+        frame.frustum = extractFrustum(projectionMatrix*viewMatrix);
+        frame.gpuCulling = input.gpuCulling && gpuCullingAvailable;
+        frame.virtualTexturing = input.virtualTexturing &&
+                virtualTexturingAvailable && !frame.gpuCulling;
+
+        // The streamed textures are sized for the nearest object drawn,
+        // the GPU path's objects all count, the CPU path's visible ones
+
+        const auto pixelsAtUnitDistance = frameBufferHeight/
+                (2.f*std::tan(glm::radians(fov)*.5f));
+        const auto screenSize = [&](const glm::mat4& objectMatrix) {
+            const auto viewDepth = -(viewMatrix*objectMatrix[3]).z;
+            return pixelsAtUnitDistance*2.f*objectRadius/
+                    std::max(viewDepth, nearPlane);
+        };
+        frame.textureScreenSize = 0.f;
+
+        if (frame.gpuCulling) {
+            for (const auto& objectMatrix : frame.objectMatrices) {
+                frame.textureScreenSize = std::max(frame.textureScreenSize,
+                        screenSize(objectMatrix));
+            }
+
+            // Every object is an instance of every draw
+            frame.instanceBounds.clear();
+            for (auto draw = 0u; draw < gpuDraws.size(); ++draw) {
+                for (auto object = 0u; object < objectCount; ++object) {
+                    auto bounds = InstanceBounds();
+                    bounds.sphere = glm::vec4(
+                            glm::vec3(frame.objectMatrices[object][3]),
+                            objectRadius);
+                    bounds.drawId = draw;
+                    bounds.instance = object;
+                    frame.instanceBounds.push_back(bounds);
+                }
+            }
+            frame.commandBufferCount = 0u;
+            renderThread.endFrame(slot);
+            continue;
+        }
+
+        // Cull
+
+        cullStats = CullStats();
+        cullSpheres(frame.frustum, objectBounds, visibleObjects, cullStats,
+                &jobs, &frameArenas.local());
+
+        // Submit draws
+
+        for (const auto object : visibleObjects) {
+            const auto& objectMatrix = frame.objectMatrices[object];
+            const auto viewDepth = -(viewMatrix*objectMatrix[3]).z;
+            frame.textureScreenSize = std::max(frame.textureScreenSize,
+                    screenSize(objectMatrix));
+            auto& level = objectLods[object];
+            level = selectLod(mesh, pixelsAtUnitDistance*modelScale/
+                    std::max(viewDepth, nearPlane), level, lodSelection);
+            const auto meshLod = lod(mesh, level);
+
+            auto draw = DrawCommand();
+            draw.program = programId;
+            draw.material = quadMaterialId;
+            draw.materialLocation = materialIdLocation;
+            draw.vao = vao;
+            draw.indexType = mesh.indexSize == sizeof(std::uint16_t) ?
+                    IndexType::Uint16 : IndexType::Uint32;
+            draw.depth = (viewDepth - nearPlane)/(farPlane - nearPlane);
+            draw.modelMatrixLocation = modelMatrixLocation;
+            draw.modelMatrix = objectMatrix;
+            if (frame.virtualTexturing) {
+                draw.program = virtualProgramId;
+                draw.materialLocation = -1;
+                draw.modelMatrixLocation = virtualModelMatrixLocation;
+            }
+
+            // The file's materials aren't loaded, every submesh gets the
+            // quad's, so the visible meshlets, tested in model space, go in
+            // one multi-draw
+            if (meshLod.meshletCount != 0u && frame.indirectDraws.size() +
+                    meshLod.meshletCount <= maxIndirectDraws) {
+                const auto modelEye = glm::vec3(glm::inverse(objectMatrix)*
+                        glm::vec4(camPosition, 1.f));
+                cullClusters(extractFrustum(projectionMatrix*viewMatrix*
+                        objectMatrix), modelEye, clusterBounds,
+                        meshLod.firstMeshlet,
+                        meshLod.firstMeshlet + meshLod.meshletCount,
+                        visibleClusters, clusterStats);
+                draw.indirectOffset = static_cast<std::uint32_t>(
+                        frame.indirectDraws.size()*
+                        sizeof(IndexedIndirectArgs));
+                for (const auto cluster : visibleClusters) {
+                    const auto& meshlet = mesh.meshlets[cluster];
+                    auto args = IndexedIndirectArgs();
+                    args.indexCount = meshlet.indexCount;
+                    args.firstIndex = indexRange.offset/mesh.indexSize +
+                            meshlet.firstIndex;
+                    args.baseVertex = static_cast<std::int32_t>(
+                            vertexRange.offset/sizeof(Vertex) +
+                            mesh.submeshes[meshlet.submesh].baseVertex);
+                    frame.indirectDraws.push_back(args);
+                }
+                draw.indirectDrawCount = static_cast<std::uint32_t>(
+                        visibleClusters.size());
+                if (draw.indirectDrawCount != 0u) {
+                    frame.renderQueue.submit(draw);
+                }
+                continue;
+            }
+
+            const auto firstSubmesh = mesh.submeshes + meshLod.firstSubmesh;
+            for (auto submesh = firstSubmesh;
+                    submesh != firstSubmesh + meshLod.submeshCount;
+                    ++submesh) {
+                draw.indexCount = submesh->indexCount;
+                draw.indexOffset = indexRange.offset +
+                        submesh->firstIndex*mesh.indexSize;
+                draw.baseVertex = static_cast<std::int32_t>(
+                        vertexRange.offset/sizeof(Vertex) +
+                        submesh->baseVertex);
+                frame.renderQueue.submit(draw);
+            }
+        }
+        frame.renderQueue.sort();
+
+        // Record
+
+        frame.commandBufferCount = frame.renderQueue.record(
+                frame.commandBuffers, drawsPerCommandBuffer, &jobs,
+                &frameArenas);
+
+        renderThread.endFrame(slot);
     }
 
+    renderThread.stop();
+    std::cout << "Frame arenas peak: " << frameArenas.peak() << " bytes\n";
+    std::cout << "Meshlets culled: " << clusterStats.tested -
+            clusterStats.visible << " of " << clusterStats.tested << ", " <<
+            clusterStats.backfacing << " backfacing\n";
+    std::cout << "Stream buffer stalls: " << streamBuffer.stats().stalls <<
+            " (" << streamBuffer.stats().stallMilliseconds << " ms)\n";
+    std::cout << "Input to present latency: " <<
+            framePacer.stats().averageLatency() << " ms average, " <<
+            framePacer.stats().maxLatencyMilliseconds << " ms max, " <<
+            framePacer.stats().gpuWaits << " GPU waits\n";
+    std::cout << "GL state changes: " << stateCache.stats().issued <<
+            " issued, " << stateCache.stats().filtered << " filtered\n";
+    std::cout << "Texture residency: " << residency.stats().residentBytes <<
+            " bytes resident, " << residency.stats().uploadedBytes <<
+            " uploaded, " << residency.stats().evictedBytes << " evicted, " <<
+            residency.stats().reallocations << " reallocations\n";
+    std::cout << "Virtual texture tiles: " <<
+            virtualTexture.stats().residentTiles << " resident, " <<
+            virtualTexture.stats().uploadedTiles << " uploaded, " <<
+            virtualTexture.stats().evictedTiles << " evicted\n";
+    glfwSetWindowUserPointer(window, nullptr);
+    glfwMakeContextCurrent(window);
+
     // End of program
 
+    glDeleteBuffers(1, &instanceMaterials);
+    glDeleteVertexArrays(1, &instancedVao);
+    glDeleteVertexArrays(1, &vao);
+    gpuCuller.destroy();
+    hiZ.destroy();
+    materials.destroy();
+    residency.destroy();
+    virtualTexture.destroy();
+    atlas.destroy();
+    meshBuffers.destroy();
+    cookedMesh.close();
+    streamBuffer.destroy();
+    framePacer.destroy();
     glfwDestroyWindow(window);
     return 0;
 }
\ No newline at end of file
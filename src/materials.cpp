@@ -0,0 +1,314 @@
+#include "materials.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+MaterialSystem::~MaterialSystem() noexcept {
+    destroy();
+}
+
+std::uint32_t MaterialSystem::addTexture(const GLuint texture,
+        const glm::vec4& rect, const glm::ivec2& fullSize) noexcept {
+    textures.push_back(TextureRect{ texture, rect, fullSize });
+    return static_cast<std::uint32_t>(textures.size() - 1);
+}
+
+std::uint32_t MaterialSystem::addMaterial(const Material& material) noexcept {
+    materials.push_back(material);
+    return static_cast<std::uint32_t>(materials.size() - 1);
+}
+
+bool MaterialSystem::build() noexcept {
+    if (textures.empty() || materials.empty()) {
+        std::cout << "Material system has no materials\n";
+        return false;
+    }
+
+    // A texture without a handle sends every texture to the array
+    useBindless = GLEW_ARB_bindless_texture && buildBindless();
+    built = useBindless || buildArray();
+    if (built) {
+        writeTable();
+    }
+    return built;
+}
+
+// std430 layouts of Material in shaders/fragmentcore.glsl
+
+struct BindlessMaterial {
+    GLuint64 handles[materialTextureSlots];
+    glm::vec4 rects[materialTextureSlots];
+};
+
+struct ArrayMaterial {
+    GLuint layers[materialTextureSlots];
+    glm::vec4 rects[materialTextureSlots];
+};
+
+static_assert(sizeof(BindlessMaterial) == 96u && sizeof(ArrayMaterial) == 80u,
+        "material layouts must match std430");
+
+bool MaterialSystem::buildBindless() noexcept {
+    // A texture shared by several rects is made resident once
+
+    handles.clear();
+    textureHandles.clear();
+    for (const auto& texture : textures) {
+        const auto handle = residentHandle(texture.texture);
+        if (handle == 0u) {
+            for (const auto resident : handles) {
+                glMakeTextureHandleNonResidentARB(resident);
+            }
+            handles.clear();
+            textureHandles.clear();
+            return false;
+        }
+        textureHandles.push_back(handle);
+    }
+
+    glCreateBuffers(1, &materialBuffer);
+    glNamedBufferStorage(materialBuffer,
+            materials.size()*sizeof(BindlessMaterial), nullptr,
+            GL_DYNAMIC_STORAGE_BIT);
+    return true;
+}
+
+GLuint64 MaterialSystem::residentHandle(const GLuint texture) noexcept {
+    const auto handle = glGetTextureHandleARB(texture);
+    if (handle == 0u) {
+        std::cout << "Texture " << texture << " has no bindless handle\n";
+        return 0u;
+    }
+    if (std::find(handles.begin(), handles.end(), handle) == handles.end()) {
+        glMakeTextureHandleResidentARB(handle);
+        handles.push_back(handle);
+    }
+    return handle;
+}
+
+bool MaterialSystem::buildArray() noexcept {
+    // Layers share the size of the largest texture, streamed ones count
+    // with their full size. A layer per distinct GL texture
+
+    auto layerTextures = std::vector<GLuint>();
+    textureLayers.clear();
+    for (const auto& texture : textures) {
+        const auto found = std::find(layerTextures.begin(),
+                layerTextures.end(), texture.texture);
+        textureLayers.push_back(static_cast<GLuint>(
+                found - layerTextures.begin()));
+        if (found == layerTextures.end()) {
+            layerTextures.push_back(texture.texture);
+        }
+    }
+
+    arrayWidth = 1;
+    arrayHeight = 1;
+    for (const auto& texture : textures) {
+        GLint textureWidth = 0;
+        GLint textureHeight = 0;
+        glGetTextureLevelParameteriv(texture.texture, 0,
+                GL_TEXTURE_WIDTH, &textureWidth);
+        glGetTextureLevelParameteriv(texture.texture, 0,
+                GL_TEXTURE_HEIGHT, &textureHeight);
+        arrayWidth = std::max({ arrayWidth, textureWidth,
+                texture.fullSize.x });
+        arrayHeight = std::max({ arrayHeight, textureHeight,
+                texture.fullSize.y });
+    }
+    GLint maxLayers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+    if (static_cast<GLint>(layerTextures.size()) > maxLayers) {
+        std::cout << "Too many material textures for one array\n";
+        return false;
+    }
+
+    arrayLevels = 1;
+    while ((std::max(arrayWidth, arrayHeight) >> arrayLevels) > 0) {
+        ++arrayLevels;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &arrayTexture);
+    glTextureStorage3D(arrayTexture, arrayLevels, GL_RGBA8, arrayWidth,
+            arrayHeight, static_cast<GLsizei>(layerTextures.size()));
+    glTextureParameteri(arrayTexture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(arrayTexture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(arrayTexture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(arrayTexture, GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR);
+
+    for (auto layer = 0u; layer < layerTextures.size(); ++layer) {
+        copyToLayer(layerTextures[layer], layer);
+    }
+
+    glCreateBuffers(1, &materialBuffer);
+    glNamedBufferStorage(materialBuffer,
+            materials.size()*sizeof(ArrayMaterial), nullptr,
+            GL_DYNAMIC_STORAGE_BIT);
+    return true;
+}
+
+// Level by level so the texture's own mips are kept. A smaller texture,
+// e.g. a streamed one with only its coarse mips resident, starts at the
+// array level of its size, the finer levels stretch its level 0
+
+void MaterialSystem::copyToLayer(const GLuint texture,
+        const GLuint layer) noexcept {
+    GLint textureLevels = 0;
+    GLint baseWidth = 0;
+    GLint baseHeight = 0;
+    glGetTextureParameteriv(texture, GL_TEXTURE_IMMUTABLE_LEVELS,
+            &textureLevels);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_WIDTH, &baseWidth);
+    glGetTextureLevelParameteriv(texture, 0, GL_TEXTURE_HEIGHT, &baseHeight);
+    textureLevels = std::max(textureLevels, 1);
+    auto firstLevel = 0;
+    while (firstLevel + 1 < arrayLevels &&
+            (std::max(arrayWidth, arrayHeight) >> firstLevel) >
+            std::max(baseWidth, baseHeight)) {
+        ++firstLevel;
+    }
+
+    GLuint framebuffers[2];
+    glCreateFramebuffers(2, framebuffers);
+    for (auto level = 0; level < arrayLevels; ++level) {
+        const auto sourceLevel = std::min(std::max(level - firstLevel, 0),
+                textureLevels - 1);
+        GLint textureWidth = 0;
+        GLint textureHeight = 0;
+        glGetTextureLevelParameteriv(texture, sourceLevel,
+                GL_TEXTURE_WIDTH, &textureWidth);
+        glGetTextureLevelParameteriv(texture, sourceLevel,
+                GL_TEXTURE_HEIGHT, &textureHeight);
+
+        glNamedFramebufferTexture(framebuffers[0], GL_COLOR_ATTACHMENT0,
+                texture, sourceLevel);
+        glNamedFramebufferTextureLayer(framebuffers[1], GL_COLOR_ATTACHMENT0,
+                arrayTexture, level, static_cast<GLint>(layer));
+        glBlitNamedFramebuffer(framebuffers[0], framebuffers[1],
+                0, 0, textureWidth, textureHeight, 0, 0,
+                std::max(1, arrayWidth >> level),
+                std::max(1, arrayHeight >> level),
+                GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glDeleteFramebuffers(2, framebuffers);
+}
+
+void MaterialSystem::writeTable() noexcept {
+    const auto textureIndex = [this](const std::uint32_t texture) {
+        return std::min<std::size_t>(texture, textures.size() - 1);
+    };
+
+    if (useBindless) {
+        auto table = std::vector<BindlessMaterial>(materials.size());
+        for (auto i = std::size_t(0); i < materials.size(); ++i) {
+            for (auto slot = 0; slot < materialTextureSlots; ++slot) {
+                const auto texture = textureIndex(
+                        materials[i].textures[slot]);
+                table[i].handles[slot] = textureHandles[texture];
+                table[i].rects[slot] = textures[texture].rect;
+            }
+        }
+        glNamedBufferSubData(materialBuffer, 0,
+                table.size()*sizeof(table[0]), table.data());
+        return;
+    }
+
+    auto table = std::vector<ArrayMaterial>(materials.size());
+    for (auto i = std::size_t(0); i < materials.size(); ++i) {
+        for (auto slot = 0; slot < materialTextureSlots; ++slot) {
+            const auto texture = textureIndex(materials[i].textures[slot]);
+            table[i].layers[slot] = textureLayers[texture];
+            table[i].rects[slot] = textures[texture].rect;
+        }
+    }
+    glNamedBufferSubData(materialBuffer, 0, table.size()*sizeof(table[0]),
+            table.data());
+}
+
+bool MaterialSystem::updateTexture(const std::uint32_t texture,
+        const GLuint glTexture) noexcept {
+    if (!built || texture >= textures.size()) {
+        return false;
+    }
+    if (textures[texture].texture == glTexture) {
+        return true;
+    }
+
+    if (useBindless) {
+        const auto handle = residentHandle(glTexture);
+        if (handle == 0u) {
+            return false;
+        }
+        const auto oldHandle = textureHandles[texture];
+        textureHandles[texture] = handle;
+        if (std::find(textureHandles.begin(), textureHandles.end(),
+                oldHandle) == textureHandles.end()) {
+            handles.erase(std::find(handles.begin(), handles.end(),
+                    oldHandle));
+            retiredHandles.push_back(RetiredHandle{ oldHandle, frame });
+        }
+    }
+    else {
+        // The layer is rewritten, so it must be this texture's alone
+        const auto layer = textureLayers[texture];
+        for (auto other = std::size_t(0); other < textures.size(); ++other) {
+            if (other != texture && textureLayers[other] == layer) {
+                std::cout << "Texture " << texture << " shares its layer\n";
+                return false;
+            }
+        }
+        copyToLayer(glTexture, layer);
+    }
+
+    textures[texture].texture = glTexture;
+    writeTable();
+    return true;
+}
+
+void MaterialSystem::endFrame() noexcept {
+    ++frame;
+    const auto done = std::partition(retiredHandles.begin(),
+            retiredHandles.end(), [this](const RetiredHandle& old) {
+        return frame - old.frame < retireFrames;
+    });
+    for (auto old = done; old != retiredHandles.end(); ++old) {
+        glMakeTextureHandleNonResidentARB(old->handle);
+    }
+    retiredHandles.erase(done, retiredHandles.end());
+}
+
+void MaterialSystem::destroy() noexcept {
+    if (!built) {
+        return;
+    }
+
+    for (const auto handle : handles) {
+        glMakeTextureHandleNonResidentARB(handle);
+    }
+    for (const auto& old : retiredHandles) {
+        glMakeTextureHandleNonResidentARB(old.handle);
+    }
+    glDeleteBuffers(1, &materialBuffer);
+    glDeleteTextures(1, &arrayTexture);
+
+    handles.clear();
+    textureHandles.clear();
+    retiredHandles.clear();
+    materialBuffer = arrayTexture = 0u;
+    built = false;
+}
+
+void MaterialSystem::bind(GLStateCache& stateCache) const noexcept {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+            materialBinding, materialBuffer);
+    if (!useBindless) {
+        stateCache.bindTextureUnit(arrayTextureUnit,
+                GL_TEXTURE_2D_ARRAY, arrayTexture);
+    }
+}
+
+const char* MaterialSystem::shaderDefines() const noexcept {
+    return useBindless ? "#define MATERIAL_BINDLESS\n" :
+            "#define MATERIAL_ARRAY\n";
+}
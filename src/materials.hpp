@@ -0,0 +1,100 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "glstatecache.hpp"
+
+#include <cstdint>
+#include <vector>
+
+constexpr auto materialTextureSlots = 4;
+
+// Indices returned by MaterialSystem::addTexture
+struct Material {
+    std::uint32_t textures[materialTextureSlots] = {};
+};
+
+// Materials live in an SSBO indexed by material id in the shaders, so
+// switching materials, even per instance, needs no texture binds. With
+// ARB_bindless_texture the SSBO holds resident handles, otherwise every
+// texture is copied into a layer of one RGBA8 texture array. A material
+// texture may be a rectangle of a GL texture, e.g. an atlas page, several
+// of them share its handle or layer
+
+class MaterialSystem {
+public:
+    static constexpr auto materialBinding = 6u;
+    static constexpr auto arrayTextureUnit = 0u;
+    static constexpr auto retireFrames = 3u;
+
+    MaterialSystem() noexcept = default;
+    MaterialSystem(const MaterialSystem&) = delete;
+    MaterialSystem& operator=(const MaterialSystem&) = delete;
+    ~MaterialSystem() noexcept;
+
+    // rect - offset (xy) and scale (zw) of the texcoords in the texture,
+    // texcoords repeat within it. fullSize - size of level 0 once finer
+    // mips are streamed in, the array layers make room for it. Zero is
+    // the texture's current size
+    std::uint32_t addTexture(const GLuint texture,
+            const glm::vec4& rect = glm::vec4(0.f, 0.f, 1.f, 1.f),
+            const glm::ivec2& fullSize = glm::ivec2(0)) noexcept;
+    std::uint32_t addMaterial(const Material& material) noexcept;
+
+    // Makes textures resident or packs them into the array and uploads
+    // the material table, the array is the fallback when a texture has no
+    // bindless handle. Textures may not be added after this
+    bool build() noexcept;
+    void destroy() noexcept;
+
+    // Points a texture at another GL texture, e.g. one TextureResidency
+    // reallocated, keeping its rect. GL thread, after build(). The array
+    // path copies it into the texture's layer, which it must not share.
+    // Replaced handles stay resident for retireFrames endFrame() calls,
+    // frames in flight may still sample them
+    bool updateTexture(const std::uint32_t texture,
+            const GLuint glTexture) noexcept;
+    void endFrame() noexcept;
+
+    void bind(GLStateCache& stateCache) const noexcept;
+
+    bool bindless() const noexcept { return useBindless; }
+
+    // Selects the sampling path in shaders/fragmentcore.glsl
+    const char* shaderDefines() const noexcept;
+
+private:
+    bool buildBindless() noexcept;
+    bool buildArray() noexcept;
+    GLuint64 residentHandle(const GLuint texture) noexcept;
+    void copyToLayer(const GLuint texture, const GLuint layer) noexcept;
+    void writeTable() noexcept;
+
+    struct TextureRect {
+        GLuint texture;
+        glm::vec4 rect;
+        glm::ivec2 fullSize;
+    };
+
+    struct RetiredHandle {
+        GLuint64 handle;
+        std::uint64_t frame;
+    };
+
+    std::vector<TextureRect> textures;
+    std::vector<Material> materials;
+    std::vector<GLuint64> handles; // Resident ones, each once
+    std::vector<GLuint64> textureHandles; // Per texture
+    std::vector<GLuint> textureLayers; // Per texture
+    std::vector<RetiredHandle> retiredHandles;
+    std::uint64_t frame = 0u;
+
+    GLuint materialBuffer = 0u;
+    GLuint arrayTexture = 0u;
+    int arrayWidth = 0;
+    int arrayHeight = 0;
+    int arrayLevels = 0;
+    bool useBindless = false;
+    bool built = false;
+};
@@ -0,0 +1,151 @@
+#include "mesh.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+constexpr auto index16Span = std::uint32_t(1) << 16;
+
+void computeBounds(Mesh& mesh) noexcept {
+    if (mesh.vertices.empty()) {
+        mesh.boundsMin = mesh.boundsMax = glm::vec3(0.f);
+        return;
+    }
+    mesh.boundsMin = mesh.boundsMax = mesh.vertices[0].position;
+    for (const auto& vertex : mesh.vertices) {
+        mesh.boundsMin = glm::min(mesh.boundsMin, vertex.position);
+        mesh.boundsMax = glm::max(mesh.boundsMax, vertex.position);
+    }
+}
+
+void packIndices(const Mesh& mesh, PackedIndices& packed) noexcept {
+    packed.submeshes.clear();
+
+    // Chunks of triangles whose vertices span a 16-bit range, the chunks
+    // of submesh i start at firstChunks[i]
+
+    auto fits16 = true;
+    auto firstChunks = std::vector<std::uint32_t>();
+    packed.meshlets = mesh.meshlets;
+    auto meshlet = packed.meshlets.begin();
+    for (auto index = std::size_t(0); index < mesh.submeshes.size();
+            ++index) {
+        const auto& submesh = mesh.submeshes[index];
+        firstChunks.push_back(static_cast<std::uint32_t>(
+                packed.submeshes.size()));
+        const auto end = submesh.firstIndex + submesh.indexCount;
+        auto chunk = submesh;
+        auto low = UINT32_MAX;
+        auto high = 0u;
+        for (auto i = submesh.firstIndex; fits16 && i + 3u <= end;) {
+            // A meshlet goes to one chunk whole, other triangles one by one
+            const auto inMeshlet = meshlet != packed.meshlets.end() &&
+                    meshlet->submesh == index && meshlet->firstIndex == i;
+            const auto unitEnd = inMeshlet ?
+                    std::min(end, i + meshlet->indexCount) : i + 3u;
+            auto unitLow = UINT32_MAX;
+            auto unitHigh = 0u;
+            for (auto j = i; j < unitEnd; ++j) {
+                unitLow = std::min(unitLow, mesh.indices[j]);
+                unitHigh = std::max(unitHigh, mesh.indices[j]);
+            }
+            fits16 = unitHigh - unitLow < index16Span;
+
+            if (std::max(high, unitHigh) - std::min(low, unitLow) >=
+                    index16Span) {
+                chunk.indexCount = i - chunk.firstIndex;
+                chunk.baseVertex = low;
+                packed.submeshes.push_back(chunk);
+                chunk.firstIndex = i;
+                low = unitLow;
+                high = unitHigh;
+            }
+            low = std::min(low, unitLow);
+            high = std::max(high, unitHigh);
+            if (inMeshlet) {
+                meshlet->submesh = static_cast<std::uint32_t>(
+                        packed.submeshes.size());
+                ++meshlet;
+            }
+            i = unitEnd;
+        }
+        chunk.indexCount = end - chunk.firstIndex;
+        chunk.baseVertex = chunk.indexCount != 0u ? low : 0u;
+        packed.submeshes.push_back(chunk);
+    }
+
+    firstChunks.push_back(static_cast<std::uint32_t>(
+            packed.submeshes.size()));
+
+    if (!fits16) {
+        packed.indexSize = sizeof(std::uint32_t);
+        packed.submeshes = mesh.submeshes;
+        packed.lods = mesh.lods;
+        packed.meshlets = mesh.meshlets;
+        packed.data.resize(mesh.indices.size()*sizeof(std::uint32_t));
+        std::memcpy(packed.data.data(), mesh.indices.data(),
+                packed.data.size());
+        return;
+    }
+
+    packed.lods = mesh.lods;
+    for (auto& level : packed.lods) {
+        const auto first = firstChunks[level.firstSubmesh];
+        level.submeshCount = firstChunks[level.firstSubmesh +
+                level.submeshCount] - first;
+        level.firstSubmesh = first;
+    }
+
+    packed.indexSize = sizeof(std::uint16_t);
+    packed.data.assign(mesh.indices.size()*sizeof(std::uint16_t), 0u);
+    for (const auto& chunk : packed.submeshes) {
+        for (auto i = chunk.firstIndex; i < chunk.firstIndex +
+                chunk.indexCount; ++i) {
+            const auto index = static_cast<std::uint16_t>(
+                    mesh.indices[i] - chunk.baseVertex);
+            std::memcpy(packed.data.data() + i*sizeof(index), &index,
+                    sizeof(index));
+        }
+    }
+}
+
+MeshView view(const Mesh& mesh) noexcept {
+    auto result = MeshView();
+    result.vertices = mesh.vertices.data();
+    result.vertexCount = mesh.vertices.size();
+    result.indices = mesh.indices.data();
+    result.indexCount = mesh.indices.size();
+    result.submeshes = mesh.submeshes.data();
+    result.submeshCount = mesh.submeshes.size();
+    result.lods = mesh.lods.data();
+    result.lodCount = mesh.lods.size();
+    result.meshlets = mesh.meshlets.data();
+    result.meshletCount = mesh.meshlets.size();
+    result.boundsMin = mesh.boundsMin;
+    result.boundsMax = mesh.boundsMax;
+    return result;
+}
+
+MeshView view(const Mesh& mesh, const PackedIndices& indices) noexcept {
+    auto result = view(mesh);
+    result.indices = indices.data.data();
+    result.indexSize = indices.indexSize;
+    result.submeshes = indices.submeshes.data();
+    result.submeshCount = indices.submeshes.size();
+    result.lods = indices.lods.data();
+    result.lodCount = indices.lods.size();
+    result.meshlets = indices.meshlets.data();
+    result.meshletCount = indices.meshlets.size();
+    return result;
+}
+
+std::size_t lodCount(const MeshView& mesh) noexcept {
+    return mesh.lodCount != 0u ? mesh.lodCount : 1u;
+}
+
+MeshLod lod(const MeshView& mesh, const std::size_t level) noexcept {
+    if (mesh.lodCount == 0u) {
+        return MeshLod{ 0u, static_cast<std::uint32_t>(mesh.submeshCount),
+                0.f, 0u, static_cast<std::uint32_t>(mesh.meshletCount) };
+    }
+    return mesh.lods[std::min(level, mesh.lodCount - 1u)];
+}
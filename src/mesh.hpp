@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 color;
+    glm::vec2 texcoord;
+};
+
+// Range of the index buffer drawn with one material, its indices are
+// relative to baseVertex
+struct Submesh {
+    std::uint32_t firstIndex = 0u;
+    std::uint32_t indexCount = 0u;
+    std::uint32_t material = 0u;
+    std::uint32_t baseVertex = 0u;
+};
+
+// Submeshes drawn at one level of detail, error is how far in model units
+// the level's surface may be from the full detail one. The meshlets cover
+// the same triangles
+struct MeshLod {
+    std::uint32_t firstSubmesh = 0u;
+    std::uint32_t submeshCount = 0u;
+    float error = 0.f;
+    std::uint32_t firstMeshlet = 0u;
+    std::uint32_t meshletCount = 0u;
+};
+
+// Small cluster of a submesh's triangles, a contiguous range of its
+// indices. Bounds are in model units, the cone holds the triangles'
+// normals: seen from where dot(normalize(coneApex - eye), coneAxis) >=
+// coneCutoff every triangle faces away
+struct Meshlet {
+    std::uint32_t firstIndex = 0u;
+    std::uint32_t indexCount = 0u;
+    std::uint32_t submesh = 0u; // Material and baseVertex come from it
+    float center[3] = {};
+    float radius = 0.f;
+    float coneApex[3] = {};
+    float coneAxis[3] = {};
+    float coneCutoff = 2.f; // Above 1 the cone never culls
+};
+
+// Indexed triangle list, indices are absolute into vertices, the
+// submeshes' baseVertex is 0. Levels of detail share the vertices, finest
+// first, without them all submeshes are one level. Meshlets are optional,
+// sorted by submesh
+struct Mesh {
+    std::vector<Vertex> vertices;
+    std::vector<std::uint32_t> indices;
+    std::vector<Submesh> submeshes;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    glm::vec3 boundsMin = glm::vec3(0.f);
+    glm::vec3 boundsMax = glm::vec3(0.f);
+};
+
+// Index buffer of a Mesh in the narrowest type its submeshes allow
+struct PackedIndices {
+    std::uint32_t indexSize = sizeof(std::uint32_t);
+    std::vector<unsigned char> data;
+    std::vector<Submesh> submeshes;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+};
+
+// Mesh data owned elsewhere, by a Mesh or a mapped cooked mesh
+struct MeshView {
+    const Vertex* vertices = nullptr;
+    std::size_t vertexCount = 0u;
+    const void* indices = nullptr;
+    std::uint32_t indexSize = sizeof(std::uint32_t); // 2 or 4 bytes
+    std::size_t indexCount = 0u;
+    const Submesh* submeshes = nullptr;
+    std::size_t submeshCount = 0u;
+    const MeshLod* lods = nullptr;
+    std::size_t lodCount = 0u;
+    const Meshlet* meshlets = nullptr;
+    std::size_t meshletCount = 0u;
+    glm::vec3 boundsMin = glm::vec3(0.f);
+    glm::vec3 boundsMax = glm::vec3(0.f);
+};
+
+void computeBounds(Mesh& mesh) noexcept;
+
+// 16-bit indices when every submesh uses a span of at most 65536
+// vertices, submeshes using more are split in chunks that do, between
+// meshlets when there are some. A triangle or meshlet spanning more makes
+// the indices 32-bit
+void packIndices(const Mesh& mesh, PackedIndices& packed) noexcept;
+
+MeshView view(const Mesh& mesh) noexcept;
+MeshView view(const Mesh& mesh, const PackedIndices& indices) noexcept;
+
+// Levels of detail, 1 for meshes without them
+std::size_t lodCount(const MeshView& mesh) noexcept;
+MeshLod lod(const MeshView& mesh, const std::size_t level) noexcept;
@@ -0,0 +1,166 @@
+#include "meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Meshlets are kept whole when indices are packed to 16 bits
+constexpr auto maxVertexSpan = std::uint32_t(1) << 16;
+
+// Cone cutoffs closer to perpendicular than this cull too rarely to pay
+// for the test
+constexpr auto minConeSpread = .1f;
+
+static auto computeMeshletBounds(const Mesh& mesh,
+        Meshlet& meshlet) noexcept {
+    const auto first = mesh.indices.data() + meshlet.firstIndex;
+    const auto last = first + meshlet.indexCount;
+
+    auto boundsMin = mesh.vertices[*first].position;
+    auto boundsMax = boundsMin;
+    for (auto index = first; index != last; ++index) {
+        boundsMin = glm::min(boundsMin, mesh.vertices[*index].position);
+        boundsMax = glm::max(boundsMax, mesh.vertices[*index].position);
+    }
+    const auto center = (boundsMin + boundsMax)*.5f;
+    auto radius = 0.f;
+    for (auto index = first; index != last; ++index) {
+        radius = std::max(radius,
+                glm::length(mesh.vertices[*index].position - center));
+    }
+
+    // The axis is the area weighted normal, the cutoff comes from the
+    // normal furthest from it
+    auto normals = std::vector<glm::vec3>();
+    auto axis = glm::vec3(0.f);
+    for (auto index = first; index + 3 <= last; index += 3) {
+        const auto& a = mesh.vertices[index[0]].position;
+        const auto normal = glm::cross(
+                mesh.vertices[index[1]].position - a,
+                mesh.vertices[index[2]].position - a);
+        const auto area = glm::length(normal);
+        axis += normal;
+        normals.push_back(area > 0.f ? normal/area : glm::vec3(0.f));
+    }
+    const auto axisLength = glm::length(axis);
+    auto minDot = 1.f;
+    if (axisLength > 0.f) {
+        axis /= axisLength;
+        for (const auto& normal : normals) {
+            if (glm::dot(normal, normal) != 0.f) {
+                minDot = std::min(minDot, glm::dot(normal, axis));
+            }
+        }
+    }
+
+    for (auto axisIndex = 0; axisIndex < 3; ++axisIndex) {
+        meshlet.center[axisIndex] = center[axisIndex];
+        meshlet.coneApex[axisIndex] = center[axisIndex];
+        meshlet.coneAxis[axisIndex] = axis[axisIndex];
+    }
+    meshlet.radius = radius;
+    meshlet.coneCutoff = 2.f;
+    if (axisLength == 0.f || minDot <= minConeSpread) {
+        return;
+    }
+
+    // The apex goes back along the axis until every triangle's plane is
+    // in front of it, from behind the apex all of them face away
+    auto apexDistance = 0.f;
+    auto triangle = std::size_t(0);
+    for (auto index = first; index + 3 <= last; index += 3, ++triangle) {
+        const auto& normal = normals[triangle];
+        if (glm::dot(normal, normal) == 0.f) {
+            continue;
+        }
+        const auto distance = glm::dot(
+                center - mesh.vertices[index[0]].position, normal)/
+                glm::dot(axis, normal);
+        apexDistance = std::max(apexDistance, distance);
+    }
+    const auto apex = center - axis*apexDistance;
+    for (auto axisIndex = 0; axisIndex < 3; ++axisIndex) {
+        meshlet.coneApex[axisIndex] = apex[axisIndex];
+    }
+    meshlet.coneCutoff = std::sqrt(1.f - minDot*minDot);
+}
+
+void buildMeshlets(Mesh& mesh) noexcept {
+    mesh.meshlets.clear();
+
+    // Which meshlet last used each vertex, + 1 so 0 is none
+    auto owner = std::vector<std::uint32_t>(mesh.vertices.size(), 0u);
+    auto id = 0u;
+
+    // Vertices triangle i adds to meshlet id, a degenerate triangle's
+    // repeated corners count once
+    const auto newVertices = [&mesh, &owner, &id](const std::uint32_t i) {
+        const auto a = mesh.indices[i];
+        const auto b = mesh.indices[i + 1u];
+        const auto c = mesh.indices[i + 2u];
+        return std::size_t(owner[a] != id) +
+                std::size_t(owner[b] != id && b != a) +
+                std::size_t(owner[c] != id && c != a && c != b);
+    };
+
+    for (auto index = std::size_t(0); index < mesh.submeshes.size();
+            ++index) {
+        const auto& submesh = mesh.submeshes[index];
+        const auto end = submesh.firstIndex + submesh.indexCount;
+        auto meshlet = Meshlet();
+        meshlet.firstIndex = submesh.firstIndex;
+        meshlet.submesh = static_cast<std::uint32_t>(index);
+        auto vertexCount = std::size_t(0);
+        auto low = UINT32_MAX;
+        auto high = 0u;
+        ++id;
+        for (auto i = submesh.firstIndex; i + 3u <= end; i += 3u) {
+            auto added = newVertices(i);
+            const auto a = mesh.indices[i];
+            const auto b = mesh.indices[i + 1u];
+            const auto c = mesh.indices[i + 2u];
+            const auto triangleLow = std::min(a, std::min(b, c));
+            const auto triangleHigh = std::max(a, std::max(b, c));
+            if (vertexCount + added > meshletMaxVertices ||
+                    meshlet.indexCount/3u == meshletMaxTriangles ||
+                    std::max(high, triangleHigh) -
+                    std::min(low, triangleLow) >= maxVertexSpan) {
+                computeMeshletBounds(mesh, meshlet);
+                mesh.meshlets.push_back(meshlet);
+                meshlet.firstIndex = i;
+                meshlet.indexCount = 0u;
+                vertexCount = 0u;
+                low = UINT32_MAX;
+                high = 0u;
+                ++id;
+                added = newVertices(i);
+            }
+            low = std::min(low, triangleLow);
+            high = std::max(high, triangleHigh);
+            for (auto corner = 0u; corner < 3u; ++corner) {
+                owner[mesh.indices[i + corner]] = id;
+            }
+            vertexCount += added;
+            meshlet.indexCount += 3u;
+        }
+        if (meshlet.indexCount != 0u) {
+            computeMeshletBounds(mesh, meshlet);
+            mesh.meshlets.push_back(meshlet);
+        }
+    }
+
+    // Meshlets are in submesh order, so are the levels' submeshes
+    for (auto& level : mesh.lods) {
+        const auto submeshLess = [](const Meshlet& meshlet,
+                const std::uint32_t submesh) {
+            return meshlet.submesh < submesh;
+        };
+        const auto first = std::lower_bound(mesh.meshlets.begin(),
+                mesh.meshlets.end(), level.firstSubmesh, submeshLess);
+        const auto last = std::lower_bound(first, mesh.meshlets.end(),
+                level.firstSubmesh + level.submeshCount, submeshLess);
+        level.firstMeshlet = static_cast<std::uint32_t>(
+                first - mesh.meshlets.begin());
+        level.meshletCount = static_cast<std::uint32_t>(last - first);
+    }
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstddef>
+
+// Limits of one meshlet, those NVIDIA recommends for mesh shaders so the
+// clusters stay usable by them
+constexpr auto meshletMaxVertices = std::size_t(64);
+constexpr auto meshletMaxTriangles = std::size_t(124);
+
+// Splits every submesh in meshlets, greedily in index order, so the last
+// pass that reorders triangles must run before. A meshlet's vertices also
+// span under 65536 so 16-bit packing keeps it whole. The levels of detail
+// get their meshlet ranges. Replaces existing meshlets
+void buildMeshlets(Mesh& mesh) noexcept;
@@ -0,0 +1,1260 @@
+#include "meshloader.hpp"
+
+#include <glm/ext.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <utility>
+
+static bool readFile(const char* const fileName,
+        std::vector<char>& data) noexcept {
+    const auto file = std::fopen(fileName, "rb");
+    if (!file) {
+        return false;
+    }
+    std::fseek(file, 0, SEEK_END);
+    const auto size = std::ftell(file);
+    std::fseek(file, 0, SEEK_SET);
+    data.resize(size > 0 ? static_cast<std::size_t>(size) : 0u);
+    const auto read = std::fread(data.data(), 1u, data.size(), file);
+    std::fclose(file);
+    return read == data.size();
+}
+
+// Numbers
+
+static const double powersOf10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static auto isDigit(const char c) noexcept {
+    return c >= '0' && c <= '9';
+}
+
+// Decimal with optional sign, fraction and exponent. Up to 19 significant
+// digits are kept in an integer and scaled once by an exact power of 10,
+// returns nullptr when there are no digits
+static const char* parseDouble(const char* p, const char* const end,
+        double& value) noexcept {
+    auto negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+
+    auto mantissa = std::uint64_t(0);
+    auto digits = 0;
+    auto exponent = 0;
+    auto anyDigit = false;
+    for (; p != end && isDigit(*p); ++p) {
+        anyDigit = true;
+        if (digits < 19) {
+            mantissa = mantissa*10u + std::uint64_t(*p - '0');
+            digits += mantissa != 0u;
+        }
+        else {
+            ++exponent;
+        }
+    }
+    if (p != end && *p == '.') {
+        for (++p; p != end && isDigit(*p); ++p) {
+            anyDigit = true;
+            if (digits < 19) {
+                mantissa = mantissa*10u + std::uint64_t(*p - '0');
+                digits += mantissa != 0u;
+                --exponent;
+            }
+        }
+    }
+    if (!anyDigit) {
+        return nullptr;
+    }
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        auto q = p + 1;
+        auto negativeExponent = false;
+        if (q != end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            ++q;
+        }
+        if (q != end && isDigit(*q)) {
+            auto written = 0;
+            for (; q != end && isDigit(*q); ++q) {
+                written = std::min(written*10 + (*q - '0'), 100000);
+            }
+            exponent += negativeExponent ? -written : written;
+            p = q;
+        }
+    }
+
+    auto result = static_cast<double>(mantissa);
+    if (exponent < 0 && exponent >= -22) {
+        result /= powersOf10[-exponent];
+    }
+    else if (exponent > 0 && exponent <= 22) {
+        result *= powersOf10[exponent];
+    }
+    else if (exponent != 0) {
+        result *= std::pow(10., exponent);
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+static const char* parseFloat(const char* p, const char* const end,
+        float& value) noexcept {
+    auto result = 0.;
+    p = parseDouble(p, end, result);
+    value = static_cast<float>(result);
+    return p;
+}
+
+static const char* parseInt(const char* p, const char* const end,
+        std::int64_t& value) noexcept {
+    auto negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        ++p;
+    }
+    if (p == end || !isDigit(*p)) {
+        return nullptr;
+    }
+    auto result = std::int64_t(0);
+    for (; p != end && isDigit(*p); ++p) {
+        result = std::min<std::int64_t>(result*10 + (*p - '0'), INT32_MAX);
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+static const char* skipSpaces(const char* p, const char* const end) noexcept {
+    while (p != end && (*p == ' ' || *p == '\t')) {
+        ++p;
+    }
+    return p;
+}
+
+static const char* nextLine(const char* p, const char* const end) noexcept {
+    const auto newline = static_cast<const char*>(
+            std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+    return newline ? newline + 1 : end;
+}
+
+// OBJ
+
+constexpr auto objChunkSize = std::size_t(1) << 20;
+constexpr auto noTexcoord = INT64_MIN;
+
+// Relative indices can only be resolved once the counts of the earlier
+// chunks are known, they are stored as the index in this chunk, which may
+// be negative, minus this bias. Absolute ones are stored 0-based
+constexpr auto relativeBias = std::int64_t(1) << 40;
+
+struct ObjCorner {
+    std::int64_t position;
+    std::int64_t texcoord;
+};
+
+struct ObjMaterialStart {
+    std::uint32_t corner;
+    std::string name;
+};
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> colors;
+    std::vector<glm::vec2> texcoords;
+    std::vector<ObjCorner> corners; // 3 per triangle
+    std::vector<ObjMaterialStart> materials;
+    const char* error = nullptr;
+};
+
+static auto encodeObjIndex(const std::int64_t index,
+        const std::size_t localCount) noexcept {
+    return index > 0 ? index - 1 :
+            std::int64_t(localCount) + index - relativeBias;
+}
+
+static const char* parseObjFace(const char* p, const char* const end,
+        ObjChunk& chunk) noexcept {
+    ObjCorner first = {};
+    ObjCorner previous = {};
+    auto count = 0;
+    while (true) {
+        p = skipSpaces(p, end);
+        if (p == end || *p == '\n' || *p == '\r' || *p == '#') {
+            break;
+        }
+
+        auto index = std::int64_t(0);
+        p = parseInt(p, end, index);
+        if (!p || index == 0) {
+            return nullptr;
+        }
+        auto corner = ObjCorner{
+                encodeObjIndex(index, chunk.positions.size()), noTexcoord };
+        if (p != end && *p == '/') {
+            ++p;
+            if (p != end && *p != '/') {
+                p = parseInt(p, end, index);
+                if (!p || index == 0) {
+                    return nullptr;
+                }
+                corner.texcoord = encodeObjIndex(index,
+                        chunk.texcoords.size());
+            }
+            // Normals are not part of Vertex
+            if (p != end && *p == '/') {
+                p = parseInt(p + 1, end, index);
+                if (!p) {
+                    return nullptr;
+                }
+            }
+        }
+
+        if (count == 0) {
+            first = corner;
+        }
+        else if (count >= 2) {
+            chunk.corners.push_back(first);
+            chunk.corners.push_back(previous);
+            chunk.corners.push_back(corner);
+        }
+        previous = corner;
+        ++count;
+    }
+    return count >= 3 ? p : nullptr;
+}
+
+static void parseObjChunk(ObjChunk& chunk) noexcept {
+    const auto end = chunk.end;
+    for (auto line = chunk.begin; line != end; line = nextLine(line, end)) {
+        auto p = skipSpaces(line, end);
+        if (end - p < 2) {
+            continue;
+        }
+
+        if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            auto position = glm::vec3(0.f);
+            auto color = glm::vec3(1.f);
+            p = parseFloat(skipSpaces(p + 1, end), end, position.x);
+            p = p ? parseFloat(skipSpaces(p, end), end, position.y) : p;
+            p = p ? parseFloat(skipSpaces(p, end), end, position.z) : p;
+            if (!p) {
+                chunk.error = line;
+                return;
+            }
+
+            // Optional vertex colour, or a w that is ignored
+            auto extra = glm::vec3(0.f);
+            auto q = parseFloat(skipSpaces(p, end), end, extra.x);
+            q = q ? parseFloat(skipSpaces(q, end), end, extra.y) : q;
+            q = q ? parseFloat(skipSpaces(q, end), end, extra.z) : q;
+            if (q) {
+                color = extra;
+            }
+            chunk.positions.push_back(position);
+            chunk.colors.push_back(color);
+        }
+        else if (p[0] == 'v' && p[1] == 't') {
+            auto texcoord = glm::vec2(0.f);
+            p = parseFloat(skipSpaces(p + 2, end), end, texcoord.x);
+            if (!p) {
+                chunk.error = line;
+                return;
+            }
+            // v is optional
+            const auto q = parseFloat(skipSpaces(p, end), end, texcoord.y);
+            chunk.texcoords.push_back(q ? texcoord :
+                    glm::vec2(texcoord.x, 0.f));
+        }
+        else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            if (!parseObjFace(p + 1, end, chunk)) {
+                chunk.error = line;
+                return;
+            }
+        }
+        else if (end - p > 7 && std::memcmp(p, "usemtl", 6) == 0 &&
+                (p[6] == ' ' || p[6] == '\t')) {
+            const auto nameBegin = skipSpaces(p + 6, end);
+            auto nameEnd = nameBegin;
+            while (nameEnd != end && *nameEnd != '\n' && *nameEnd != '\r') {
+                ++nameEnd;
+            }
+            while (nameEnd != nameBegin &&
+                    (nameEnd[-1] == ' ' || nameEnd[-1] == '\t')) {
+                --nameEnd;
+            }
+            chunk.materials.push_back({
+                    static_cast<std::uint32_t>(chunk.corners.size()),
+                    std::string(nameBegin, nameEnd) });
+        }
+    }
+}
+
+// Out of range indices come back as SIZE_MAX
+static auto resolveObjIndex(const std::int64_t encoded,
+        const std::size_t chunkStart) noexcept {
+    const auto index = encoded >= 0 ? encoded :
+            std::int64_t(chunkStart) + encoded + relativeBias;
+    return index >= 0 ? std::size_t(index) : SIZE_MAX;
+}
+
+static auto lineNumber(const char* const text, const char* const line)
+        noexcept {
+    return 1 + std::count(text, line, '\n');
+}
+
+bool loadObj(const char* const text, const std::size_t size, Mesh& mesh,
+        JobSystem* const jobs) noexcept {
+    const auto end = text + size;
+
+    // Chunks start at line starts
+
+    auto chunks = std::vector<ObjChunk>();
+    for (auto begin = text; begin != end;) {
+        auto chunkEnd = begin + std::min(objChunkSize,
+                static_cast<std::size_t>(end - begin));
+        if (chunkEnd != end) {
+            chunkEnd = nextLine(chunkEnd, end);
+        }
+        chunks.push_back(ObjChunk{ begin, chunkEnd, {}, {}, {}, {}, {},
+                nullptr });
+        begin = chunkEnd;
+    }
+
+    const auto parseChunks = [&chunks](const std::size_t begin,
+            const std::size_t last) {
+        for (auto chunk = begin; chunk < last; ++chunk) {
+            parseObjChunk(chunks[chunk]);
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(chunks.size(), 1u, parseChunks);
+    }
+    else {
+        parseChunks(0u, chunks.size());
+    }
+
+    // Concatenate, relative indices resolve against the chunk's start
+
+    auto positionStarts = std::vector<std::size_t>(chunks.size());
+    auto texcoordStarts = std::vector<std::size_t>(chunks.size());
+    auto positions = std::vector<glm::vec3>();
+    auto colors = std::vector<glm::vec3>();
+    auto texcoords = std::vector<glm::vec2>();
+    auto cornerCount = std::size_t(0);
+    for (auto chunk = std::size_t(0); chunk < chunks.size(); ++chunk) {
+        const auto& parsed = chunks[chunk];
+        if (parsed.error) {
+            std::cout << "OBJ line " << lineNumber(text, parsed.error) <<
+                    " can't be parsed\n";
+            return false;
+        }
+        positionStarts[chunk] = positions.size();
+        texcoordStarts[chunk] = texcoords.size();
+        positions.insert(positions.end(), parsed.positions.begin(),
+                parsed.positions.end());
+        colors.insert(colors.end(), parsed.colors.begin(),
+                parsed.colors.end());
+        texcoords.insert(texcoords.end(), parsed.texcoords.begin(),
+                parsed.texcoords.end());
+        cornerCount += parsed.corners.size();
+    }
+    if (cornerCount == 0u) {
+        std::cout << "OBJ has no faces\n";
+        return false;
+    }
+
+    // A vertex is a unique position and texcoord pair. Vertices of a
+    // position are chained from it, usually there is only one
+
+    constexpr auto none = UINT32_MAX;
+    auto firstVertex = std::vector<std::uint32_t>(positions.size(), none);
+    auto nextVertex = std::vector<std::uint32_t>();
+    auto vertexTexcoords = std::vector<std::int64_t>();
+
+    mesh = Mesh();
+    mesh.vertices.reserve(positions.size());
+    mesh.indices.reserve(cornerCount);
+    auto materialNames = std::vector<std::string>();
+
+    const auto startSubmesh = [&mesh, &materialNames](
+            const ObjMaterialStart& material) {
+        const auto name = std::find(materialNames.begin(),
+                materialNames.end(), material.name);
+        const auto index = static_cast<std::uint32_t>(
+                name - materialNames.begin());
+        if (name == materialNames.end()) {
+            materialNames.push_back(material.name);
+        }
+        const auto first = static_cast<std::uint32_t>(mesh.indices.size());
+        if (!mesh.submeshes.empty() &&
+                mesh.submeshes.back().firstIndex == first) {
+            mesh.submeshes.back().material = index;
+        }
+        else {
+            mesh.submeshes.push_back(Submesh{ first, 0u, index });
+        }
+    };
+
+    for (auto chunk = std::size_t(0); chunk < chunks.size(); ++chunk) {
+        const auto& parsed = chunks[chunk];
+        auto material = parsed.materials.begin();
+
+        for (auto corner = std::size_t(0); corner < parsed.corners.size();
+                ++corner) {
+            for (; material != parsed.materials.end() &&
+                    material->corner == corner; ++material) {
+                startSubmesh(*material);
+            }
+
+            const auto& objCorner = parsed.corners[corner];
+            const auto position = resolveObjIndex(objCorner.position,
+                    positionStarts[chunk]);
+            auto texcoord = noTexcoord;
+            if (objCorner.texcoord != noTexcoord) {
+                const auto resolved = resolveObjIndex(objCorner.texcoord,
+                        texcoordStarts[chunk]);
+                if (resolved >= texcoords.size()) {
+                    std::cout << "OBJ texcoord index out of range\n";
+                    return false;
+                }
+                texcoord = static_cast<std::int64_t>(resolved);
+            }
+            if (position >= positions.size()) {
+                std::cout << "OBJ position index out of range\n";
+                return false;
+            }
+
+            auto vertex = firstVertex[position];
+            while (vertex != none && vertexTexcoords[vertex] != texcoord) {
+                vertex = nextVertex[vertex];
+            }
+            if (vertex == none) {
+                vertex = static_cast<std::uint32_t>(mesh.vertices.size());
+                mesh.vertices.push_back(Vertex{ positions[position],
+                        colors[position], texcoord != noTexcoord ?
+                        texcoords[std::size_t(texcoord)] : glm::vec2(0.f) });
+                vertexTexcoords.push_back(texcoord);
+                nextVertex.push_back(firstVertex[position]);
+                firstVertex[position] = vertex;
+            }
+            mesh.indices.push_back(vertex);
+        }
+
+        // usemtl after the chunk's last face applies to the next chunk's
+        for (; material != parsed.materials.end(); ++material) {
+            startSubmesh(*material);
+        }
+    }
+
+    // Submeshes end where the next one starts
+
+    if (mesh.submeshes.empty() || mesh.submeshes.front().firstIndex != 0u) {
+        mesh.submeshes.insert(mesh.submeshes.begin(), Submesh());
+    }
+    for (auto submesh = std::size_t(0); submesh < mesh.submeshes.size();
+            ++submesh) {
+        const auto next = submesh + 1u < mesh.submeshes.size() ?
+                mesh.submeshes[submesh + 1u].firstIndex :
+                static_cast<std::uint32_t>(mesh.indices.size());
+        mesh.submeshes[submesh].indexCount =
+                next - mesh.submeshes[submesh].firstIndex;
+    }
+    mesh.submeshes.erase(std::remove_if(mesh.submeshes.begin(),
+            mesh.submeshes.end(), [](const Submesh& submesh) {
+        return submesh.indexCount == 0u;
+    }), mesh.submeshes.end());
+    return true;
+}
+
+// JSON, just enough for glTF
+
+// glTF indices, counts and offsets that are missing, negative, fractional
+// or too large read as this, which no bounds check accepts
+constexpr auto invalidIndex = SIZE_MAX;
+
+struct JsonValue {
+    enum class Type {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.;
+    std::string string;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> members;
+
+    const JsonValue* find(const char* const key) const noexcept {
+        for (const auto& member : members) {
+            if (member.first == key) {
+                return &member.second;
+            }
+        }
+        return nullptr;
+    }
+
+    // Missing or mistyped members read as the fallback
+    double numberOr(const char* const key,
+            const double fallback) const noexcept {
+        const auto value = find(key);
+        return value && value->type == Type::Number ? value->number :
+                fallback;
+    }
+    std::size_t index() const noexcept {
+        // Below 2^53 every double is exact and fits size_t on 64-bit
+        return type == Type::Number && number >= 0. &&
+                number < 9007199254740992. && number < double(SIZE_MAX) &&
+                number == std::floor(number) ?
+                static_cast<std::size_t>(number) : invalidIndex;
+    }
+    std::size_t indexOr(const char* const key,
+            const std::size_t fallback = invalidIndex) const noexcept {
+        const auto value = find(key);
+        return value ? value->index() : fallback;
+    }
+    const JsonValue* arrayOf(const char* const key) const noexcept {
+        const auto value = find(key);
+        return value && value->type == Type::Array ? value : nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* const text, const char* const end) noexcept
+        : p(text), end(end) {}
+
+    bool parse(JsonValue& value) noexcept {
+        return parseValue(value, 0) && (skip(), p == end);
+    }
+
+private:
+    static constexpr auto maxDepth = 64;
+
+    void skip() noexcept {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\n' ||
+                *p == '\r')) {
+            ++p;
+        }
+    }
+
+    bool literal(const char* const word) noexcept {
+        const auto length = std::strlen(word);
+        if (static_cast<std::size_t>(end - p) < length ||
+                std::memcmp(p, word, length) != 0) {
+            return false;
+        }
+        p += length;
+        return true;
+    }
+
+    static void appendUtf8(std::string& out, const unsigned code) noexcept {
+        if (code < 0x80u) {
+            out += static_cast<char>(code);
+        }
+        else if (code < 0x800u) {
+            out += static_cast<char>(0xc0u | (code >> 6));
+            out += static_cast<char>(0x80u | (code & 0x3fu));
+        }
+        else {
+            out += static_cast<char>(0xe0u | (code >> 12));
+            out += static_cast<char>(0x80u | ((code >> 6) & 0x3fu));
+            out += static_cast<char>(0x80u | (code & 0x3fu));
+        }
+    }
+
+    bool parseString(std::string& out) noexcept {
+        if (p == end || *p != '"') {
+            return false;
+        }
+        for (++p; p != end && *p != '"'; ++p) {
+            if (*p != '\\') {
+                out += *p;
+                continue;
+            }
+            if (++p == end) {
+                return false;
+            }
+            switch (*p) {
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u': {
+                if (end - p < 5) {
+                    return false;
+                }
+                auto code = 0u;
+                for (auto digit = 1; digit <= 4; ++digit) {
+                    const auto c = p[digit];
+                    code <<= 4;
+                    if (isDigit(c)) {
+                        code |= unsigned(c - '0');
+                    }
+                    else if (c >= 'a' && c <= 'f') {
+                        code |= unsigned(c - 'a' + 10);
+                    }
+                    else if (c >= 'A' && c <= 'F') {
+                        code |= unsigned(c - 'A' + 10);
+                    }
+                    else {
+                        return false;
+                    }
+                }
+                appendUtf8(out, code);
+                p += 4;
+                break;
+            }
+            default:
+                out += *p;
+                break;
+            }
+        }
+        if (p == end) {
+            return false;
+        }
+        ++p;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, const int depth) noexcept {
+        skip();
+        if (p == end || depth > maxDepth) {
+            return false;
+        }
+        switch (*p) {
+        case '{':
+            value.type = JsonValue::Type::Object;
+            ++p;
+            skip();
+            if (p != end && *p == '}') {
+                ++p;
+                return true;
+            }
+            while (true) {
+                skip();
+                auto member = std::pair<std::string, JsonValue>();
+                if (!parseString(member.first)) {
+                    return false;
+                }
+                skip();
+                if (p == end || *p++ != ':' ||
+                        !parseValue(member.second, depth + 1)) {
+                    return false;
+                }
+                value.members.push_back(std::move(member));
+                skip();
+                if (p == end) {
+                    return false;
+                }
+                if (*p == '}') {
+                    ++p;
+                    return true;
+                }
+                if (*p++ != ',') {
+                    return false;
+                }
+            }
+        case '[':
+            value.type = JsonValue::Type::Array;
+            ++p;
+            skip();
+            if (p != end && *p == ']') {
+                ++p;
+                return true;
+            }
+            while (true) {
+                value.items.emplace_back();
+                if (!parseValue(value.items.back(), depth + 1)) {
+                    return false;
+                }
+                skip();
+                if (p == end) {
+                    return false;
+                }
+                if (*p == ']') {
+                    ++p;
+                    return true;
+                }
+                if (*p++ != ',') {
+                    return false;
+                }
+            }
+        case '"':
+            value.type = JsonValue::Type::String;
+            return parseString(value.string);
+        case 't':
+            value.type = JsonValue::Type::Bool;
+            value.boolean = true;
+            return literal("true");
+        case 'f':
+            value.type = JsonValue::Type::Bool;
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+            value.type = JsonValue::Type::Number;
+            p = parseDouble(p, end, value.number);
+            return p != nullptr;
+        }
+    }
+
+    const char* p;
+    const char* end;
+};
+
+// glTF
+
+constexpr auto glbMagic = 0x46546c67u;     // "glTF"
+constexpr auto glbJsonChunk = 0x4e4f534au; // "JSON"
+constexpr auto glbBinChunk = 0x004e4942u;  // "BIN"
+
+static auto readUint32(const char* const data) noexcept {
+    auto value = std::uint32_t(0);
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static bool decodeBase64(const std::string& text, const std::size_t begin,
+        std::vector<char>& out) noexcept {
+    auto bits = 0u;
+    auto bitCount = 0;
+    out.clear();
+    for (auto i = begin; i < text.size() && text[i] != '='; ++i) {
+        const auto c = text[i];
+        auto sextet = 0u;
+        if (c >= 'A' && c <= 'Z') {
+            sextet = unsigned(c - 'A');
+        }
+        else if (c >= 'a' && c <= 'z') {
+            sextet = unsigned(c - 'a' + 26);
+        }
+        else if (isDigit(c)) {
+            sextet = unsigned(c - '0' + 52);
+        }
+        else if (c == '+') {
+            sextet = 62u;
+        }
+        else if (c == '/') {
+            sextet = 63u;
+        }
+        else {
+            return false;
+        }
+        bits = (bits << 6) | sextet;
+        bitCount += 6;
+        if (bitCount >= 8) {
+            bitCount -= 8;
+            out.push_back(static_cast<char>((bits >> bitCount) & 0xffu));
+        }
+    }
+    return true;
+}
+
+struct GltfAccessor {
+    const char* data = nullptr;
+    std::size_t count = 0u;
+    std::size_t stride = 0u;
+    int componentType = 0;
+    int components = 0;
+    bool normalized = false;
+
+    float component(const std::size_t element,
+            const int index) const noexcept {
+        const auto at = data + element*stride;
+        switch (componentType) {
+        case 5120: {
+            const auto value = float(static_cast<signed char>(at[index]));
+            return normalized ? std::max(value/127.f, -1.f) : value;
+        }
+        case 5121: {
+            const auto value = float(static_cast<unsigned char>(at[index]));
+            return normalized ? value/255.f : value;
+        }
+        case 5122: {
+            auto raw = std::int16_t(0);
+            std::memcpy(&raw, at + index*2, sizeof(raw));
+            return normalized ? std::max(raw/32767.f, -1.f) : float(raw);
+        }
+        case 5123: {
+            auto raw = std::uint16_t(0);
+            std::memcpy(&raw, at + index*2, sizeof(raw));
+            return normalized ? raw/65535.f : float(raw);
+        }
+        case 5125:
+            return float(index32(element));
+        default: {
+            auto value = 0.f;
+            std::memcpy(&value, at + index*4, sizeof(value));
+            return value;
+        }
+        }
+    }
+
+    std::uint32_t index32(const std::size_t element) const noexcept {
+        const auto at = data + element*stride;
+        switch (componentType) {
+        case 5121:
+            return static_cast<unsigned char>(*at);
+        case 5123: {
+            auto raw = std::uint16_t(0);
+            std::memcpy(&raw, at, sizeof(raw));
+            return raw;
+        }
+        default: {
+            auto raw = std::uint32_t(0);
+            std::memcpy(&raw, at, sizeof(raw));
+            return raw;
+        }
+        }
+    }
+};
+
+static auto componentSize(const int componentType) noexcept {
+    switch (componentType) {
+    case 5120:
+    case 5121:
+        return 1;
+    case 5122:
+    case 5123:
+        return 2;
+    case 5125:
+    case 5126:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static auto componentCount(const std::string& type) noexcept {
+    if (type == "SCALAR") {
+        return 1;
+    }
+    if (type == "VEC2") {
+        return 2;
+    }
+    if (type == "VEC3") {
+        return 3;
+    }
+    if (type == "VEC4") {
+        return 4;
+    }
+    return 0;
+}
+
+class GltfDocument {
+public:
+    bool load(const char* const fileName) noexcept;
+
+    bool accessor(const std::size_t index, GltfAccessor& out) const noexcept;
+
+    JsonValue root;
+
+private:
+    std::vector<char> file;
+    std::vector<std::vector<char>> buffers;
+};
+
+bool GltfDocument::load(const char* const fileName) noexcept {
+    if (!readFile(fileName, file)) {
+        std::cout << "Mesh \"" << fileName << "\" not found\n";
+        return false;
+    }
+
+    // GLB is a header, the JSON chunk and an optional binary chunk
+
+    auto json = file.data();
+    auto jsonEnd = file.data() + file.size();
+    auto binary = std::vector<char>();
+    if (file.size() >= 20u && readUint32(file.data()) == glbMagic) {
+        const auto jsonLength = readUint32(file.data() + 12);
+        if (readUint32(file.data() + 16) != glbJsonChunk ||
+                jsonLength > file.size() - 20u) {
+            std::cout << "GLB \"" << fileName << "\" is corrupt\n";
+            return false;
+        }
+        json = file.data() + 20;
+        jsonEnd = json + jsonLength;
+        const auto binOffset = 20u + std::size_t(jsonLength);
+        if (binOffset + 8u <= file.size() &&
+                readUint32(file.data() + binOffset + 4) == glbBinChunk) {
+            const auto binLength = std::min<std::size_t>(
+                    readUint32(file.data() + binOffset),
+                    file.size() - binOffset - 8u);
+            binary.assign(file.data() + binOffset + 8,
+                    file.data() + binOffset + 8 + binLength);
+        }
+        // Chunks are padded with spaces, the parser skips them
+    }
+    if (!JsonParser(json, jsonEnd).parse(root) ||
+            root.type != JsonValue::Type::Object) {
+        std::cout << "glTF \"" << fileName << "\" is not valid JSON\n";
+        return false;
+    }
+
+    // Buffers, relative to the document
+
+    auto directory = std::string(fileName);
+    const auto slash = directory.find_last_of("/\\");
+    directory = slash == std::string::npos ? std::string() :
+            directory.substr(0, slash + 1);
+
+    if (const auto list = root.arrayOf("buffers")) {
+        for (const auto& buffer : list->items) {
+            buffers.emplace_back();
+            const auto uri = buffer.find("uri");
+            if (!uri || uri->type != JsonValue::Type::String) {
+                buffers.back() = std::move(binary);
+                continue;
+            }
+            if (uri->string.compare(0, 5, "data:") == 0) {
+                const auto base64 = uri->string.find(";base64,");
+                if (base64 == std::string::npos || !decodeBase64(
+                        uri->string, base64 + 8, buffers.back())) {
+                    std::cout << "glTF buffer data URI can't be decoded\n";
+                    return false;
+                }
+                continue;
+            }
+            if (!readFile((directory + uri->string).c_str(),
+                    buffers.back())) {
+                std::cout << "glTF buffer \"" << uri->string <<
+                        "\" not found\n";
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool GltfDocument::accessor(const std::size_t index,
+        GltfAccessor& out) const noexcept {
+    const auto accessors = root.arrayOf("accessors");
+    const auto views = root.arrayOf("bufferViews");
+    if (!accessors || index >= accessors->items.size() || !views) {
+        return false;
+    }
+    const auto& accessor = accessors->items[index];
+    if (accessor.find("sparse")) {
+        std::cout << "glTF sparse accessors are not supported\n";
+        return false;
+    }
+
+    const auto type = accessor.find("type");
+    out = GltfAccessor();
+    out.componentType = int(std::min<std::size_t>(
+            accessor.indexOr("componentType", 0u), INT_MAX));
+    out.components = type ? componentCount(type->string) : 0;
+    out.count = accessor.indexOr("count", 0u);
+    const auto normalized = accessor.find("normalized");
+    out.normalized = normalized && normalized->boolean;
+
+    const auto elementSize = std::size_t(componentSize(out.componentType)*
+            out.components);
+    const auto viewIndex = accessor.indexOr("bufferView");
+    if (elementSize == 0u || viewIndex >= views->items.size()) {
+        return false;
+    }
+    const auto& view = views->items[viewIndex];
+    const auto bufferIndex = view.indexOr("buffer");
+    if (bufferIndex >= buffers.size()) {
+        return false;
+    }
+    const auto& buffer = buffers[bufferIndex];
+    const auto viewOffset = view.indexOr("byteOffset", 0u);
+    const auto viewLength = view.indexOr("byteLength", 0u);
+    const auto offset = accessor.indexOr("byteOffset", 0u);
+    out.stride = view.indexOr("byteStride", elementSize);
+
+    // Every element must be inside the view and the view in the buffer,
+    // compared without sums that could wrap
+    const auto viewFits = viewOffset <= buffer.size() &&
+            viewLength <= buffer.size() - viewOffset;
+    const auto elementsFit = out.count != 0u && offset <= viewLength &&
+            elementSize <= viewLength - offset && (out.count == 1u ||
+            out.stride <= (viewLength - offset - elementSize)/
+            (out.count - 1u));
+    if (!viewFits || !elementsFit) {
+        std::cout << "glTF accessor " << index << " is out of bounds\n";
+        return false;
+    }
+    out.data = buffer.data() + viewOffset + offset;
+    return true;
+}
+
+struct GltfPrimitive {
+    const JsonValue* primitive;
+    glm::mat4 transform;
+    std::size_t firstVertex;
+    std::size_t firstIndex;
+    GltfAccessor positions;
+    GltfAccessor texcoords;
+    GltfAccessor colors;
+    GltfAccessor indices;
+    bool hasTexcoords;
+    bool hasColors;
+    bool hasIndices;
+};
+
+static auto nodeTransform(const JsonValue& node) noexcept {
+    if (const auto matrix = node.arrayOf("matrix")) {
+        auto result = glm::mat4(1.f);
+        for (auto i = 0; i < 16 && i < int(matrix->items.size()); ++i) {
+            result[i/4][i%4] = float(matrix->items[std::size_t(i)].number);
+        }
+        return result;
+    }
+
+    auto translation = glm::vec3(0.f);
+    auto rotation = glm::quat(1.f, 0.f, 0.f, 0.f);
+    auto scale = glm::vec3(1.f);
+    if (const auto t = node.arrayOf("translation")) {
+        for (auto i = 0; i < 3 && i < int(t->items.size()); ++i) {
+            translation[i] = float(t->items[std::size_t(i)].number);
+        }
+    }
+    if (const auto r = node.arrayOf("rotation")) {
+        if (r->items.size() == 4u) {
+            // glTF stores x, y, z, w
+            rotation = glm::quat(float(r->items[3].number),
+                    float(r->items[0].number), float(r->items[1].number),
+                    float(r->items[2].number));
+        }
+    }
+    if (const auto s = node.arrayOf("scale")) {
+        for (auto i = 0; i < 3 && i < int(s->items.size()); ++i) {
+            scale[i] = float(s->items[std::size_t(i)].number);
+        }
+    }
+    return glm::translate(glm::mat4(1.f), translation)*
+            glm::mat4_cast(rotation)*glm::scale(glm::mat4(1.f), scale);
+}
+
+static void collectPrimitives(const JsonValue& root, const std::size_t node,
+        const glm::mat4& parent, std::vector<GltfPrimitive>& primitives,
+        const int depth) noexcept {
+    const auto nodes = root.arrayOf("nodes");
+    if (!nodes || node >= nodes->items.size() || depth > 64) {
+        return;
+    }
+    const auto& json = nodes->items[node];
+    const auto transform = parent*nodeTransform(json);
+
+    const auto meshes = root.arrayOf("meshes");
+    const auto meshIndex = json.indexOr("mesh");
+    if (meshes && meshIndex < meshes->items.size()) {
+        if (const auto list = meshes->items[meshIndex].arrayOf(
+                "primitives")) {
+            for (const auto& primitive : list->items) {
+                // Only triangle lists
+                if (primitive.numberOr("mode", 4.) == 4.) {
+                    auto entry = GltfPrimitive();
+                    entry.primitive = &primitive;
+                    entry.transform = transform;
+                    primitives.push_back(entry);
+                }
+            }
+        }
+    }
+    if (const auto children = json.arrayOf("children")) {
+        for (const auto& child : children->items) {
+            collectPrimitives(root, child.index(), transform,
+                    primitives, depth + 1);
+        }
+    }
+}
+
+static void fillPrimitive(const GltfPrimitive& primitive,
+        Mesh& mesh) noexcept {
+    const auto count = primitive.positions.count;
+    for (auto i = std::size_t(0); i < count; ++i) {
+        auto& vertex = mesh.vertices[primitive.firstVertex + i];
+        const auto position = glm::vec3(
+                primitive.positions.component(i, 0),
+                primitive.positions.component(i, 1),
+                primitive.positions.component(i, 2));
+        vertex.position = glm::vec3(primitive.transform*
+                glm::vec4(position, 1.f));
+        vertex.color = glm::vec3(1.f);
+        if (primitive.hasColors) {
+            vertex.color = glm::vec3(primitive.colors.component(i, 0),
+                    primitive.colors.component(i, 1),
+                    primitive.colors.component(i, 2));
+        }
+        vertex.texcoord = glm::vec2(0.f);
+        if (primitive.hasTexcoords) {
+            // glTF's v points down, ours up as in OBJ
+            vertex.texcoord = glm::vec2(primitive.texcoords.component(i, 0),
+                    1.f - primitive.texcoords.component(i, 1));
+        }
+    }
+
+    // Mirroring transforms flip the winding. A trailing partial triangle
+    // has no room, loadGltf() only counted whole ones
+    const auto mirrored = glm::determinant(
+            glm::mat3(primitive.transform)) < 0.f;
+    const auto indexCount = (primitive.hasIndices ?
+            primitive.indices.count : count)/3u*3u;
+    for (auto i = std::size_t(0); i < indexCount; ++i) {
+        auto corner = i;
+        if (mirrored && i%3u != 0u) {
+            corner = i%3u == 1u ? i + 1u : i - 1u;
+        }
+        const auto index = primitive.hasIndices ?
+                primitive.indices.index32(corner) :
+                static_cast<std::uint32_t>(corner);
+        mesh.indices[primitive.firstIndex + i] = static_cast<std::uint32_t>(
+                std::min<std::size_t>(index, count - 1u) +
+                primitive.firstVertex);
+    }
+}
+
+bool loadGltf(const char* const fileName, Mesh& mesh,
+        JobSystem* const jobs) noexcept {
+    auto document = GltfDocument();
+    if (!document.load(fileName)) {
+        return false;
+    }
+    const auto& root = document.root;
+
+    // Nodes of the default scene, or every mesh as is without scenes
+
+    auto primitives = std::vector<GltfPrimitive>();
+    const auto scenes = root.arrayOf("scenes");
+    if (scenes && !scenes->items.empty()) {
+        const auto scene = std::min(root.indexOr("scene", 0u),
+                scenes->items.size() - 1u);
+        if (const auto nodes = scenes->items[scene].arrayOf("nodes")) {
+            for (const auto& node : nodes->items) {
+                collectPrimitives(root, node.index(),
+                        glm::mat4(1.f), primitives, 0);
+            }
+        }
+    }
+    else if (const auto meshes = root.arrayOf("meshes")) {
+        for (const auto& json : meshes->items) {
+            if (const auto list = json.arrayOf("primitives")) {
+                for (const auto& primitive : list->items) {
+                    if (primitive.numberOr("mode", 4.) == 4.) {
+                        auto entry = GltfPrimitive();
+                        entry.primitive = &primitive;
+                        entry.transform = glm::mat4(1.f);
+                        primitives.push_back(entry);
+                    }
+                }
+            }
+        }
+    }
+
+    // Resolve the accessors and lay the primitives out one after another
+
+    mesh = Mesh();
+    auto vertexCount = std::size_t(0);
+    auto indexCount = std::size_t(0);
+    for (auto& primitive : primitives) {
+        const auto attributes = primitive.primitive->find("attributes");
+        if (!attributes || !document.accessor(
+                attributes->indexOr("POSITION"), primitive.positions) ||
+                primitive.positions.components != 3) {
+            std::cout << "glTF primitive without usable positions\n";
+            return false;
+        }
+        primitive.hasTexcoords = document.accessor(
+                attributes->indexOr("TEXCOORD_0"), primitive.texcoords) &&
+                primitive.texcoords.components == 2 &&
+                primitive.texcoords.count >= primitive.positions.count;
+        primitive.hasColors = document.accessor(
+                attributes->indexOr("COLOR_0"), primitive.colors) &&
+                primitive.colors.components >= 3 &&
+                primitive.colors.count >= primitive.positions.count;
+        primitive.hasIndices = document.accessor(
+                primitive.primitive->indexOr("indices"), primitive.indices) &&
+                primitive.indices.components == 1;
+
+        primitive.firstVertex = vertexCount;
+        primitive.firstIndex = indexCount;
+        vertexCount += primitive.positions.count;
+        indexCount += (primitive.hasIndices ? primitive.indices.count :
+                primitive.positions.count)/3u*3u;
+
+        mesh.submeshes.push_back(Submesh{
+                static_cast<std::uint32_t>(primitive.firstIndex),
+                static_cast<std::uint32_t>(indexCount - primitive.firstIndex),
+                static_cast<std::uint32_t>(std::min<std::size_t>(
+                        primitive.primitive->indexOr("material", 0u),
+                        UINT32_MAX)) });
+    }
+    if (indexCount == 0u || vertexCount > UINT32_MAX) {
+        std::cout << "glTF \"" << fileName << "\" has no usable triangles\n";
+        return false;
+    }
+
+    mesh.vertices.resize(vertexCount);
+    mesh.indices.resize(indexCount);
+    const auto fill = [&primitives, &mesh](const std::size_t begin,
+            const std::size_t end) {
+        for (auto primitive = begin; primitive < end; ++primitive) {
+            fillPrimitive(primitives[primitive], mesh);
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(primitives.size(), 1u, fill);
+    }
+    else {
+        fill(0u, primitives.size());
+    }
+    return true;
+}
+
+bool loadMesh(const char* const fileName, Mesh& mesh,
+        JobSystem* const jobs) noexcept {
+    const auto name = std::string(fileName);
+    const auto dot = name.find_last_of('.');
+    auto extension = dot == std::string::npos ? std::string() :
+            name.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+            [](const char c) {
+        return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c);
+    });
+
+    auto loaded = false;
+    if (extension == "obj") {
+        auto text = std::vector<char>();
+        if (!readFile(fileName, text)) {
+            std::cout << "Mesh \"" << fileName << "\" not found\n";
+            return false;
+        }
+        loaded = loadObj(text.data(), text.size(), mesh, jobs);
+    }
+    else if (extension == "gltf" || extension == "glb") {
+        loaded = loadGltf(fileName, mesh, jobs);
+    }
+    else {
+        std::cout << "Mesh \"" << fileName << "\" has an unknown format\n";
+        return false;
+    }
+
+    if (!loaded) {
+        std::cout << "Mesh \"" << fileName << "\" loading failed\n";
+        return false;
+    }
+    computeBounds(mesh);
+    return true;
+}
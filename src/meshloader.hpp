@@ -0,0 +1,23 @@
+#pragma once
+
+#include "jobsystem.hpp"
+#include "mesh.hpp"
+
+#include <cstddef>
+
+// Wavefront OBJ: v (with the optional r g b extension), vt and f with
+// polygons fan triangulated, usemtl starts a submesh. The text is split in
+// chunks at line starts and the chunks are parsed on the job system, only
+// the vertex deduplication runs on one thread
+bool loadObj(const char* const text, const std::size_t size, Mesh& mesh,
+        JobSystem* const jobs = nullptr) noexcept;
+
+// glTF 2.0, .gltf with external .bin buffers or .glb. Triangle primitives
+// of all meshes the default scene references, flattened with their node
+// transforms, one submesh per primitive
+bool loadGltf(const char* const fileName, Mesh& mesh,
+        JobSystem* const jobs = nullptr) noexcept;
+
+// Picks the loader by extension and fills in the bounds
+bool loadMesh(const char* const fileName, Mesh& mesh,
+        JobSystem* const jobs = nullptr) noexcept;
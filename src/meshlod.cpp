@@ -0,0 +1,354 @@
+#include "meshlod.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+// Symmetric 4x4 matrix, the sum of squared distances to planes
+
+struct Quadric {
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    double weight;
+};
+
+static void addPlane(Quadric& q, const glm::vec3& normal, const float d,
+        const double weight) noexcept {
+    const auto x = double(normal.x);
+    const auto y = double(normal.y);
+    const auto z = double(normal.z);
+    const auto w = double(d);
+    q.a00 += weight*x*x;
+    q.a01 += weight*x*y;
+    q.a02 += weight*x*z;
+    q.a03 += weight*x*w;
+    q.a11 += weight*y*y;
+    q.a12 += weight*y*z;
+    q.a13 += weight*y*w;
+    q.a22 += weight*z*z;
+    q.a23 += weight*z*w;
+    q.a33 += weight*w*w;
+    q.weight += weight;
+}
+
+static void add(Quadric& q, const Quadric& other) noexcept {
+    q.a00 += other.a00;
+    q.a01 += other.a01;
+    q.a02 += other.a02;
+    q.a03 += other.a03;
+    q.a11 += other.a11;
+    q.a12 += other.a12;
+    q.a13 += other.a13;
+    q.a22 += other.a22;
+    q.a23 += other.a23;
+    q.a33 += other.a33;
+    q.weight += other.weight;
+}
+
+// Mean squared distance of a point to the planes of a and b
+static auto collapseError(const Quadric& a, const Quadric& b,
+        const glm::vec3& point) noexcept {
+    const auto x = double(point.x);
+    const auto y = double(point.y);
+    const auto z = double(point.z);
+    const auto error = [x, y, z](const Quadric& q) {
+        return q.a00*x*x + 2.*q.a01*x*y + 2.*q.a02*x*z + 2.*q.a03*x +
+                q.a11*y*y + 2.*q.a12*y*z + 2.*q.a13*y +
+                q.a22*z*z + 2.*q.a23*z + q.a33;
+    };
+    const auto weight = a.weight + b.weight;
+    return weight > 0. ? std::max(error(a) + error(b), 0.)/weight : 0.;
+}
+
+static auto edgeKey(const std::uint32_t a, const std::uint32_t b) noexcept {
+    return a < b ? std::uint64_t(a) << 32 | b : std::uint64_t(b) << 32 | a;
+}
+
+struct Collapse {
+    std::uint32_t from;
+    std::uint32_t to;
+    double error;
+};
+
+std::size_t simplify(std::uint32_t* const destination,
+        const std::uint32_t* const indices, const std::size_t indexCount,
+        const Vertex* const vertices, const std::size_t vertexCount,
+        const std::size_t targetIndexCount, const float maxError,
+        float& error) noexcept {
+    auto result = std::vector<std::uint32_t>(indices,
+            indices + indexCount/3u*3u);
+    error = 0.f;
+
+    // Edges used by one triangle are open, their vertices stay
+
+    auto locked = std::vector<bool>(vertexCount, false);
+    {
+        auto edges = std::unordered_map<std::uint64_t, std::uint32_t>();
+        edges.reserve(result.size());
+        for (auto i = std::size_t(0); i < result.size(); ++i) {
+            const auto next = i%3u == 2u ? i - 2u : i + 1u;
+            ++edges[edgeKey(result[i], result[next])];
+        }
+        for (const auto& edge : edges) {
+            if (edge.second == 1u) {
+                locked[edge.first >> 32] = true;
+                locked[edge.first & 0xffffffffu] = true;
+            }
+        }
+    }
+
+    // Planes of the triangles around each vertex, weighted by area
+
+    auto quadrics = std::vector<Quadric>(vertexCount, Quadric());
+    for (auto i = std::size_t(0); i < result.size(); i += 3u) {
+        const auto& a = vertices[result[i]].position;
+        const auto& b = vertices[result[i + 1u]].position;
+        const auto& c = vertices[result[i + 2u]].position;
+        const auto cross = glm::cross(b - a, c - a);
+        const auto length = glm::length(cross);
+        if (length <= 0.f) {
+            continue;
+        }
+        const auto normal = cross/length;
+        const auto d = -glm::dot(normal, a);
+        for (auto corner = 0u; corner < 3u; ++corner) {
+            addPlane(quadrics[result[i + corner]], normal, d, length*.5);
+        }
+    }
+
+    const auto maxErrorSquared = double(maxError)*maxError;
+    auto firstTriangle = std::vector<std::uint32_t>(vertexCount + 1u);
+    auto adjacency = std::vector<std::uint32_t>();
+    auto touched = std::vector<bool>(vertexCount, false);
+    auto collapses = std::vector<Collapse>();
+    auto edges = std::vector<std::uint64_t>();
+
+    // Passes of independent collapses, cheapest first
+
+    while (result.size() > targetIndexCount) {
+        const auto triangleCount = result.size()/3u;
+
+        std::fill(firstTriangle.begin(), firstTriangle.end(), 0u);
+        for (const auto index : result) {
+            ++firstTriangle[index + 1u];
+        }
+        for (auto vertex = std::size_t(0); vertex < vertexCount; ++vertex) {
+            firstTriangle[vertex + 1u] += firstTriangle[vertex];
+        }
+        adjacency.resize(result.size());
+        {
+            auto cursor = std::vector<std::uint32_t>(firstTriangle.begin(),
+                    firstTriangle.end() - 1);
+            for (auto i = std::size_t(0); i < result.size(); ++i) {
+                adjacency[cursor[result[i]]++] =
+                        static_cast<std::uint32_t>(i/3u);
+            }
+        }
+
+        edges.clear();
+        for (auto i = std::size_t(0); i < result.size(); ++i) {
+            const auto next = i%3u == 2u ? i - 2u : i + 1u;
+            edges.push_back(edgeKey(result[i], result[next]));
+        }
+        std::sort(edges.begin(), edges.end());
+        edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+        collapses.clear();
+        for (const auto edge : edges) {
+            const auto a = static_cast<std::uint32_t>(edge >> 32);
+            const auto b = static_cast<std::uint32_t>(edge & 0xffffffffu);
+            const auto toB = locked[a] ? -1. : collapseError(quadrics[a],
+                    quadrics[b], vertices[b].position);
+            const auto toA = locked[b] ? -1. : collapseError(quadrics[a],
+                    quadrics[b], vertices[a].position);
+            if (toB >= 0. && (toA < 0. || toB <= toA)) {
+                collapses.push_back(Collapse{ a, b, toB });
+            }
+            else if (toA >= 0.) {
+                collapses.push_back(Collapse{ b, a, toA });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                [](const Collapse& x, const Collapse& y) {
+            return x.error < y.error;
+        });
+
+        // A collapse changes the triangles around its from vertex, the
+        // vertices of those wait for the next pass
+
+        std::fill(touched.begin(), touched.end(), false);
+        const auto removable = (result.size() - targetIndexCount)/3u;
+        auto removed = std::size_t(0);
+        auto applied = std::size_t(0);
+        for (const auto& collapse : collapses) {
+            if (collapse.error > maxErrorSquared || removed >= removable) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            // Triangles that stay must not flip
+            const auto& target = vertices[collapse.to].position;
+            auto flips = false;
+            auto merged = std::size_t(0);
+            for (auto t = firstTriangle[collapse.from];
+                    t < firstTriangle[collapse.from + 1u] && !flips; ++t) {
+                const auto triangle = result.data() + adjacency[t]*3u;
+                if (triangle[0] == collapse.to || triangle[1] == collapse.to ||
+                        triangle[2] == collapse.to) {
+                    ++merged;
+                    continue;
+                }
+                glm::vec3 before[3];
+                glm::vec3 after[3];
+                for (auto corner = 0; corner < 3; ++corner) {
+                    before[corner] = vertices[triangle[corner]].position;
+                    after[corner] = triangle[corner] == collapse.from ?
+                            target : before[corner];
+                }
+                const auto normalBefore = glm::cross(before[1] - before[0],
+                        before[2] - before[0]);
+                const auto normalAfter = glm::cross(after[1] - after[0],
+                        after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.f;
+            }
+            if (flips) {
+                continue;
+            }
+
+            for (auto t = firstTriangle[collapse.from];
+                    t < firstTriangle[collapse.from + 1u]; ++t) {
+                const auto triangle = result.data() + adjacency[t]*3u;
+                touched[triangle[0]] = true;
+                touched[triangle[1]] = true;
+                touched[triangle[2]] = true;
+            }
+            for (auto t = firstTriangle[collapse.from];
+                    t < firstTriangle[collapse.from + 1u]; ++t) {
+                const auto triangle = result.data() + adjacency[t]*3u;
+                for (auto corner = 0; corner < 3; ++corner) {
+                    if (triangle[corner] == collapse.from) {
+                        triangle[corner] = collapse.to;
+                    }
+                }
+            }
+            add(quadrics[collapse.to], quadrics[collapse.from]);
+            error = std::max(error, float(std::sqrt(collapse.error)));
+            removed += merged;
+            ++applied;
+        }
+        if (applied == 0u) {
+            break;
+        }
+
+        // Collapsed edges left degenerate triangles
+
+        auto kept = std::size_t(0);
+        for (auto triangle = std::size_t(0); triangle < triangleCount;
+                ++triangle) {
+            const auto a = result[triangle*3u];
+            const auto b = result[triangle*3u + 1u];
+            const auto c = result[triangle*3u + 2u];
+            if (a != b && b != c && c != a) {
+                result[kept++] = a;
+                result[kept++] = b;
+                result[kept++] = c;
+            }
+        }
+        result.resize(kept);
+    }
+
+    std::copy(result.begin(), result.end(), destination);
+    return result.size();
+}
+
+void generateLods(Mesh& mesh, const LodOptions& options) noexcept {
+    if (!mesh.lods.empty() || mesh.submeshes.empty()) {
+        return;
+    }
+    computeBounds(mesh);
+    const auto maxError = options.maxError*glm::length(
+            mesh.boundsMax - mesh.boundsMin);
+
+    mesh.lods.push_back(MeshLod{ 0u,
+            static_cast<std::uint32_t>(mesh.submeshes.size()), 0.f });
+    auto simplified = std::vector<std::uint32_t>();
+    while (mesh.lods.size() < options.maxLods) {
+        const auto previous = mesh.lods.back();
+        const auto indexCount = mesh.indices.size();
+        const auto submeshCount = mesh.submeshes.size();
+
+        auto before = std::size_t(0);
+        auto after = std::size_t(0);
+        auto levelError = 0.f;
+        for (auto submesh = previous.firstSubmesh;
+                submesh < previous.firstSubmesh + previous.submeshCount;
+                ++submesh) {
+            const auto source = mesh.submeshes[submesh];
+            const auto target = static_cast<std::size_t>(
+                    source.indexCount*options.reduction)/3u*3u;
+            auto error = 0.f;
+            simplified.resize(source.indexCount);
+            simplified.resize(simplify(simplified.data(),
+                    mesh.indices.data() + source.firstIndex,
+                    source.indexCount, mesh.vertices.data(),
+                    mesh.vertices.size(), target,
+                    maxError - previous.error, error));
+            levelError = std::max(levelError, error);
+            before += source.indexCount;
+            after += simplified.size();
+            if (simplified.empty()) {
+                continue;
+            }
+
+            auto coarser = source;
+            coarser.firstIndex = static_cast<std::uint32_t>(
+                    mesh.indices.size());
+            coarser.indexCount = static_cast<std::uint32_t>(
+                    simplified.size());
+            mesh.indices.insert(mesh.indices.end(), simplified.begin(),
+                    simplified.end());
+            mesh.submeshes.push_back(coarser);
+        }
+
+        // Levels that save little aren't worth their memory
+        if (after == 0u || after > before*9u/10u) {
+            mesh.indices.resize(indexCount);
+            mesh.submeshes.resize(submeshCount);
+            break;
+        }
+        mesh.lods.push_back(MeshLod{
+                static_cast<std::uint32_t>(submeshCount),
+                static_cast<std::uint32_t>(mesh.submeshes.size() -
+                        submeshCount),
+                previous.error + levelError });
+    }
+}
+
+std::size_t selectLod(const MeshView& mesh, const float pixelsPerUnit,
+        const std::size_t current, const LodSelection& selection) noexcept {
+    const auto count = lodCount(mesh);
+    const auto pixels = [&mesh, pixelsPerUnit](const std::size_t level) {
+        return lod(mesh, level).error*pixelsPerUnit;
+    };
+
+    // Coarser only well below the limit, finer as soon as it's exceeded
+
+    auto coarser = current;
+    while (coarser + 1u < count && pixels(coarser + 1u) <=
+            selection.pixelError*(1.f - selection.hysteresis)) {
+        ++coarser;
+    }
+    if (coarser != current) {
+        return coarser;
+    }
+    auto level = std::min(current, count - 1u);
+    while (level > 0u && pixels(level) > selection.pixelError) {
+        --level;
+    }
+    return level;
+}
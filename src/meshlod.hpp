@@ -0,0 +1,44 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Quadric error metric simplification (Garland and Heckbert), edges
+// collapse onto one of their vertices so the result indexes the same
+// vertices. Vertices on open edges, UV seams included, stay. Stops at
+// targetIndexCount or before a collapse would move the surface by more
+// than maxError model units. Returns the index count written to
+// destination, error gets the largest collapse error
+std::size_t simplify(std::uint32_t* const destination,
+        const std::uint32_t* const indices, const std::size_t indexCount,
+        const Vertex* const vertices, const std::size_t vertexCount,
+        const std::size_t targetIndexCount, const float maxError,
+        float& error) noexcept;
+
+struct LodOptions {
+    std::size_t maxLods = 4u; // The full detail one included
+    float reduction = .5f; // Triangles kept from one level to the next
+    float maxError = .05f; // Of the coarsest level, relative to the bounds
+};
+
+// Appends levels to a mesh without them, each simplified from the one
+// before until the reduction or the error runs out
+void generateLods(Mesh& mesh,
+        const LodOptions& options = LodOptions()) noexcept;
+
+struct LodSelection {
+    float pixelError = 1.f; // Largest error allowed on screen
+
+    // A coarser level is only taken once its error is this much below the
+    // limit, so levels don't flicker at the switching distance
+    float hysteresis = .25f;
+};
+
+// Projects the levels' errors with pixelsPerUnit, the pixels one model
+// unit covers at the object's distance, and returns the coarsest level
+// that stays below the limit, current is the level drawn so far
+std::size_t selectLod(const MeshView& mesh, const float pixelsPerUnit,
+        const std::size_t current,
+        const LodSelection& selection = LodSelection()) noexcept;
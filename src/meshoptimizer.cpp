@@ -0,0 +1,360 @@
+#include "meshoptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+VertexCacheStats analyzeVertexCache(const std::uint32_t* const indices,
+        const std::size_t indexCount, const std::size_t vertexCount,
+        const std::size_t cacheSize) noexcept {
+    // A vertex is cached until cacheSize misses came after its own,
+    // 0 - never transformed
+    auto missTime = std::vector<std::size_t>(vertexCount, 0u);
+    auto time = cacheSize + 1u;
+
+    auto stats = VertexCacheStats();
+    stats.triangles = indexCount/3u;
+    for (auto i = std::size_t(0); i < indexCount; ++i) {
+        auto& stamp = missTime[indices[i]];
+        if (stamp == 0u) {
+            ++stats.vertices;
+        }
+        if (stamp == 0u || time - stamp > cacheSize) {
+            stamp = time++;
+            ++stats.transformedVertices;
+        }
+    }
+    return stats;
+}
+
+// Forsyth
+
+constexpr auto forsythCacheSize = 32;
+constexpr auto noTriangle = UINT32_MAX;
+
+// Last three used score the same, they were one triangle, so reusing them
+// in any order is as good
+static auto cachePositionScore(const int position) noexcept {
+    if (position < 0) {
+        return 0.f;
+    }
+    if (position < 3) {
+        return .75f;
+    }
+    return std::pow(1.f - float(position - 3)/(forsythCacheSize - 3), 1.5f);
+}
+
+// Vertices with few triangles left go first, so no lone triangles strand
+static auto vertexScore(const int position,
+        const std::uint32_t remaining) noexcept {
+    return remaining == 0u ? -1.f : cachePositionScore(position) +
+            2.f/std::sqrt(float(remaining));
+}
+
+void optimizeVertexCache(std::uint32_t* const indices,
+        const std::size_t indexCount, const std::size_t vertexCount) noexcept {
+    const auto triangleCount = indexCount/3u;
+    if (triangleCount < 2u) {
+        return;
+    }
+
+    // Triangles of each vertex, the live ones first
+
+    auto remaining = std::vector<std::uint32_t>(vertexCount, 0u);
+    for (auto i = std::size_t(0); i < triangleCount*3u; ++i) {
+        ++remaining[indices[i]];
+    }
+    auto firstTriangle = std::vector<std::uint32_t>(vertexCount + 1u, 0u);
+    for (auto vertex = std::size_t(0); vertex < vertexCount; ++vertex) {
+        firstTriangle[vertex + 1u] = firstTriangle[vertex] + remaining[vertex];
+    }
+    auto adjacency = std::vector<std::uint32_t>(triangleCount*3u);
+    {
+        auto cursor = std::vector<std::uint32_t>(firstTriangle.begin(),
+                firstTriangle.end() - 1);
+        for (auto i = std::size_t(0); i < triangleCount*3u; ++i) {
+            adjacency[cursor[indices[i]]++] = static_cast<std::uint32_t>(i/3u);
+        }
+    }
+
+    auto scores = std::vector<float>(vertexCount);
+    for (auto vertex = std::size_t(0); vertex < vertexCount; ++vertex) {
+        scores[vertex] = vertexScore(-1, remaining[vertex]);
+    }
+    auto triangleScores = std::vector<float>(triangleCount);
+    auto emitted = std::vector<bool>(triangleCount, false);
+    auto best = std::uint32_t(0);
+    for (auto triangle = std::size_t(0); triangle < triangleCount;
+            ++triangle) {
+        triangleScores[triangle] = scores[indices[triangle*3u]] +
+                scores[indices[triangle*3u + 1u]] +
+                scores[indices[triangle*3u + 2u]];
+        if (triangleScores[triangle] > triangleScores[best]) {
+            best = static_cast<std::uint32_t>(triangle);
+        }
+    }
+
+    auto output = std::vector<std::uint32_t>();
+    output.reserve(triangleCount*3u);
+    std::uint32_t cache[forsythCacheSize + 3];
+    auto cacheCount = 0;
+    std::uint32_t nextCache[forsythCacheSize + 3];
+    auto deadEnds = std::vector<std::uint32_t>();
+    auto scan = std::size_t(0);
+
+    while (output.size() < triangleCount*3u) {
+        // Nothing around the cache is left, continue next to the vertices
+        // emitted most recently, they border what is done. The input order
+        // is the last resort
+        while (best == noTriangle && !deadEnds.empty()) {
+            const auto vertex = deadEnds.back();
+            deadEnds.pop_back();
+            const auto begin = firstTriangle[vertex];
+            for (auto t = begin; t < begin + remaining[vertex]; ++t) {
+                const auto triangle = adjacency[t];
+                if (best == noTriangle ||
+                        triangleScores[triangle] > triangleScores[best]) {
+                    best = triangle;
+                }
+            }
+        }
+        if (best == noTriangle) {
+            while (emitted[scan]) {
+                ++scan;
+            }
+            best = static_cast<std::uint32_t>(scan);
+        }
+
+        const std::uint32_t corners[] = { indices[best*3u],
+                indices[best*3u + 1u], indices[best*3u + 2u] };
+        output.insert(output.end(), corners, corners + 3);
+        deadEnds.insert(deadEnds.end(), corners, corners + 3);
+        emitted[best] = true;
+
+        for (const auto vertex : corners) {
+            const auto begin = adjacency.begin() + firstTriangle[vertex];
+            const auto end = begin + remaining[vertex];
+            const auto found = std::find(begin, end, best);
+            if (found != end) {
+                std::iter_swap(found, end - 1);
+                --remaining[vertex];
+            }
+        }
+
+        // The triangle's vertices move to the front, the rest shifts back
+
+        auto nextCount = 0;
+        for (const auto vertex : corners) {
+            if (std::find(nextCache, nextCache + nextCount, vertex) ==
+                    nextCache + nextCount) {
+                nextCache[nextCount++] = vertex;
+            }
+        }
+        for (auto i = 0; i < cacheCount; ++i) {
+            if (std::find(corners, corners + 3, cache[i]) == corners + 3) {
+                nextCache[nextCount++] = cache[i];
+            }
+        }
+
+        // Rescore what moved, evicted vertices included, and find the best
+        // triangle around the cache
+
+        best = noTriangle;
+        auto bestScore = 0.f;
+        for (auto i = 0; i < nextCount; ++i) {
+            const auto vertex = nextCache[i];
+            const auto position = i < forsythCacheSize ? i : -1;
+            const auto score = vertexScore(position, remaining[vertex]);
+            const auto delta = score - scores[vertex];
+            scores[vertex] = score;
+
+            const auto begin = firstTriangle[vertex];
+            for (auto t = begin; t < begin + remaining[vertex]; ++t) {
+                const auto triangle = adjacency[t];
+                triangleScores[triangle] += delta;
+                if (position >= 0 && triangleScores[triangle] > bestScore) {
+                    best = triangle;
+                    bestScore = triangleScores[triangle];
+                }
+            }
+        }
+        cacheCount = std::min(nextCount, forsythCacheSize);
+        std::copy(nextCache, nextCache + cacheCount, cache);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+// Overdraw
+
+constexpr auto overdrawCacheSize = std::size_t(16);
+
+void optimizeOverdraw(std::uint32_t* const indices,
+        const std::size_t indexCount, const Vertex* const vertices,
+        const std::size_t vertexCount, const float threshold) noexcept {
+    const auto triangleCount = indexCount/3u;
+    if (triangleCount < 2u) {
+        return;
+    }
+
+    // Cache misses per triangle in the current order, a cluster restarts
+    // the cache so its simulation starts empty
+
+    auto missTime = std::vector<std::size_t>(vertexCount, 0u);
+    auto time = overdrawCacheSize + 1u;
+    const auto misses = [&](const std::size_t triangle) {
+        auto count = 0u;
+        for (auto corner = 0u; corner < 3u; ++corner) {
+            auto& stamp = missTime[indices[triangle*3u + corner]];
+            if (stamp == 0u || time - stamp > overdrawCacheSize) {
+                stamp = time++;
+                ++count;
+            }
+        }
+        return count;
+    };
+    const auto resetCache = [&time] {
+        time += overdrawCacheSize;
+    };
+
+    // Hard boundaries, the cache order restarted there
+
+    auto hard = std::vector<std::size_t>();
+    for (auto triangle = std::size_t(0); triangle < triangleCount;
+            ++triangle) {
+        if (misses(triangle) == 3u) {
+            hard.push_back(triangle);
+        }
+    }
+    if (hard.empty() || hard.front() != 0u) {
+        hard.insert(hard.begin(), 0u);
+    }
+    hard.push_back(triangleCount);
+
+    // Soft boundaries, where the cluster so far has no worse ACMR than the
+    // whole one by the threshold
+
+    auto clusters = std::vector<std::size_t>();
+    for (auto cluster = std::size_t(0); cluster + 1u < hard.size();
+            ++cluster) {
+        const auto begin = hard[cluster];
+        const auto end = hard[cluster + 1u];
+
+        resetCache();
+        auto clusterMisses = 0u;
+        for (auto triangle = begin; triangle < end; ++triangle) {
+            clusterMisses += misses(triangle);
+        }
+        const auto clusterThreshold = threshold*clusterMisses/(end - begin);
+
+        resetCache();
+        clusters.push_back(begin);
+        auto runningMisses = 0u;
+        auto runningTriangles = 0u;
+        for (auto triangle = begin; triangle < end; ++triangle) {
+            runningMisses += misses(triangle);
+            ++runningTriangles;
+            if (triangle + 1u < end && float(runningMisses)/
+                    runningTriangles <= clusterThreshold) {
+                clusters.push_back(triangle + 1u);
+                resetCache();
+                runningMisses = 0u;
+                runningTriangles = 0u;
+            }
+        }
+    }
+    clusters.push_back(triangleCount);
+
+    // Clusters facing away from the mesh centre occlude the others
+
+    auto meshCentroid = glm::vec3(0.f);
+    auto meshArea = 0.f;
+    struct Cluster {
+        std::size_t begin;
+        std::size_t end;
+        float sortKey;
+    };
+    auto sorted = std::vector<Cluster>(clusters.size() - 1u);
+    auto centroids = std::vector<glm::vec3>(sorted.size());
+    auto normals = std::vector<glm::vec3>(sorted.size());
+    for (auto cluster = std::size_t(0); cluster < sorted.size(); ++cluster) {
+        auto centroid = glm::vec3(0.f);
+        auto normal = glm::vec3(0.f);
+        auto area = 0.f;
+        for (auto triangle = clusters[cluster];
+                triangle < clusters[cluster + 1u]; ++triangle) {
+            const auto& a = vertices[indices[triangle*3u]].position;
+            const auto& b = vertices[indices[triangle*3u + 1u]].position;
+            const auto& c = vertices[indices[triangle*3u + 2u]].position;
+            const auto cross = glm::cross(b - a, c - a);
+            const auto triangleArea = glm::length(cross);
+            centroid += (a + b + c)*(triangleArea/3.f);
+            normal += cross;
+            area += triangleArea;
+        }
+        meshCentroid += centroid;
+        meshArea += area;
+        centroids[cluster] = area > 0.f ? centroid/area : centroid;
+        normals[cluster] = glm::length(normal) > 0.f ?
+                glm::normalize(normal) : normal;
+        sorted[cluster] = Cluster{ clusters[cluster], clusters[cluster + 1u],
+                0.f };
+    }
+    if (meshArea > 0.f) {
+        meshCentroid /= meshArea;
+    }
+    for (auto cluster = std::size_t(0); cluster < sorted.size(); ++cluster) {
+        sorted[cluster].sortKey = glm::dot(
+                centroids[cluster] - meshCentroid, normals[cluster]);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(),
+            [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    auto output = std::vector<std::uint32_t>();
+    output.reserve(triangleCount*3u);
+    for (const auto& cluster : sorted) {
+        output.insert(output.end(), indices + cluster.begin*3u,
+                indices + cluster.end*3u);
+    }
+    std::copy(output.begin(), output.end(), indices);
+}
+
+void optimizeVertexFetch(Mesh& mesh) noexcept {
+    constexpr auto unused = UINT32_MAX;
+    auto remap = std::vector<std::uint32_t>(mesh.vertices.size(), unused);
+    auto vertices = std::vector<Vertex>();
+    vertices.reserve(mesh.vertices.size());
+    for (auto& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<std::uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[index]);
+        }
+        index = remap[index];
+    }
+    mesh.vertices = std::move(vertices);
+}
+
+// Each submesh is optimized on the span of vertices it uses, so the passes'
+// per vertex scratch is sized by the submesh instead of the whole mesh
+void optimizeMesh(Mesh& mesh) noexcept {
+    for (const auto& submesh : mesh.submeshes) {
+        const auto indices = mesh.indices.data() + submesh.firstIndex;
+        const auto end = indices + submesh.indexCount;
+        if (indices == end) {
+            continue;
+        }
+        const auto span = std::minmax_element(indices, end);
+        const auto first = *span.first;
+        const auto vertexCount = std::size_t(*span.second - first) + 1u;
+
+        std::for_each(indices, end, [first](auto& index) { index -= first; });
+        optimizeVertexCache(indices, submesh.indexCount, vertexCount);
+        optimizeOverdraw(indices, submesh.indexCount,
+                mesh.vertices.data() + first, vertexCount);
+        std::for_each(indices, end, [first](auto& index) { index += first; });
+    }
+    optimizeVertexFetch(mesh);
+    computeBounds(mesh);
+}
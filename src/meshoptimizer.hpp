@@ -0,0 +1,49 @@
+#pragma once
+
+#include "mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Post-transform vertex cache efficiency of an index buffer, simulated
+// with a FIFO cache like the one GPUs share between neighbouring triangles
+struct VertexCacheStats {
+    std::size_t triangles = 0u;
+    std::size_t vertices = 0u; // Referenced ones
+    std::size_t transformedVertices = 0u; // Cache misses
+
+    // Transformed vertices per triangle, .5 is the ideal for grids, 3 no
+    // reuse at all
+    float acmr() const noexcept {
+        return triangles != 0u ? float(transformedVertices)/triangles : 0.f;
+    }
+    // Transformed vertices per referenced vertex, 1 is the ideal
+    float atvr() const noexcept {
+        return vertices != 0u ? float(transformedVertices)/vertices : 0.f;
+    }
+};
+
+VertexCacheStats analyzeVertexCache(const std::uint32_t* const indices,
+        const std::size_t indexCount, const std::size_t vertexCount,
+        const std::size_t cacheSize = 16u) noexcept;
+
+// Reorders triangles so consecutive ones share vertices, Tom Forsyth's
+// greedy algorithm with a scored 32 entry LRU cache
+void optimizeVertexCache(std::uint32_t* const indices,
+        const std::size_t indexCount, const std::size_t vertexCount) noexcept;
+
+// Splits the cache ordered triangles in clusters and draws the clusters
+// facing out of the mesh first, so they occlude the rest. Clusters are cut
+// where the cache restarts anyway or, within a threshold of the cluster's
+// ACMR, where cutting costs little
+void optimizeOverdraw(std::uint32_t* const indices,
+        const std::size_t indexCount, const Vertex* const vertices,
+        const std::size_t vertexCount,
+        const float threshold = 1.05f) noexcept;
+
+// Renumbers the vertices in the order the indices first use them, unused
+// vertices are dropped
+void optimizeVertexFetch(Mesh& mesh) noexcept;
+
+// Vertex cache and overdraw per submesh, then vertex fetch
+void optimizeMesh(Mesh& mesh) noexcept;
@@ -0,0 +1,345 @@
+#include "mipgen.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIPGEN_SSE 1
+#else
+#include <glm/glm.hpp>
+#endif
+
+#include <algorithm>
+#include <cmath>
+
+// Kaiser window half width in destination texels and its shape
+constexpr auto kaiserRadius = 1.5f;
+constexpr auto kaiserAlpha = 4.f;
+constexpr auto kaiserTaps = 6;
+
+// Linear to sRGB table resolution, fine enough for exact 8 bit results
+// everywhere but the darkest few codes
+constexpr auto encodeSteps = 4096;
+
+// One RGBA texel per register
+
+#if defined(MIPGEN_SSE)
+
+using Texel = __m128;
+
+static inline Texel loadTexel(const float* const texel) noexcept {
+    return _mm_loadu_ps(texel);
+}
+
+static inline void storeTexel(float* const texel, const Texel value) noexcept {
+    _mm_storeu_ps(texel, value);
+}
+
+static inline Texel zeroTexel() noexcept {
+    return _mm_setzero_ps();
+}
+
+static inline Texel addTexels(const Texel a, const Texel b) noexcept {
+    return _mm_add_ps(a, b);
+}
+
+static inline Texel scaleTexel(const Texel a, const float scale) noexcept {
+    return _mm_mul_ps(a, _mm_set1_ps(scale));
+}
+
+#else
+
+using Texel = glm::vec4;
+
+static inline Texel loadTexel(const float* const texel) noexcept {
+    return Texel(texel[0], texel[1], texel[2], texel[3]);
+}
+
+static inline void storeTexel(float* const texel, const Texel value) noexcept {
+    texel[0] = value.x;
+    texel[1] = value.y;
+    texel[2] = value.z;
+    texel[3] = value.w;
+}
+
+static inline Texel zeroTexel() noexcept {
+    return Texel(0.f);
+}
+
+static inline Texel addTexels(const Texel a, const Texel b) noexcept {
+    return a + b;
+}
+
+static inline Texel scaleTexel(const Texel a, const float scale) noexcept {
+    return a*scale;
+}
+
+#endif
+
+// Transfer tables
+
+struct SrgbTables {
+    float decode[256];
+    unsigned char encode[encodeSteps + 1];
+
+    SrgbTables() noexcept {
+        for (auto code = 0; code < 256; ++code) {
+            const auto value = code/255.f;
+            decode[code] = value <= .04045f ? value/12.92f :
+                    std::pow((value + .055f)/1.055f, 2.4f);
+        }
+        for (auto step = 0; step <= encodeSteps; ++step) {
+            const auto value = float(step)/encodeSteps;
+            const auto encoded = value <= .0031308f ? value*12.92f :
+                    1.055f*std::pow(value, 1.f/2.4f) - .055f;
+            encode[step] = static_cast<unsigned char>(
+                    std::lround(std::min(encoded, 1.f)*255.f));
+        }
+    }
+};
+
+static const SrgbTables& srgbTables() noexcept {
+    static const auto tables = SrgbTables();
+    return tables;
+}
+
+// Byte <-> float conversion
+
+static auto toFloat(const unsigned char* const rgba, const std::size_t count,
+        const MipOptions& options) noexcept {
+    const auto& tables = srgbTables();
+    auto texels = std::vector<float>(count*4u);
+    for (auto i = std::size_t(0); i < count; ++i) {
+        const auto source = rgba + i*4u;
+        const auto target = texels.data() + i*4u;
+        const auto alpha = source[3]/255.f;
+        for (auto channel = 0; channel < 3; ++channel) {
+            target[channel] = options.srgb ? tables.decode[source[channel]] :
+                    source[channel]/255.f;
+        }
+        target[3] = alpha;
+        if (options.premultiplyAlpha) {
+            storeTexel(target, scaleTexel(loadTexel(target), alpha));
+            target[3] = alpha;
+        }
+    }
+    return texels;
+}
+
+static auto toBytes(const std::vector<float>& texels,
+        const MipOptions& options) noexcept {
+    const auto& tables = srgbTables();
+    auto bytes = std::vector<unsigned char>(texels.size());
+    const auto count = texels.size()/4u;
+    for (auto i = std::size_t(0); i < count; ++i) {
+        auto texel = loadTexel(texels.data() + i*4u);
+        const auto alpha = std::min(std::max(texels[i*4u + 3], 0.f), 1.f);
+        if (options.premultiplyAlpha && alpha > 0.f) {
+            texel = scaleTexel(texel, 1.f/alpha);
+        }
+
+        float values[4];
+        storeTexel(values, texel);
+        const auto target = bytes.data() + i*4u;
+        for (auto channel = 0; channel < 3; ++channel) {
+            const auto value = std::min(std::max(values[channel], 0.f), 1.f);
+            target[channel] = options.srgb ?
+                    tables.encode[static_cast<int>(value*encodeSteps + .5f)] :
+                    static_cast<unsigned char>(value*255.f + .5f);
+        }
+        target[3] = static_cast<unsigned char>(alpha*255.f + .5f);
+    }
+    return bytes;
+}
+
+// Filters, sizes halve rounded down as GL's mip chain does
+
+// Source texels of one target texel along an axis. Odd sizes get 3 taps,
+// target x of n covers source [x*size/n, (x + 1)*size/n) so the extra
+// texel is spread over the row instead of dropped
+struct BoxTaps {
+    int first = 0;
+    int count = 1;
+    float weights[3] = { 1.f, 0.f, 0.f };
+};
+
+static auto boxTaps(const int x, const int size,
+        const int targetSize) noexcept {
+    auto taps = BoxTaps();
+    taps.first = std::min(2*x, size - 1);
+    if (size == 1) {
+        return taps;
+    }
+    if (size%2 == 0) {
+        taps.count = 2;
+        taps.weights[0] = taps.weights[1] = .5f;
+        return taps;
+    }
+    taps.count = 3;
+    taps.weights[0] = float(targetSize - x)/size;
+    taps.weights[1] = float(targetSize)/size;
+    taps.weights[2] = float(x + 1)/size;
+    return taps;
+}
+
+static auto boxDownsample(const std::vector<float>& source, const int width,
+        const int height) noexcept {
+    const auto targetWidth = std::max(1, width/2);
+    const auto targetHeight = std::max(1, height/2);
+    auto target = std::vector<float>(
+            static_cast<std::size_t>(targetWidth)*targetHeight*4u);
+    for (auto y = 0; y < targetHeight; ++y) {
+        const auto rows = boxTaps(y, height, targetHeight);
+        auto out = target.data() + static_cast<std::size_t>(y)*targetWidth*4u;
+        for (auto x = 0; x < targetWidth; ++x) {
+            const auto columns = boxTaps(x, width, targetWidth);
+            auto sum = zeroTexel();
+            for (auto row = 0; row < rows.count; ++row) {
+                const auto line = source.data() + static_cast<std::size_t>(
+                        rows.first + row)*width*4u;
+                auto rowSum = zeroTexel();
+                for (auto column = 0; column < columns.count; ++column) {
+                    rowSum = addTexels(rowSum, scaleTexel(loadTexel(line +
+                            (columns.first + column)*4),
+                            columns.weights[column]));
+                }
+                sum = addTexels(sum, scaleTexel(rowSum, rows.weights[row]));
+            }
+            storeTexel(out, sum);
+            out += 4;
+        }
+    }
+    return target;
+}
+
+static auto besselI0(const float x) noexcept {
+    auto sum = 1.f;
+    auto term = 1.f;
+    for (auto k = 1; k < 16; ++k) {
+        term *= (x*.5f/k)*(x*.5f/k);
+        sum += term;
+    }
+    return sum;
+}
+
+// A 2:1 reduction samples every destination texel at the same phase, so
+// the 6 weights are shared by all of them
+struct KaiserWeights {
+    float weights[kaiserTaps];
+
+    KaiserWeights() noexcept {
+        auto sum = 0.f;
+        for (auto tap = 0; tap < kaiserTaps; ++tap) {
+            // Source texel centre relative to the destination centre
+            const auto x = (tap - kaiserTaps/2 + .5f)*.5f;
+            const auto t = x/kaiserRadius;
+            const auto window = besselI0(kaiserAlpha*std::sqrt(
+                    std::max(1.f - t*t, 0.f)))/besselI0(kaiserAlpha);
+            const auto sinc = x == 0.f ? 1.f :
+                    std::sin(3.14159265f*x)/(3.14159265f*x);
+            weights[tap] = sinc*window;
+            sum += weights[tap];
+        }
+        for (auto& weight : weights) {
+            weight /= sum;
+        }
+    }
+};
+
+// The taps of odd sizes reach the last texel, past it they clamp to the
+// edge
+static auto kaiserDownsample(const std::vector<float>& source,
+        const int width, const int height) noexcept {
+    static const auto kernel = KaiserWeights();
+    const auto targetWidth = std::max(1, width/2);
+    const auto targetHeight = std::max(1, height/2);
+
+    // Horizontal then vertical pass
+
+    auto rows = std::vector<float>(
+            static_cast<std::size_t>(targetWidth)*height*4u);
+    for (auto y = 0; y < height; ++y) {
+        const auto row = source.data() + static_cast<std::size_t>(y)*width*4u;
+        auto out = rows.data() + static_cast<std::size_t>(y)*targetWidth*4u;
+        for (auto x = 0; x < targetWidth; ++x) {
+            auto sum = zeroTexel();
+            for (auto tap = 0; tap < kaiserTaps; ++tap) {
+                const auto sx = std::min(std::max(
+                        2*x + tap - kaiserTaps/2 + 1, 0), width - 1);
+                sum = addTexels(sum, scaleTexel(loadTexel(row + sx*4),
+                        kernel.weights[tap]));
+            }
+            storeTexel(out, sum);
+            out += 4;
+        }
+    }
+
+    auto target = std::vector<float>(
+            static_cast<std::size_t>(targetWidth)*targetHeight*4u);
+    const auto stride = static_cast<std::size_t>(targetWidth)*4u;
+    for (auto y = 0; y < targetHeight; ++y) {
+        const float* taps[kaiserTaps];
+        for (auto tap = 0; tap < kaiserTaps; ++tap) {
+            taps[tap] = rows.data() + std::min(std::max(
+                    2*y + tap - kaiserTaps/2 + 1, 0), height - 1)*stride;
+        }
+        auto out = target.data() + y*stride;
+        for (auto x = std::size_t(0); x < stride; x += 4u) {
+            auto sum = zeroTexel();
+            for (auto tap = 0; tap < kaiserTaps; ++tap) {
+                sum = addTexels(sum, scaleTexel(loadTexel(taps[tap] + x),
+                        kernel.weights[tap]));
+            }
+            storeTexel(out + x, sum);
+        }
+    }
+    return target;
+}
+
+MipChain generateMips(const unsigned char* const rgba, const int width,
+        const int height, const MipOptions& options) noexcept {
+    auto mips = MipChain();
+    mips.push_back(MipLevel{ width, height, std::vector<unsigned char>(rgba,
+            rgba + static_cast<std::size_t>(width)*height*4u) });
+
+    auto texels = toFloat(rgba, static_cast<std::size_t>(width)*height,
+            options);
+    auto levelWidth = width;
+    auto levelHeight = height;
+    while (levelWidth > 1 || levelHeight > 1) {
+        texels = options.filter == MipFilter::Kaiser ?
+                kaiserDownsample(texels, levelWidth, levelHeight) :
+                boxDownsample(texels, levelWidth, levelHeight);
+        levelWidth = std::max(1, levelWidth/2);
+        levelHeight = std::max(1, levelHeight/2);
+        mips.push_back(MipLevel{ levelWidth, levelHeight,
+                toBytes(texels, options) });
+    }
+    return mips;
+}
+
+std::future<MipChain> generateMipsAsync(std::vector<unsigned char> rgba,
+        const int width, const int height, const MipOptions& options) noexcept {
+    return std::async(std::launch::async,
+            [rgba = std::move(rgba), width, height, options] {
+        return generateMips(rgba.data(), width, height, options);
+    });
+}
+
+GLuint uploadMips(const MipChain& mips, const bool srgbFormat) noexcept {
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    if (mips.empty()) {
+        return texture;
+    }
+
+    glTextureStorage2D(texture, static_cast<GLsizei>(mips.size()),
+            srgbFormat ? GL_SRGB8_ALPHA8 : GL_RGBA8,
+            mips.front().width, mips.front().height);
+    for (auto level = std::size_t(0); level < mips.size(); ++level) {
+        const auto& mip = mips[level];
+        glTextureSubImage2D(texture, static_cast<GLint>(level), 0, 0,
+                mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                mip.pixels.data());
+    }
+    return texture;
+}
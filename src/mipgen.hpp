@@ -0,0 +1,43 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <future>
+#include <vector>
+
+struct MipLevel {
+    int width;
+    int height;
+    std::vector<unsigned char> pixels; // RGBA8
+};
+
+// Level 0 is the source image, the last level is 1x1
+using MipChain = std::vector<MipLevel>;
+
+enum class MipFilter {
+    Box, // 2x2 average, 3 taps along odd sizes
+    Kaiser // Kaiser windowed sinc, sharper on minification
+};
+
+struct MipOptions {
+    MipFilter filter = MipFilter::Box;
+
+    // Colour is sRGB encoded, average it in linear space. Alpha is linear
+    bool srgb = false;
+
+    // Weight colour by alpha while filtering so the colour of transparent
+    // texels doesn't bleed into their neighbours. Output alpha stays straight
+    bool premultiplyAlpha = false;
+};
+
+// Filters in float from the previous float level, so rounding errors don't
+// accumulate down the chain. Safe to call from any thread
+MipChain generateMips(const unsigned char* const rgba, const int width,
+        const int height, const MipOptions& options) noexcept;
+
+std::future<MipChain> generateMipsAsync(std::vector<unsigned char> rgba,
+        const int width, const int height, const MipOptions& options) noexcept;
+
+// Allocates immutable RGBA8 (or SRGB8_ALPHA8) storage and uploads every
+// level. GL thread only
+GLuint uploadMips(const MipChain& mips, const bool srgbFormat) noexcept;
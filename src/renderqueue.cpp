@@ -0,0 +1,165 @@
+#include "renderqueue.hpp"
+
+#include <algorithm>
+
+constexpr auto depthBits = 20u;
+constexpr auto vaoBits = 12u;
+constexpr auto materialBits = 16u;
+constexpr auto programBits = 12u;
+constexpr auto passBits = 4u;
+
+// A draw with a model matrix, a material and a bind, so a buffer usually
+// fits in what is reserved up front
+constexpr auto bytesPerDrawEstimate = std::size_t(128);
+
+static auto field(const std::uint64_t value, const unsigned bits) noexcept {
+    return value & ((std::uint64_t(1) << bits) - 1u);
+}
+
+std::uint64_t makeSortKey(const DrawCommand& draw) noexcept {
+    const auto depthRange = float((1u << depthBits) - 1u);
+    const auto depth = static_cast<std::uint64_t>(
+            std::min(std::max(draw.depth, 0.f), 1.f)*depthRange);
+
+    auto key = field(draw.pass, passBits);
+    key = (key << programBits) | field(draw.program, programBits);
+    key = (key << materialBits) | field(draw.material, materialBits);
+    key = (key << vaoBits) | field(draw.vao, vaoBits);
+    key = (key << depthBits) | depth;
+    return key;
+}
+
+void RenderQueue::clear() noexcept {
+    draws.clear();
+    entries.clear();
+}
+
+void RenderQueue::submit(const DrawCommand& draw) noexcept {
+    entries.push_back({ makeSortKey(draw),
+            static_cast<std::uint32_t>(draws.size()) });
+    draws.push_back(draw);
+}
+
+void RenderQueue::sort() noexcept {
+    const auto count = entries.size();
+    if (count < 2) {
+        return;
+    }
+    scratch.resize(count);
+
+    for (auto shift = 0u; shift < 64u; shift += 8u) {
+        std::size_t histogram[256] = {};
+        for (const auto& entry : entries) {
+            ++histogram[(entry.key >> shift) & 0xffu];
+        }
+
+        // All keys share this byte, the pass would not move anything
+
+        if (histogram[(entries[0].key >> shift) & 0xffu] == count) {
+            continue;
+        }
+
+        auto offset = std::size_t(0);
+        for (auto& bucket : histogram) {
+            const auto bucketSize = bucket;
+            bucket = offset;
+            offset += bucketSize;
+        }
+        for (const auto& entry : entries) {
+            scratch[histogram[(entry.key >> shift) & 0xffu]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::record(CommandBuffer& commands, const std::size_t begin,
+        const std::size_t end) const noexcept {
+    const DrawCommand* previous = nullptr;
+    for (auto index = begin; index < end; ++index) {
+        const auto& draw = draws[entries[index].draw];
+
+        if (!previous || draw.program != previous->program) {
+            commands.bindProgram(draw.program);
+        }
+        for (auto unit = 0u; unit < maxDrawTextures; ++unit) {
+            // 0 means the draw does not sample this unit
+            if (draw.textures[unit] != 0u && (!previous ||
+                    draw.textures[unit] != previous->textures[unit])) {
+                commands.bindTexture(unit,
+                        TextureTarget::Texture2D, draw.textures[unit]);
+            }
+        }
+        if (!previous || draw.vao != previous->vao) {
+            commands.bindVertexArray(draw.vao);
+        }
+
+        if (draw.materialLocation != -1) {
+            commands.setUniform(draw.materialLocation, draw.material);
+        }
+        if (draw.modelMatrixLocation != -1) {
+            commands.setUniform(draw.modelMatrixLocation, draw.modelMatrix);
+        }
+
+        if (draw.indirectDrawCount != 0u) {
+            auto drawIndirect = DrawIndexedIndirectCommand();
+            drawIndirect.topology = draw.topology;
+            drawIndirect.indexType = draw.indexType;
+            drawIndirect.offset = draw.indirectOffset;
+            drawIndirect.drawCount = draw.indirectDrawCount;
+            commands.drawIndexedIndirect(drawIndirect);
+        }
+        else {
+            auto drawIndexed = DrawIndexedCommand();
+            drawIndexed.topology = draw.topology;
+            drawIndexed.indexType = draw.indexType;
+            drawIndexed.indexCount = draw.indexCount;
+            drawIndexed.indexOffset = draw.indexOffset;
+            drawIndexed.baseVertex = draw.baseVertex;
+            commands.drawIndexed(drawIndexed);
+        }
+
+        previous = &draw;
+    }
+}
+
+std::size_t RenderQueue::record(std::vector<CommandBuffer>& buffers,
+        const std::size_t drawsPerBuffer, JobSystem* const jobs,
+        FrameArenas* const arenas) const noexcept {
+    const auto step = std::max<std::size_t>(drawsPerBuffer, 1u);
+    const auto bufferCount = (entries.size() + step - 1u)/step;
+
+    // Never shrink, the buffers keep their storage across frames
+    if (buffers.size() < bufferCount) {
+        buffers.resize(bufferCount);
+    }
+
+    const auto recordBuffers = [this, &buffers, step, arenas](
+            const std::size_t first, const std::size_t last) {
+        for (auto buffer = first; buffer < last; ++buffer) {
+            const auto begin = buffer*step;
+            const auto end = std::min(entries.size(), begin + step);
+            auto& commands = buffers[buffer];
+            if (arenas) {
+                commands.clear(arenas->local());
+            }
+            else {
+                commands.clear();
+            }
+            commands.reserve((end - begin)*bytesPerDrawEstimate);
+            record(commands, begin, end);
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(bufferCount, 1u, recordBuffers);
+    }
+    else {
+        recordBuffers(0u, bufferCount);
+    }
+    return bufferCount;
+}
+
+void RenderQueue::flush(GLStateCache& stateCache) noexcept {
+    commands.clear();
+    record(commands, 0u, entries.size());
+    replay(commands, stateCache);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "commandbuffer.hpp"
+#include "framearena.hpp"
+#include "glstatecache.hpp"
+#include "jobsystem.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr auto maxDrawTextures = 4;
+
+struct DrawCommand {
+    std::uint32_t pass = 0u;
+    GLuint program = 0u;
+    std::uint32_t material = 0u;
+    GLuint textures[maxDrawTextures] = {}; // Unit i gets textures[i]
+    GLuint vao = 0u;
+
+    PrimitiveTopology topology = PrimitiveTopology::Triangles;
+    IndexType indexType = IndexType::Uint32;
+    std::uint32_t indexCount = 0u;
+    std::uint32_t indexOffset = 0u; // In bytes
+    std::int32_t baseVertex = 0;
+
+    // Set for multi-draws, which read indirectDrawCount draws' arguments at
+    // indirectOffset instead of using the range above
+    std::uint32_t indirectDrawCount = 0u;
+    std::uint32_t indirectOffset = 0u; // In bytes, see replay()
+
+    float depth = 0.f; // 0 - near, 1 - far, invert for back to front passes
+
+    GLint materialLocation = -1; // Receives material when set
+    GLint modelMatrixLocation = -1;
+    glm::mat4 modelMatrix = glm::mat4(1.f);
+};
+
+// Draws are sorted by a packed key, most significant first:
+// pass (4 bits) | program (12) | material (16) | vao (12) | depth (20)
+
+std::uint64_t makeSortKey(const DrawCommand& draw) noexcept;
+
+class RenderQueue {
+public:
+    void clear() noexcept;
+    void submit(const DrawCommand& draw) noexcept;
+
+    // LSD radix sort of the keys, 8 bits per pass
+    void sort() noexcept;
+
+    // Records the sorted draws [begin, end) without touching GL. Binds are
+    // only recorded when they differ from the previous draw of the range,
+    // so ranges can be recorded on any thread, in any order
+    void record(CommandBuffer& commands, const std::size_t begin,
+            const std::size_t end) const noexcept;
+
+    // Records drawsPerBuffer draws per buffer, in parallel when jobs are
+    // given. Returns how many buffers were filled, replaying them in
+    // order draws the queue in key order. With arenas the buffers live in
+    // the recording threads' frame arenas and are valid until the slot is
+    // reset
+    std::size_t record(std::vector<CommandBuffer>& buffers,
+            const std::size_t drawsPerBuffer, JobSystem* const jobs = nullptr,
+            FrameArenas* const arenas = nullptr) const noexcept;
+
+    // Records and replays the draws on the calling thread, the cache drops
+    // the binds that did not change between ranges
+    void flush(GLStateCache& stateCache) noexcept;
+
+    std::size_t size() const noexcept { return draws.size(); }
+
+private:
+    struct SortEntry {
+        std::uint64_t key;
+        std::uint32_t draw;
+    };
+
+    std::vector<DrawCommand> draws;
+    std::vector<SortEntry> entries;
+    std::vector<SortEntry> scratch;
+    CommandBuffer commands;
+};
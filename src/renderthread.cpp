@@ -0,0 +1,103 @@
+#include "renderthread.hpp"
+
+// Tries before a waiter parks, a frame or command usually follows soon
+constexpr auto waitSpins = 64;
+
+void RenderThread::Semaphore::post() noexcept {
+    if (count.fetch_add(1, std::memory_order_release) >= 0) {
+        return;
+    }
+    {
+        const auto lock = std::lock_guard<std::mutex>(mutex);
+        ++wakeups;
+    }
+    condition.notify_one();
+}
+
+void RenderThread::Semaphore::wait() noexcept {
+    for (auto spin = 0; spin < waitSpins; ++spin) {
+        auto available = count.load(std::memory_order_relaxed);
+        while (available > 0) {
+            if (count.compare_exchange_weak(available, available - 1,
+                    std::memory_order_acquire, std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        std::this_thread::yield();
+    }
+
+    // Taking past zero registers the waiter, the post that brings the
+    // count back wakes it
+    if (count.fetch_sub(1, std::memory_order_acquire) > 0) {
+        return;
+    }
+    auto lock = std::unique_lock<std::mutex>(mutex);
+    condition.wait(lock, [this] { return wakeups > 0; });
+    --wakeups;
+}
+
+RenderThread::~RenderThread() noexcept {
+    stop();
+}
+
+void RenderThread::start(GLFWwindow* const renderWindow,
+        RenderFunction renderFunction) noexcept {
+    window = renderWindow;
+    render = std::move(renderFunction);
+    thread = std::thread(&RenderThread::renderMain, this);
+}
+
+int RenderThread::beginFrame() noexcept {
+    freeSlots.wait();
+    const auto slot = nextSlot;
+    nextSlot = (nextSlot + 1)%frameSlots;
+    return slot;
+}
+
+void RenderThread::endFrame(const int slot) noexcept {
+    post(RenderCommand{ RenderCommand::Type::Frame, slot, 0, 0 });
+}
+
+void RenderThread::resize(const int width, const int height) noexcept {
+    post(RenderCommand{ RenderCommand::Type::Resize, 0, width, height });
+}
+
+void RenderThread::stop() noexcept {
+    if (!thread.joinable()) {
+        return;
+    }
+    post(RenderCommand{ RenderCommand::Type::Stop, 0, 0, 0 });
+    thread.join();
+}
+
+void RenderThread::post(const RenderCommand& command) noexcept {
+    // Only full if the render thread is far behind, which beginFrame()
+    // already prevents for frames
+    while (!commands.push(command)) {
+        std::this_thread::yield();
+    }
+    queued.post();
+}
+
+void RenderThread::renderMain() noexcept {
+    glfwMakeContextCurrent(window);
+
+    while (true) {
+        queued.wait();
+        auto command = RenderCommand();
+        commands.pop(command);
+
+        switch (command.type) {
+        case RenderCommand::Type::Frame:
+            render(command.slot);
+            freeSlots.post();
+            break;
+        case RenderCommand::Type::Resize:
+            glViewport(0, 0, command.width, command.height);
+            break;
+        case RenderCommand::Type::Stop:
+            glfwMakeContextCurrent(nullptr);
+            return;
+        }
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "spscqueue.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct RenderCommand {
+    enum class Type {
+        Frame,
+        Resize,
+        Stop
+    };
+
+    Type type;
+    int slot;
+    int width;
+    int height;
+};
+
+// Owns the GL context on a thread of its own. The main thread polls
+// events, simulates and fills one of two frame data slots, the render
+// thread draws the other one, so frame N+1 is built while frame N is drawn.
+// Frame data lives with the caller, RenderThread only hands out slots
+
+class RenderThread {
+public:
+    static constexpr auto frameSlots = 2;
+
+    using RenderFunction = std::function<void(const int slot)>;
+
+    RenderThread() noexcept = default;
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+    ~RenderThread() noexcept;
+
+    // The context must not be current on the calling thread
+    void start(GLFWwindow* const window, RenderFunction render) noexcept;
+
+    // Waits until the render thread is done with the slot
+    int beginFrame() noexcept;
+    void endFrame(const int slot) noexcept;
+
+    void resize(const int width, const int height) noexcept;
+
+    // Draws the submitted frames, then releases the context
+    void stop() noexcept;
+
+    bool running() const noexcept { return thread.joinable(); }
+
+private:
+    // Counts queued commands or free slots, used only to sleep and wake,
+    // the data itself goes through the lock-free queue. Posting and taking
+    // are atomics, the mutex is only touched when a waiter parks because
+    // the count ran out, or to wake it
+    class Semaphore {
+    public:
+        explicit Semaphore(const int count) noexcept : count(count) {}
+        void post() noexcept;
+        void wait() noexcept;
+
+    private:
+        std::atomic<int> count; // Negative - that many waiters parked
+        std::mutex mutex;
+        std::condition_variable condition;
+        int wakeups = 0;
+    };
+
+    void post(const RenderCommand& command) noexcept;
+    void renderMain() noexcept;
+
+    GLFWwindow* window = nullptr;
+    RenderFunction render;
+    std::thread thread;
+    SpscQueue<RenderCommand, 64> commands;
+    Semaphore queued{0};
+    Semaphore freeSlots{frameSlots};
+    int nextSlot = 0;
+};
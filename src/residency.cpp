@@ -0,0 +1,240 @@
+#include "residency.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+constexpr auto invalidId = UINT32_MAX;
+
+TextureResidency::TextureResidency(const std::size_t budgetBytes) noexcept {
+    residencyStats.budgetBytes = budgetBytes;
+}
+
+TextureResidency::~TextureResidency() noexcept {
+    destroy();
+}
+
+std::uint32_t TextureResidency::add(MipChain mips) noexcept {
+    if (mips.empty()) {
+        std::cout << "Streamed texture has no mips\n";
+        return invalidId;
+    }
+
+    auto streamed = StreamedTexture();
+    streamed.mips = std::move(mips);
+
+    // Low mips first, the rest is streamed on request
+
+    streamed.tailMip = static_cast<int>(streamed.mips.size()) - 1;
+    while (streamed.tailMip > 0 && std::max(
+            streamed.mips[streamed.tailMip - 1].width,
+            streamed.mips[streamed.tailMip - 1].height) <= tailSize) {
+        --streamed.tailMip;
+    }
+    streamed.wantedMip = streamed.tailMip;
+    streamed.lastUsed = frame;
+    makeResident(streamed, streamed.tailMip);
+
+    textures.push_back(std::move(streamed));
+    return static_cast<std::uint32_t>(textures.size() - 1);
+}
+
+void TextureResidency::destroy() noexcept {
+    for (const auto& streamed : textures) {
+        glDeleteTextures(1, &streamed.texture);
+    }
+    for (const auto& old : retired) {
+        glDeleteTextures(1, &old.texture);
+    }
+    textures.clear();
+    retired.clear();
+    residencyStats.residentBytes = 0;
+    residencyStats.retiredBytes = 0;
+}
+
+void TextureResidency::request(const std::uint32_t id,
+        const float screenSize) noexcept {
+    auto& streamed = textures[id];
+    const auto& base = streamed.mips.front();
+    const auto ratio = float(std::max(base.width, base.height))/
+            std::max(screenSize, 1.f);
+    const auto mip = std::min(static_cast<int>(std::max(
+            std::floor(std::log2(ratio)), 0.f)), streamed.tailMip);
+    streamed.wantedMip = std::min(streamed.wantedMip, mip);
+    streamed.lastUsed = frame;
+}
+
+void TextureResidency::setBudget(const std::size_t budgetBytes) noexcept {
+    residencyStats.budgetBytes = budgetBytes;
+}
+
+void TextureResidency::update(GLStateCache& stateCache) noexcept {
+    // Textures replaced long enough ago that no frame uses them
+
+    const auto done = std::partition(retired.begin(), retired.end(),
+            [this](const RetiredTexture& old) {
+        return frame - old.frame < retireFrames;
+    });
+    for (auto old = done; old != retired.end(); ++old) {
+        stateCache.forgetTexture(old->texture);
+        glDeleteTextures(1, &old->texture);
+        residencyStats.retiredBytes -= old->bytes;
+    }
+    retired.erase(done, retired.end());
+
+    // Finer mips for the textures used this frame, largest deficit first,
+    // one level per texture per frame so uploads stay small
+
+    auto wanting = std::vector<std::uint32_t>();
+    for (auto id = std::uint32_t(0); id < textures.size(); ++id) {
+        const auto& streamed = textures[id];
+        if (streamed.lastUsed == frame &&
+                streamed.wantedMip < streamed.residentMip) {
+            wanting.push_back(id);
+        }
+    }
+    std::sort(wanting.begin(), wanting.end(),
+            [this](const std::uint32_t a, const std::uint32_t b) {
+        return textures[a].residentMip - textures[a].wantedMip >
+                textures[b].residentMip - textures[b].wantedMip;
+    });
+
+    auto uploads = 0u;
+    for (const auto id : wanting) {
+        if (uploads == maxUploadsPerFrame) {
+            break;
+        }
+        auto& streamed = textures[id];
+        const auto mip = streamed.residentMip - 1;
+        const auto bytes = residentBytes(streamed, mip);
+        const auto needed = bytes - streamed.bytes;
+        auto fits = true;
+        while (residencyStats.residentBytes + needed >
+                residencyStats.budgetBytes) {
+            if (!evict()) {
+                fits = false;
+                break;
+            }
+        }
+
+        // The old texture lives on next to the new one for a few frames,
+        // so does every texture retired before. Later frames retry
+        if (!fits || residencyStats.residentBytes +
+                residencyStats.retiredBytes + bytes >
+                residencyStats.budgetBytes) {
+            break;
+        }
+        makeResident(streamed, mip);
+        ++uploads;
+    }
+
+    // A lowered budget is honoured even without new requests
+
+    while (residencyStats.residentBytes > residencyStats.budgetBytes &&
+            evict()) {
+    }
+
+    for (auto& streamed : textures) {
+        streamed.wantedMip = streamed.tailMip;
+    }
+    ++frame;
+}
+
+// Drops the finest mip of the least recently used texture that has one to
+// spare. Textures used this frame only give up mips finer than they need
+
+bool TextureResidency::evict() noexcept {
+    auto victim = static_cast<StreamedTexture*>(nullptr);
+    for (auto& streamed : textures) {
+        if (streamed.residentMip >= streamed.tailMip) {
+            continue;
+        }
+        if (streamed.lastUsed == frame &&
+                streamed.residentMip >= streamed.wantedMip) {
+            continue;
+        }
+        if (!victim || streamed.lastUsed < victim->lastUsed) {
+            victim = &streamed;
+        }
+    }
+    if (!victim) {
+        return false;
+    }
+
+    const auto before = victim->bytes;
+    makeResident(*victim, victim->residentMip + 1);
+    residencyStats.evictedBytes += before - victim->bytes;
+    return true;
+}
+
+std::size_t TextureResidency::residentBytes(const StreamedTexture& streamed,
+        const int mip) const noexcept {
+    auto bytes = std::size_t(0);
+    for (auto level = std::size_t(mip); level < streamed.mips.size();
+            ++level) {
+        bytes += streamed.mips[level].pixels.size();
+    }
+    return bytes;
+}
+
+// Immutable storage can't grow or shrink, so the resident mips are moved
+// into a new texture on the GPU and only the missing ones are uploaded
+
+void TextureResidency::makeResident(StreamedTexture& streamed,
+        const int mip) noexcept {
+    const auto levels = static_cast<int>(streamed.mips.size());
+    const auto oldTexture = streamed.texture;
+    const auto oldMip = streamed.residentMip;
+
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER,
+            GL_LINEAR_MIPMAP_LINEAR);
+    glTextureStorage2D(texture, levels - mip, GL_RGBA8,
+            streamed.mips[mip].width, streamed.mips[mip].height);
+
+    for (auto level = mip; level < levels; ++level) {
+        const auto& source = streamed.mips[level];
+        if (oldTexture != 0u && level >= oldMip) {
+            glCopyImageSubData(oldTexture, GL_TEXTURE_2D, level - oldMip,
+                    0, 0, 0, texture, GL_TEXTURE_2D, level - mip, 0, 0, 0,
+                    source.width, source.height, 1);
+        }
+        else {
+            glTextureSubImage2D(texture, level - mip, 0, 0,
+                    source.width, source.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    source.pixels.data());
+            residencyStats.uploadedBytes += source.pixels.size();
+        }
+    }
+
+    if (oldTexture != 0u) {
+        retired.push_back(RetiredTexture{ oldTexture, streamed.bytes,
+                frame });
+        residencyStats.retiredBytes += streamed.bytes;
+        ++residencyStats.reallocations;
+    }
+
+    const auto bytes = residentBytes(streamed, mip);
+    residencyStats.residentBytes += bytes;
+    residencyStats.residentBytes -= streamed.bytes;
+    streamed.texture = texture;
+    streamed.residentMip = mip;
+    streamed.bytes = bytes;
+}
+
+GLuint TextureResidency::texture(const std::uint32_t id) const noexcept {
+    return textures[id].texture;
+}
+
+int TextureResidency::residentMip(const std::uint32_t id) const noexcept {
+    return textures[id].residentMip;
+}
+
+std::size_t TextureResidency::textureBytes(
+        const std::uint32_t id) const noexcept {
+    return textures[id].bytes;
+}
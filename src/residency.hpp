@@ -0,0 +1,92 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "glstatecache.hpp"
+#include "mipgen.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ResidencyStats {
+    std::size_t residentBytes = 0;
+    std::size_t retiredBytes = 0; // Replaced, not deleted yet
+    std::size_t budgetBytes = 0;
+    std::size_t uploadedBytes = 0;
+    std::size_t evictedBytes = 0;
+    std::size_t reallocations = 0;
+};
+
+// Keeps the texture memory of streamed textures within a byte budget.
+// Mip chains are generated once, e.g. on a worker, and kept in system
+// memory, only the mips up to tailSize are uploaded at first. Every frame
+// the renderer reports how large each texture is on screen, update() then
+// streams in finer mips for textures that need them and, when over
+// budget, drops the finest mips of the least recently used textures.
+//
+// Resident mips live in an immutable texture whose level 0 is the finest
+// resident mip, so changing residency reallocates it. Query texture()
+// after update(), the GL name changes. Replaced textures are deleted
+// retireFrames updates later, frames in flight may still sample them.
+// Until then their bytes count against the budget, an upload needs room
+// for its new texture next to the old one
+
+class TextureResidency {
+public:
+    static constexpr auto tailSize = 64;
+    static constexpr auto maxUploadsPerFrame = 4u;
+    static constexpr auto retireFrames = 3u;
+
+    explicit TextureResidency(const std::size_t budgetBytes =
+            std::size_t(256) << 20) noexcept;
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+    ~TextureResidency() noexcept;
+
+    // Returns the texture id, or UINT32_MAX for an empty chain
+    std::uint32_t add(MipChain mips) noexcept;
+
+    // Deletes the textures without the state cache, invalidate it after
+    void destroy() noexcept;
+
+    // screenSize is the larger on-screen extent in pixels of the surface
+    // using the texture, the mip needed is the one closest to it
+    void request(const std::uint32_t id, const float screenSize) noexcept;
+
+    void update(GLStateCache& stateCache) noexcept;
+
+    void setBudget(const std::size_t budgetBytes) noexcept;
+
+    GLuint texture(const std::uint32_t id) const noexcept;
+    int residentMip(const std::uint32_t id) const noexcept;
+    std::size_t textureBytes(const std::uint32_t id) const noexcept;
+    const ResidencyStats& stats() const noexcept { return residencyStats; }
+
+private:
+    struct StreamedTexture {
+        MipChain mips;
+        GLuint texture = 0u;
+        int residentMip = 0; // Finest resident mip
+        int tailMip = 0; // This and coarser mips are never evicted
+        int wantedMip = 0;
+        std::uint64_t lastUsed = 0;
+        std::size_t bytes = 0;
+    };
+
+    struct RetiredTexture {
+        GLuint texture;
+        std::size_t bytes;
+        std::uint64_t frame;
+    };
+
+    void makeResident(StreamedTexture& streamed, const int mip) noexcept;
+    bool evict() noexcept;
+    std::size_t residentBytes(const StreamedTexture& streamed,
+            const int mip) const noexcept;
+
+    std::vector<StreamedTexture> textures;
+    std::vector<RetiredTexture> retired;
+    std::uint64_t frame = 0;
+    ResidencyStats residencyStats;
+};
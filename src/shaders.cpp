@@ -0,0 +1,144 @@
+#include "shaders.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+
+static auto readAll(const char* const fileName) noexcept {
+    auto file = std::ifstream(fileName);
+    file.seekg(0, std::ios::end);
+    auto buffer = std::string(static_cast<size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    buffer.assign((std::istreambuf_iterator<char>(file)),
+            std::istreambuf_iterator<char>());
+    return buffer;
+}
+
+// Defines go right after the #version line, which must stay first
+
+static auto insertDefines(std::string& source,
+        const char* const defines) noexcept {
+    if (!defines) {
+        return;
+    }
+    const auto version = source.find("#version");
+    const auto lineEnd = version == std::string::npos ?
+            std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos) {
+        source.insert(0, defines);
+        return;
+    }
+    source.insert(lineEnd + 1, defines);
+}
+
+static auto compileShader(const int shaderFlag,
+        const char* const srcName, const char* const defines) noexcept {
+    const auto shaderId = glCreateShader(shaderFlag);
+    auto fileContent = readAll(srcName);
+    insertDefines(fileContent, defines);
+    const GLchar* shadersSrcs[] = { fileContent.data() };
+    glShaderSource(shaderId, 1, shadersSrcs, nullptr);
+    glCompileShader(shaderId);
+    return shaderId;
+}
+
+static auto showShaderCompileError(const GLint shaderId) noexcept {
+    const auto bufferSize = 512;
+    char buffer[bufferSize];
+    glGetShaderInfoLog(shaderId,
+            bufferSize, nullptr, buffer);
+    std::cout << "Shader compiling error! Log:\n" <<
+            buffer << std::endl;
+}
+
+static auto loadShader(const int shaderFlag,
+        const char* const srcName, const char* const defines) noexcept {
+    const auto shaderId = compileShader(shaderFlag, srcName, defines);
+    GLint success;
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        showShaderCompileError(shaderId);
+        return static_cast<decltype(shaderId)>(-1);
+    }
+    return shaderId;
+}
+
+static auto showProgramLinkError(const GLint programId) noexcept {
+    const auto bufferSize = 512;
+    char buffer[bufferSize];
+    glGetProgramInfoLog(programId,
+            bufferSize, nullptr, buffer);
+    std::cout << "Program linking error! Log:\n" <<
+            buffer << std::endl;
+}
+
+using RType = std::result_of_t<decltype(glCreateProgram)()>;
+
+GLuint loadShaders(const char* const vertexSrcName,
+        const char* const fragmentSrcName,
+        const char* const defines) noexcept {
+    // Load
+
+    const auto vertexShaderId = loadShader(
+            GL_VERTEX_SHADER, vertexSrcName, defines);
+    if (vertexShaderId == -1) {
+        return static_cast<RType>(-1);
+    }
+    const auto fragmentShaderId = loadShader(
+            GL_FRAGMENT_SHADER, fragmentSrcName, defines);
+    if (fragmentShaderId == -1) {
+        glDeleteShader(vertexShaderId);
+        return static_cast<RType>(-1);
+    }
+
+    // Program
+
+    const auto programId = glCreateProgram();
+    glAttachShader(programId, vertexShaderId);
+    glAttachShader(programId, fragmentShaderId);
+
+    glLinkProgram(programId);
+    
+    GLint success;
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    if (!success) {
+        showProgramLinkError(programId);
+    }
+
+    // Exit
+
+    glDeleteShader(vertexShaderId);
+    glDeleteShader(fragmentShaderId);
+    return programId;
+}
+
+GLuint loadComputeShaders(const char* const computeSrcName,
+        const char* const defines) noexcept {
+    // Load
+
+    const auto computeShaderId = loadShader(
+            GL_COMPUTE_SHADER, computeSrcName, defines);
+    if (computeShaderId == static_cast<GLuint>(-1)) {
+        return static_cast<RType>(-1);
+    }
+
+    // Program
+
+    const auto programId = glCreateProgram();
+    glAttachShader(programId, computeShaderId);
+
+    glLinkProgram(programId);
+
+    GLint success;
+    glGetProgramiv(programId, GL_LINK_STATUS, &success);
+    if (!success) {
+        showProgramLinkError(programId);
+    }
+
+    // Exit
+
+    glDeleteShader(computeShaderId);
+    return programId;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <GL/glew.h>
+
+// Both return the linked program id or -1 if a stage failed to compile.
+// defines are "#define NAME\n" lines inserted after #version
+
+GLuint loadShaders(const char* const vertexSrcName,
+        const char* const fragmentSrcName,
+        const char* const defines = nullptr) noexcept;
+
+GLuint loadComputeShaders(const char* const computeSrcName,
+        const char* const defines = nullptr) noexcept;
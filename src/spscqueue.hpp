@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Each side keeps a private copy of the other side's index and only reads
+// the shared one when the copy says the queue is full or empty
+
+template <typename T, std::size_t capacity>
+class SpscQueue {
+    static_assert((capacity & (capacity - 1)) == 0,
+            "capacity must be a power of two");
+
+public:
+    // Producer, false when full
+    bool push(const T& item) noexcept {
+        const auto position = tail.load(std::memory_order_relaxed);
+        if (position - cachedHead == capacity) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (position - cachedHead == capacity) {
+                return false;
+            }
+        }
+        items[position & (capacity - 1)] = item;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer, false when empty
+    bool pop(T& item) noexcept {
+        const auto position = head.load(std::memory_order_relaxed);
+        if (position == cachedTail) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position == cachedTail) {
+                return false;
+            }
+        }
+        item = items[position & (capacity - 1)];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // Producer and consumer state on separate cache lines
+    alignas(64) std::atomic<std::size_t> tail{0};
+    std::size_t cachedHead = 0;
+    alignas(64) std::atomic<std::size_t> head{0};
+    std::size_t cachedTail = 0;
+    alignas(64) T items[capacity];
+};
@@ -0,0 +1,123 @@
+#include "streambuffer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+StreamBuffer::~StreamBuffer() noexcept {
+    destroy();
+}
+
+bool StreamBuffer::create(const std::uint32_t bytesPerFrame) noexcept {
+    destroy();
+
+    auto alignment = GLint(0);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformAlignment = static_cast<std::uint32_t>(std::max(alignment, 16));
+
+    // Regions start aligned for any use
+    regionSize = (bytesPerFrame + uniformAlignment - 1u)/uniformAlignment*
+            uniformAlignment;
+    const auto size = GLsizeiptr(regionSize)*frameCount;
+    const auto flags = GLbitfield(GL_MAP_WRITE_BIT |
+            GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+    glCreateBuffers(1, &streamBuffer);
+    glNamedBufferStorage(streamBuffer, size, nullptr, flags);
+    mapping = static_cast<unsigned char*>(
+            glMapNamedBufferRange(streamBuffer, 0, size, flags));
+    if (!mapping) {
+        std::cout << "Stream buffer mapping failed\n";
+        destroy();
+        return false;
+    }
+
+    region = 0u;
+    head = 0u;
+    streamStats = StreamBufferStats();
+    return true;
+}
+
+void StreamBuffer::destroy() noexcept {
+    if (streamBuffer == 0u) {
+        return;
+    }
+    for (auto& fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    if (mapping) {
+        glUnmapNamedBuffer(streamBuffer);
+        mapping = nullptr;
+    }
+    glDeleteBuffers(1, &streamBuffer);
+    streamBuffer = 0u;
+}
+
+void StreamBuffer::beginFrame() noexcept {
+    region = (region + 1u)%frameCount;
+    head = 0u;
+    streamStats.bytesThisFrame = 0u;
+
+    auto& fence = fences[region];
+    if (!fence) {
+        return;
+    }
+
+    // Poll first so the common case costs no flush
+    auto status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+        const auto start = std::chrono::steady_clock::now();
+        do {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                    GLuint64(1000000));
+        } while (status == GL_TIMEOUT_EXPIRED);
+
+        const auto waited = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - start);
+        ++streamStats.stalls;
+        streamStats.stallMilliseconds += waited.count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void StreamBuffer::endFrame() noexcept {
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++streamStats.frames;
+}
+
+StreamAllocation StreamBuffer::allocate(const std::uint32_t size,
+        std::uint32_t alignment) noexcept {
+    if (alignment == 0u) {
+        alignment = uniformAlignment;
+    }
+    // Aligned in the buffer, not just in the region, for vertex strides
+    const auto regionStart = std::uint64_t(region)*regionSize;
+    const auto bufferOffset = (regionStart + head + alignment - 1u)/
+            alignment*alignment;
+    if (!mapping || bufferOffset + size > regionStart + regionSize) {
+        ++streamStats.failedAllocations;
+        return StreamAllocation();
+    }
+    head = static_cast<std::uint32_t>(bufferOffset + size - regionStart);
+    streamStats.bytesThisFrame = head;
+    streamStats.peakBytesPerFrame = std::max(streamStats.peakBytesPerFrame,
+            streamStats.bytesThisFrame);
+
+    return StreamAllocation{ mapping + bufferOffset, streamBuffer,
+            static_cast<std::uint32_t>(bufferOffset) };
+}
+
+std::uint32_t StreamBuffer::write(const void* const data,
+        const std::uint32_t size, const std::uint32_t alignment) noexcept {
+    const auto allocation = allocate(size, alignment);
+    if (!allocation.data) {
+        return UINT32_MAX;
+    }
+    std::memcpy(allocation.data, data, size);
+    return allocation.offset;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdint>
+
+struct StreamBufferStats {
+    std::size_t frames = 0u;
+    std::size_t stalls = 0u;        // beginFrame() had to wait for the GPU
+    double stallMilliseconds = 0.;
+    std::size_t failedAllocations = 0u;
+    std::size_t bytesThisFrame = 0u;
+    std::size_t peakBytesPerFrame = 0u;
+};
+
+// Where to write streamed data, data is coherent with buffer at offset
+struct StreamAllocation {
+    void* data = nullptr; // nullptr - the frame's region is full
+    GLuint buffer = 0u;
+    std::uint32_t offset = 0u;
+};
+
+// Persistently mapped buffer split into one region per frame in flight for
+// per-frame uniforms, instance data and streamed vertices. Writes go
+// straight to the mapping, nothing orphans or syncs. A fence marks the end
+// of each frame's use, beginFrame() only waits when the GPU is still
+// reading the region from frameCount frames ago. Context thread only
+
+class StreamBuffer {
+public:
+    static constexpr auto frameCount = 3u;
+
+    StreamBuffer() noexcept = default;
+    StreamBuffer(const StreamBuffer&) = delete;
+    StreamBuffer& operator=(const StreamBuffer&) = delete;
+    ~StreamBuffer() noexcept;
+
+    bool create(const std::uint32_t bytesPerFrame) noexcept;
+    void destroy() noexcept;
+
+    void beginFrame() noexcept;
+    void endFrame() noexcept;
+
+    // Valid until the end of the frame. Alignment of 0 uses the uniform
+    // buffer offset alignment, so the range can be bound as a UBO
+    StreamAllocation allocate(const std::uint32_t size,
+            std::uint32_t alignment = 0u) noexcept;
+
+    // Copies data in, returns the offset or UINT32_MAX when full
+    std::uint32_t write(const void* const data, const std::uint32_t size,
+            const std::uint32_t alignment = 0u) noexcept;
+
+    GLuint buffer() const noexcept { return streamBuffer; }
+    const StreamBufferStats& stats() const noexcept { return streamStats; }
+
+private:
+    GLuint streamBuffer = 0u;
+    unsigned char* mapping = nullptr;
+    GLsync fences[frameCount] = {};
+    std::uint32_t regionSize = 0u;
+    std::uint32_t uniformAlignment = 256u;
+    std::uint32_t region = 0u;
+    std::uint32_t head = 0u; // Offset into the current region
+    StreamBufferStats streamStats;
+};
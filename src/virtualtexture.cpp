@@ -0,0 +1,607 @@
+#include "virtualtexture.hpp"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "mipgen.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+constexpr auto fileVersion = 1u;
+constexpr auto maxUploadsPerFrame = 16u;
+
+static auto divideUp(const int value, const int divisor) noexcept {
+    return (value + divisor - 1)/divisor;
+}
+
+static auto lowestBit(const std::uint32_t value) noexcept {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<std::uint32_t>(index);
+#else
+    return static_cast<std::uint32_t>(__builtin_ctz(value));
+#endif
+}
+
+static auto mipSize(const std::uint32_t size, const int mip) noexcept {
+    return std::max(1, static_cast<int>(size >> mip));
+}
+
+// Writer
+
+bool writeVirtualTexture(const char* const fileName,
+        const unsigned char* const rgba, const int width, const int height,
+        const int tileSize, const int border) noexcept {
+    // Down to the mip that fits into one tile
+
+    auto options = MipOptions();
+    options.srgb = true;
+    auto levels = generateMips(rgba, width, height, options);
+    auto mipCount = std::size_t(1);
+    while (mipCount < levels.size() &&
+            mipCount < std::size_t(VirtualTexture::maxMips) &&
+            std::max(levels[mipCount - 1].width,
+            levels[mipCount - 1].height) > tileSize) {
+        ++mipCount;
+    }
+    levels.resize(mipCount);
+
+    const auto file = std::fopen(fileName, "wb");
+    if (!file) {
+        std::cout << "Virtual texture \"" << fileName << "\" can't be written\n";
+        return false;
+    }
+
+    auto header = VirtualTextureHeader();
+    std::memcpy(header.magic, "VTEX", 4);
+    header.version = fileVersion;
+    header.width = static_cast<std::uint32_t>(width);
+    header.height = static_cast<std::uint32_t>(height);
+    header.tileSize = static_cast<std::uint32_t>(tileSize);
+    header.border = static_cast<std::uint32_t>(border);
+    header.mipCount = static_cast<std::uint32_t>(levels.size());
+    std::fwrite(&header, sizeof(header), 1, file);
+
+    const auto padded = tileSize + 2*border;
+    auto tile = std::vector<unsigned char>(
+            static_cast<std::size_t>(padded)*padded*4u);
+    for (auto mip = 0; mip < static_cast<int>(levels.size()); ++mip) {
+        const auto& level = levels[mip].pixels;
+        const auto w = mipSize(header.width, mip);
+        const auto h = mipSize(header.height, mip);
+        for (auto tileY = 0; tileY < divideUp(h, tileSize); ++tileY) {
+            for (auto tileX = 0; tileX < divideUp(w, tileSize); ++tileX) {
+                auto out = tile.data();
+                for (auto y = 0; y < padded; ++y) {
+                    const auto sy = std::min(std::max(
+                            tileY*tileSize + y - border, 0), h - 1);
+                    for (auto x = 0; x < padded; ++x) {
+                        const auto sx = std::min(std::max(
+                                tileX*tileSize + x - border, 0), w - 1);
+                        std::memcpy(out, level.data() +
+                                (static_cast<std::size_t>(sy)*w + sx)*4u, 4u);
+                        out += 4;
+                    }
+                }
+                std::fwrite(tile.data(), tile.size(), 1, file);
+            }
+        }
+    }
+
+    const auto written = std::ferror(file) == 0;
+    std::fclose(file);
+    return written;
+}
+
+// Lifetime
+
+VirtualTexture::~VirtualTexture() noexcept {
+    destroy();
+}
+
+bool VirtualTexture::create(const char* const fileName,
+        const int budgetTiles, GLStateCache& stateCache) noexcept {
+    destroy();
+
+    file = std::fopen(fileName, "rb");
+    if (!file) {
+        std::cout << "Virtual texture \"" << fileName << "\" not found\n";
+        return false;
+    }
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+            std::memcmp(header.magic, "VTEX", 4) != 0 ||
+            header.version != fileVersion || header.mipCount == 0u ||
+            header.mipCount > std::uint32_t(maxMips)) {
+        std::cout << "Virtual texture \"" << fileName << "\" is invalid\n";
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    // Layout
+
+    const auto tileSize = static_cast<int>(header.tileSize);
+    const auto mipCount = static_cast<int>(header.mipCount);
+    tileCount = 0u;
+    for (auto mip = 0; mip < mipCount; ++mip) {
+        mipOffsets[mip] = static_cast<int>(tileCount);
+        mipTilesX[mip] = divideUp(mipSize(header.width, mip), tileSize);
+        mipTilesY[mip] = divideUp(mipSize(header.height, mip), tileSize);
+        tileCount += static_cast<std::uint32_t>(mipTilesX[mip]*mipTilesY[mip]);
+    }
+    paddedTile = tileSize + 2*static_cast<int>(header.border);
+    tileBytes = static_cast<std::size_t>(paddedTile)*paddedTile*4u;
+    tiles.assign(tileCount, Tile());
+    pageTable.assign(tileCount, 0u);
+
+    // Sparse textures need the tile size to be the hardware page size
+
+    useSparse = false;
+    if (GLEW_ARB_sparse_texture) {
+        GLint pageX = 0;
+        GLint pageY = 0;
+        glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8,
+                GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageX);
+        glGetInternalformativ(GL_TEXTURE_2D, GL_RGBA8,
+                GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageY);
+        useSparse = pageX == tileSize && pageY == tileSize;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    auto budget = std::max(budgetTiles, 1);
+    if (useSparse) {
+        glTextureParameteri(texture, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER,
+                GL_LINEAR_MIPMAP_LINEAR);
+        glTextureStorage2D(texture, mipCount, GL_RGBA8,
+                static_cast<GLsizei>(header.width),
+                static_cast<GLsizei>(header.height));
+        glGetTextureParameteriv(texture, GL_NUM_SPARSE_LEVELS_ARB,
+                &sparseLevels);
+
+        // The mip tail is committed as a whole and never evicted
+
+        if (sparseLevels < mipCount) {
+            stateCache.bindTextureUnit(textureUnit, GL_TEXTURE_2D, texture);
+            glTexPageCommitmentARB(GL_TEXTURE_2D, sparseLevels, 0, 0, 0,
+                    mipSize(header.width, sparseLevels),
+                    mipSize(header.height, sparseLevels), 1, GL_TRUE);
+        }
+    }
+    else {
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+        const auto maxSlots = maxSize/paddedTile;
+        slotsX = std::min(maxSlots,
+                static_cast<int>(std::ceil(std::sqrt(float(budget)))));
+        slotsY = std::min(maxSlots, divideUp(budget, slotsX));
+        budget = slotsX*slotsY;
+
+        glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTextureStorage2D(texture, 1, GL_RGBA8,
+                slotsX*paddedTile, slotsY*paddedTile);
+    }
+
+    slotTiles.assign(budget, -1);
+    freeSlots.clear();
+    for (auto slot = budget; slot-- > 0;) {
+        freeSlots.push_back(slot);
+    }
+
+    // Page table and feedback bitmaps
+
+    glCreateBuffers(1, &pageTableBuffer);
+    glNamedBufferStorage(pageTableBuffer, tileCount*sizeof(std::uint32_t),
+            nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+    const auto zero = 0u;
+    glCreateBuffers(2, feedbackBuffers);
+    for (const auto buffer : feedbackBuffers) {
+        glNamedBufferStorage(buffer, divideUp(tileCount, 32)*sizeof(GLuint),
+                nullptr, GL_CLIENT_STORAGE_BIT);
+        glClearNamedBufferData(buffer, GL_R32UI, GL_RED_INTEGER,
+                GL_UNSIGNED_INT, &zero);
+    }
+
+    // Loader, the coarsest mip (and the sparse tail) is always resident
+
+    stopping = false;
+    loader = std::thread(&VirtualTexture::loaderMain, this);
+
+    const auto lockedMip = useSparse ? std::min(sparseLevels, mipCount - 1) :
+            mipCount - 1;
+    for (auto tile = std::uint32_t(mipOffsets[lockedMip]);
+            tile < tileCount; ++tile) {
+        tiles[tile].locked = true;
+        request(tile);
+    }
+    pageTableDirty = true;
+    return true;
+}
+
+void VirtualTexture::destroy() noexcept {
+    if (loader.joinable()) {
+        {
+            const auto lock = std::lock_guard<std::mutex>(loaderMutex);
+            stopping = true;
+        }
+        loaderWake.notify_all();
+        loader.join();
+    }
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+    if (texture == 0u) {
+        return;
+    }
+
+    for (auto& fence : feedbackFences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+    }
+    glDeleteBuffers(2, feedbackBuffers);
+    glDeleteBuffers(1, &pageTableBuffer);
+    glDeleteTextures(1, &texture);
+
+    texture = pageTableBuffer = 0u;
+    feedbackBuffers[0] = feedbackBuffers[1] = 0u;
+    tiles.clear();
+    slotTiles.clear();
+    freeSlots.clear();
+    uploadQueue.clear();
+    loadRequests.clear();
+    loadedTiles.clear();
+    vtStats = VirtualTextureStats();
+}
+
+// Loader thread
+
+void VirtualTexture::loaderMain() noexcept {
+    auto lock = std::unique_lock<std::mutex>(loaderMutex);
+    while (true) {
+        loaderWake.wait(lock, [this] {
+            return stopping || !loadRequests.empty();
+        });
+        if (stopping) {
+            return;
+        }
+        const auto tile = loadRequests.front();
+        loadRequests.pop_front();
+        lock.unlock();
+
+        auto loaded = LoadedTile{ tile, std::vector<unsigned char>(tileBytes) };
+        const auto offset = sizeof(VirtualTextureHeader) + tile*tileBytes;
+        const auto read = std::fseek(file, static_cast<long>(offset),
+                SEEK_SET) == 0 &&
+                std::fread(loaded.pixels.data(), tileBytes, 1, file) == 1;
+
+        lock.lock();
+        if (!read) {
+            loaded.pixels.clear();
+        }
+        loadedTiles.push_back(std::move(loaded));
+    }
+}
+
+void VirtualTexture::request(const std::uint32_t tile) noexcept {
+    tiles[tile].pending = true;
+    ++vtStats.pendingTiles;
+    {
+        const auto lock = std::lock_guard<std::mutex>(loaderMutex);
+        loadRequests.push_back(tile);
+    }
+    loaderWake.notify_one();
+}
+
+// Frame
+
+void VirtualTexture::applyUniforms(const GLuint program) const noexcept {
+    const auto location = [program](const char* const name) {
+        return glGetUniformLocation(program, name);
+    };
+    glProgramUniform2f(program, location("vtVirtualSize"),
+            float(header.width), float(header.height));
+    glProgramUniform1f(program, location("vtTileSize"),
+            float(header.tileSize));
+    glProgramUniform1f(program, location("vtBorder"), float(header.border));
+    glProgramUniform2f(program, location("vtPhysicalSize"),
+            float(slotsX*paddedTile), float(slotsY*paddedTile));
+    glProgramUniform1i(program, location("vtMipCount"),
+            static_cast<GLint>(header.mipCount));
+
+    GLint layout[maxMips*4] = {};
+    for (auto mip = 0; mip < static_cast<int>(header.mipCount); ++mip) {
+        layout[mip*4 + 0] = mipOffsets[mip];
+        layout[mip*4 + 1] = mipTilesX[mip];
+        layout[mip*4 + 2] = mipTilesY[mip];
+    }
+    glProgramUniform4iv(program, location("vtMipLayout"), maxMips, layout);
+}
+
+void VirtualTexture::beginFeedback() noexcept {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, feedbackBinding,
+            feedbackBuffers[feedbackIndex]);
+}
+
+void VirtualTexture::endFeedback() noexcept {
+    auto& fence = feedbackFences[feedbackIndex];
+    if (fence) {
+        glDeleteSync(fence);
+    }
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    feedbackIndex ^= 1;
+}
+
+void VirtualTexture::readFeedback() noexcept {
+    // Only the bitmap the GPU is done with, never wait for it
+
+    const auto index = feedbackIndex ^ 1;
+    auto& fence = feedbackFences[index];
+    if (!fence) {
+        return;
+    }
+    const auto status = glClientWaitSync(fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+        return;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+
+    auto bits = std::vector<GLuint>(divideUp(tileCount, 32));
+    glGetNamedBufferSubData(feedbackBuffers[index], 0,
+            bits.size()*sizeof(GLuint), bits.data());
+    const auto zero = 0u;
+    glClearNamedBufferData(feedbackBuffers[index], GL_R32UI,
+            GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+    // Coarse tiles first, they cover more of the screen
+
+    auto missing = std::vector<std::uint32_t>();
+    for (auto word = std::size_t(0); word < bits.size(); ++word) {
+        for (auto used = bits[word]; used != 0u; used &= used - 1u) {
+            const auto tile = static_cast<std::uint32_t>(word*32u +
+                    lowestBit(used));
+            if (tile >= tileCount) {
+                break;
+            }
+            tiles[tile].lastUsed = frame;
+            if (!tiles[tile].resident && !tiles[tile].pending) {
+                missing.push_back(tile);
+            }
+        }
+    }
+    std::sort(missing.rbegin(), missing.rend());
+    for (const auto tile : missing) {
+        request(tile);
+    }
+}
+
+void VirtualTexture::update(GLStateCache& stateCache) noexcept {
+    if (texture == 0u) {
+        return;
+    }
+    ++frame;
+    readFeedback();
+
+    {
+        const auto lock = std::lock_guard<std::mutex>(loaderMutex);
+        for (auto& loaded : loadedTiles) {
+            uploadQueue.push_back(std::move(loaded));
+        }
+        loadedTiles.clear();
+    }
+
+    // Spread uploads over frames so a burst of tiles can't cause a hitch
+
+    for (auto uploads = 0u; uploads < maxUploadsPerFrame &&
+            !uploadQueue.empty(); ++uploads) {
+        upload(uploadQueue.front(), stateCache);
+        uploadQueue.pop_front();
+    }
+
+    if (pageTableDirty) {
+        rebuildPageTable();
+        glNamedBufferSubData(pageTableBuffer, 0,
+                pageTable.size()*sizeof(std::uint32_t), pageTable.data());
+        pageTableDirty = false;
+    }
+}
+
+void VirtualTexture::bind(GLStateCache& stateCache) const noexcept {
+    stateCache.bindTextureUnit(textureUnit, GL_TEXTURE_2D, texture);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, pageTableBinding,
+            pageTableBuffer);
+}
+
+const char* VirtualTexture::shaderDefines() const noexcept {
+    return useSparse ? "#define VT_SPARSE\n" : "#define VT_CACHE\n";
+}
+
+// Residency
+
+void VirtualTexture::tileCoords(const std::uint32_t tile, int& mip, int& x,
+        int& y) const noexcept {
+    mip = static_cast<int>(header.mipCount) - 1;
+    while (mip > 0 && static_cast<int>(tile) < mipOffsets[mip]) {
+        --mip;
+    }
+    const auto local = static_cast<int>(tile) - mipOffsets[mip];
+    x = local%mipTilesX[mip];
+    y = local/mipTilesX[mip];
+}
+
+std::int32_t VirtualTexture::acquireSlot(GLStateCache& stateCache) noexcept {
+    if (!freeSlots.empty()) {
+        const auto slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    }
+
+    // Least recently used tile that the current frames don't need
+
+    auto victim = -1;
+    auto oldest = frame - 1u;
+    for (const auto tile : slotTiles) {
+        if (tile >= 0 && !tiles[tile].locked &&
+                tiles[tile].lastUsed < oldest) {
+            oldest = tiles[tile].lastUsed;
+            victim = tile;
+        }
+    }
+    if (victim < 0) {
+        return -1;
+    }
+    const auto slot = tiles[victim].slot;
+    release(static_cast<std::uint32_t>(victim), stateCache);
+    freeSlots.pop_back();
+    return slot;
+}
+
+void VirtualTexture::release(const std::uint32_t tile,
+        GLStateCache& stateCache) noexcept {
+    auto& state = tiles[tile];
+    if (useSparse) {
+        auto mip = 0;
+        auto x = 0;
+        auto y = 0;
+        tileCoords(tile, mip, x, y);
+        const auto tileSize = static_cast<int>(header.tileSize);
+        stateCache.bindTextureUnit(textureUnit, GL_TEXTURE_2D, texture);
+        glTexPageCommitmentARB(GL_TEXTURE_2D, mip, x*tileSize, y*tileSize, 0,
+                std::min(tileSize, mipSize(header.width, mip) - x*tileSize),
+                std::min(tileSize, mipSize(header.height, mip) - y*tileSize),
+                1, GL_FALSE);
+    }
+    slotTiles[state.slot] = -1;
+    freeSlots.push_back(state.slot);
+    state.slot = -1;
+    state.resident = false;
+    --vtStats.residentTiles;
+    ++vtStats.evictedTiles;
+    pageTableDirty = true;
+}
+
+void VirtualTexture::upload(const LoadedTile& loaded,
+        GLStateCache& stateCache) noexcept {
+    auto& state = tiles[loaded.tile];
+    state.pending = false;
+    --vtStats.pendingTiles;
+    if (loaded.pixels.empty() || state.resident) {
+        return;
+    }
+
+    auto mip = 0;
+    auto x = 0;
+    auto y = 0;
+    tileCoords(loaded.tile, mip, x, y);
+    const auto tileSize = static_cast<int>(header.tileSize);
+    const auto inTail = useSparse && mip >= sparseLevels;
+
+    if (!inTail) {
+        state.slot = acquireSlot(stateCache);
+        if (state.slot < 0) {
+            return;
+        }
+        slotTiles[state.slot] = static_cast<std::int32_t>(loaded.tile);
+    }
+
+    if (useSparse) {
+        // Only the inner texels, the sparse texture filters across pages
+
+        const auto width = std::min(tileSize,
+                mipSize(header.width, mip) - x*tileSize);
+        const auto height = std::min(tileSize,
+                mipSize(header.height, mip) - y*tileSize);
+        if (!inTail) {
+            stateCache.bindTextureUnit(textureUnit, GL_TEXTURE_2D, texture);
+            glTexPageCommitmentARB(GL_TEXTURE_2D, mip, x*tileSize, y*tileSize,
+                    0, width, height, 1, GL_TRUE);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, paddedTile);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, static_cast<GLint>(header.border));
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, static_cast<GLint>(header.border));
+        glTextureSubImage2D(texture, mip, x*tileSize, y*tileSize,
+                width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                loaded.pixels.data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    }
+    else {
+        glTextureSubImage2D(texture, 0, (state.slot%slotsX)*paddedTile,
+                (state.slot/slotsX)*paddedTile, paddedTile, paddedTile,
+                GL_RGBA, GL_UNSIGNED_BYTE, loaded.pixels.data());
+    }
+
+    state.resident = true;
+    state.lastUsed = frame;
+    ++vtStats.residentTiles;
+    ++vtStats.uploadedTiles;
+    pageTableDirty = true;
+}
+
+// Cache: every tile entry points at its own slot or the nearest resident
+// ancestor's (slot x | slot y << 12 | mip << 24).
+// Sparse: every mip 0 tile holds the finest mip from which the tiles
+// covering it are resident all the way down to the tail, trilinear
+// filtering and the shader's clamp never reach an uncommitted page
+
+void VirtualTexture::rebuildPageTable() noexcept {
+    const auto mipCount = static_cast<int>(header.mipCount);
+
+    if (useSparse) {
+        for (auto y = 0; y < mipTilesY[0]; ++y) {
+            for (auto x = 0; x < mipTilesX[0]; ++x) {
+                auto finest = mipCount - 1;
+                for (auto mip = mipCount - 1; mip-- > 0;) {
+                    const auto tileX = std::min(x >> mip, mipTilesX[mip] - 1);
+                    const auto tileY = std::min(y >> mip, mipTilesY[mip] - 1);
+                    if (!tiles[mipOffsets[mip] + tileY*mipTilesX[mip] +
+                            tileX].resident) {
+                        break;
+                    }
+                    finest = mip;
+                }
+                pageTable[y*mipTilesX[0] + x] =
+                        static_cast<std::uint32_t>(finest);
+            }
+        }
+        return;
+    }
+
+    for (auto mip = mipCount; mip-- > 0;) {
+        for (auto y = 0; y < mipTilesY[mip]; ++y) {
+            for (auto x = 0; x < mipTilesX[mip]; ++x) {
+                const auto tile = mipOffsets[mip] + y*mipTilesX[mip] + x;
+                const auto& state = tiles[tile];
+                if (state.resident) {
+                    pageTable[tile] = std::uint32_t(state.slot%slotsX) |
+                            (std::uint32_t(state.slot/slotsX) << 12) |
+                            (std::uint32_t(mip) << 24);
+                }
+                else if (mip + 1 < mipCount) {
+                    const auto parentX = std::min(x/2, mipTilesX[mip + 1] - 1);
+                    const auto parentY = std::min(y/2, mipTilesY[mip + 1] - 1);
+                    pageTable[tile] = pageTable[mipOffsets[mip + 1] +
+                            parentY*mipTilesX[mip + 1] + parentX];
+                }
+                else {
+                    pageTable[tile] = std::uint32_t(mip) << 24;
+                }
+            }
+        }
+    }
+}
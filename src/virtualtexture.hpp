@@ -0,0 +1,152 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include "glstatecache.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Tiled texture file: header followed by every tile of every mip, mip 0
+// first, rows top to bottom. Tiles are RGBA8 and carry a border of
+// clamped neighbour texels on each side for filtering
+
+struct VirtualTextureHeader {
+    char magic[4]; // "VTEX"
+    std::uint32_t version;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t tileSize;
+    std::uint32_t border;
+    std::uint32_t mipCount; // Down to the mip that fits into one tile
+};
+
+bool writeVirtualTexture(const char* const fileName,
+        const unsigned char* const rgba, const int width, const int height,
+        const int tileSize = 128, const int border = 1) noexcept;
+
+struct VirtualTextureStats {
+    std::size_t residentTiles = 0;
+    std::size_t pendingTiles = 0;
+    std::size_t uploadedTiles = 0;
+    std::size_t evictedTiles = 0;
+};
+
+// Keeps at most a fixed number of tiles resident. The draws sampling it
+// mark the tiles they need in a bitmap, update() reads it back a frame
+// later, a loader thread pulls missing tiles from disk and the least
+// recently used tiles make room for them. Files are cooked by
+// tools/texturecooker.
+//
+// With ARB_sparse_texture (and a matching page size) tiles are committed
+// straight into a sparse texture, otherwise they go into slots of a
+// physical cache texture addressed through a page table
+
+class VirtualTexture {
+public:
+    static constexpr auto maxMips = 16;
+    static constexpr auto pageTableBinding = 8u;
+    static constexpr auto feedbackBinding = 9u;
+    static constexpr auto textureUnit = 1u;
+
+    VirtualTexture() noexcept = default;
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+    ~VirtualTexture() noexcept;
+
+    bool create(const char* const fileName, const int budgetTiles,
+            GLStateCache& stateCache) noexcept;
+    void destroy() noexcept;
+
+    // Sets the vt* uniforms of a program using fragmentvirtual.glsl
+    void applyUniforms(const GLuint program) const noexcept;
+
+    // Wrap the draws sampling the texture, they write the feedback
+    void beginFeedback() noexcept;
+    void endFeedback() noexcept;
+
+    // Reads feedback, schedules loads and uploads finished tiles. Once a
+    // frame before beginFeedback(): the two feedback bitmaps alternate by
+    // frame and this reads and clears the one the previous frame wrote
+    void update(GLStateCache& stateCache) noexcept;
+
+    void bind(GLStateCache& stateCache) const noexcept;
+
+    bool sparse() const noexcept { return useSparse; }
+    const char* shaderDefines() const noexcept;
+    const VirtualTextureStats& stats() const noexcept { return vtStats; }
+
+private:
+    struct Tile {
+        std::int32_t slot = -1;
+        std::uint64_t lastUsed = 0;
+        bool resident = false;
+        bool pending = false;
+        bool locked = false; // Coarsest mip and sparse mip tail
+    };
+
+    struct LoadedTile {
+        std::uint32_t tile;
+        std::vector<unsigned char> pixels;
+    };
+
+    void loaderMain() noexcept;
+    void request(const std::uint32_t tile) noexcept;
+    void readFeedback() noexcept;
+    void upload(const LoadedTile& loaded, GLStateCache& stateCache) noexcept;
+    std::int32_t acquireSlot(GLStateCache& stateCache) noexcept;
+    void release(const std::uint32_t tile,
+            GLStateCache& stateCache) noexcept;
+    void tileCoords(const std::uint32_t tile, int& mip, int& x,
+            int& y) const noexcept;
+    void rebuildPageTable() noexcept;
+
+    // Layout
+
+    VirtualTextureHeader header = {};
+    int mipOffsets[maxMips] = {};
+    int mipTilesX[maxMips] = {};
+    int mipTilesY[maxMips] = {};
+    std::uint32_t tileCount = 0u;
+    std::size_t tileBytes = 0;
+    int paddedTile = 0;
+
+    // Residency
+
+    std::vector<Tile> tiles;
+    std::vector<std::int32_t> slotTiles;
+    std::vector<std::int32_t> freeSlots;
+    std::vector<std::uint32_t> pageTable;
+    std::deque<LoadedTile> uploadQueue;
+    std::uint64_t frame = 0;
+    bool pageTableDirty = true;
+
+    // GL
+
+    GLuint texture = 0u; // Physical cache or sparse texture
+    GLuint pageTableBuffer = 0u;
+    GLuint feedbackBuffers[2] = {};
+    GLsync feedbackFences[2] = {};
+    int feedbackIndex = 0;
+    int slotsX = 0;
+    int slotsY = 0;
+    int sparseLevels = 0;
+    bool useSparse = false;
+
+    // Loader
+
+    std::thread loader;
+    std::mutex loaderMutex;
+    std::condition_variable loaderWake;
+    std::deque<std::uint32_t> loadRequests;
+    std::vector<LoadedTile> loadedTiles;
+    std::FILE* file = nullptr;
+    bool stopping = false;
+
+    VirtualTextureStats vtStats;
+};
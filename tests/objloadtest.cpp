@@ -0,0 +1,61 @@
+// Loads OBJ text whose usemtl statements fall around the boundary of the
+// loader's parse chunks and checks every face keeps its material. Run by
+// ctest, or:
+//     objloadtest
+
+#include "meshloader.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// Same as objChunkSize in src/meshloader.cpp
+constexpr auto chunkSize = std::size_t(1) << 20;
+
+static auto makeObj(const std::size_t usemtlOffset) noexcept {
+    auto text = std::string("v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+            "usemtl A\nf 1 2 3\n");
+
+    // Comment lines up to the offset, none shorter than "#\n"
+    while (text.size() < usemtlOffset) {
+        const auto left = usemtlOffset - text.size();
+        const auto line = left < 256u ? left : std::size_t(128);
+        text += '#';
+        text.append(line - 2u, 'x');
+        text += '\n';
+    }
+    return text + "usemtl B\nf 1 2 3\n";
+}
+
+static bool check(const std::size_t usemtlOffset) noexcept {
+    const auto text = makeObj(usemtlOffset);
+    auto mesh = Mesh();
+    if (!loadObj(text.data(), text.size(), mesh)) {
+        std::cout << "usemtl at " << usemtlOffset << ": loading failed" <<
+                std::endl;
+        return false;
+    }
+    if (mesh.submeshes.size() != 2u ||
+            mesh.submeshes[0].material == mesh.submeshes[1].material ||
+            mesh.submeshes[1].firstIndex != 3u ||
+            mesh.submeshes[1].indexCount != 3u) {
+        std::cout << "usemtl at " << usemtlOffset << ": " <<
+                mesh.submeshes.size() << " submeshes, expected 2" <<
+                std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main() noexcept {
+    auto failed = 0;
+    auto count = 0;
+    for (auto offset = chunkSize - 16u; offset <= chunkSize + 16u;
+            ++offset) {
+        failed += !check(offset);
+        ++count;
+    }
+    std::cout << count - failed << "/" << count <<
+            " usemtl offsets kept their material" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
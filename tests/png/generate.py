@@ -0,0 +1,112 @@
+# Writes the PNGs pngdecodetest decodes and, next to each, the RGBA8 pixels
+# it must decode to. Every colour type, every filter and zlib levels 0, 1,
+# 6 and 9, small images for the edge cases and larger ones so the streams
+# use dynamic Huffman blocks. Deterministic, run from this directory:
+#     python3 generate.py
+
+import random
+import struct
+import zlib
+
+CHANNELS = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}
+
+
+def chunk(kind, data):
+    body = kind + data
+    return (struct.pack(">I", len(data)) + body +
+            struct.pack(">I", zlib.crc32(body) & 0xffffffff))
+
+
+def paeth(a, b, c):
+    p = a + b - c
+    pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+    if pa <= pb and pa <= pc:
+        return a
+    return b if pb <= pc else c
+
+
+def filter_row(kind, row, previous, bpp):
+    out = bytearray()
+    for i, x in enumerate(row):
+        a = row[i - bpp] if i >= bpp else 0
+        b = previous[i]
+        c = previous[i - bpp] if i >= bpp else 0
+        predictor = (0, a, b, (a + b) // 2, paeth(a, b, c))[kind]
+        out.append((x - predictor) & 0xff)
+    return bytes(out)
+
+
+def image(rng, width, height, channels):
+    # Gradients with noise, compressible but not trivially
+    rows = []
+    for y in range(height):
+        row = bytearray()
+        for x in range(width):
+            for c in range(channels):
+                value = (x*7 + y*5 + c*40) & 0xff
+                if rng.random() < .3:
+                    value = rng.randrange(256)
+                row.append(value)
+        rows.append(bytes(row))
+    return rows
+
+
+def write(name, rng, color_type, level, filters, width, height):
+    channels = CHANNELS[color_type]
+    rows = image(rng, width, height, channels)
+    extra = b""
+    if color_type == 3:
+        count = 1 + max(max(row) for row in rows)
+        palette = bytes(rng.randrange(256) for _ in range(count*3))
+        alpha = bytes(rng.randrange(256) for _ in range(count//2))
+        extra = chunk(b"PLTE", palette) + chunk(b"tRNS", alpha)
+
+    raw = bytearray()
+    previous = bytes(width*channels)
+    for y, row in enumerate(rows):
+        kind = filters[y % len(filters)]
+        raw.append(kind)
+        raw += filter_row(kind, row, previous, channels)
+        previous = row
+
+    header = struct.pack(">IIBBBBB", width, height, 8, color_type, 0, 0, 0)
+    with open(name + ".png", "wb") as file:
+        file.write(b"\x89PNG\r\n\x1a\n" + chunk(b"IHDR", header) + extra +
+                   chunk(b"IDAT", zlib.compress(bytes(raw), level)) +
+                   chunk(b"IEND", b""))
+
+    rgba = bytearray()
+    for row in rows:
+        for x in range(width):
+            texel = row[x*channels:(x + 1)*channels]
+            if color_type == 0:
+                rgba += bytes((texel[0],)*3 + (255,))
+            elif color_type == 2:
+                rgba += texel + b"\xff"
+            elif color_type == 3:
+                index = texel[0]
+                rgba += palette[index*3:index*3 + 3]
+                rgba.append(alpha[index] if index < len(alpha) else 255)
+            elif color_type == 4:
+                rgba += bytes((texel[0],)*3 + (texel[1],))
+            else:
+                rgba += texel
+    with open(name + ".rgba", "wb") as file:
+        file.write(rgba)
+
+
+def main():
+    rng = random.Random(37)
+    patterns = ([4], [1], [2, 3], [0, 1, 2, 3, 4])
+    for color_type in sorted(CHANNELS):
+        for level in (0, 1, 6, 9):
+            for index, filters in enumerate(patterns):
+                if index == 3:
+                    width, height = 67, 45
+                else:
+                    width, height = rng.randrange(1, 24), rng.randrange(1, 18)
+                write("type%d_level%d_%d" % (color_type, level, index), rng,
+                      color_type, level, filters, width, height)
+
+
+main()
@@ -0,0 +1,74 @@
+// Decodes every PNG in a directory with PngDecoder and compares it with
+// the RGBA8 pixels stored next to it, see tests/png/generate.py. Run by
+// ctest, or:
+//     pngdecodetest tests/png
+
+#include "imagedecoder.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static auto readFile(const std::filesystem::path& fileName) noexcept {
+    auto file = std::ifstream(fileName, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>());
+}
+
+static bool check(const PngDecoder& decoder,
+        const std::filesystem::path& fileName) noexcept {
+    const auto png = readFile(fileName);
+    const auto expected = readFile(
+            std::filesystem::path(fileName).replace_extension(".rgba"));
+    if (!decoder.accepts(png.data(), png.size())) {
+        std::cout << fileName.string() << ": not accepted" << std::endl;
+        return false;
+    }
+
+    auto rgba = std::vector<unsigned char>();
+    const auto decoded = decoder.decode(png.data(), png.size(),
+            [&rgba](const int width, const int height) {
+                rgba.resize(static_cast<std::size_t>(width)*height*4u);
+                return rgba.data();
+            });
+    if (!decoded) {
+        std::cout << fileName.string() << ": decoding failed" << std::endl;
+        return false;
+    }
+    if (rgba != expected) {
+        std::cout << fileName.string() << ": pixels differ" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) noexcept {
+    const auto directory = std::filesystem::path(argc > 1 ? argv[1] :
+            "tests/png");
+    auto fileNames = std::vector<std::filesystem::path>();
+    auto error = std::error_code();
+    for (const auto& entry :
+            std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().extension() == ".png") {
+            fileNames.push_back(entry.path());
+        }
+    }
+    std::sort(fileNames.begin(), fileNames.end());
+    if (fileNames.empty()) {
+        std::cout << "No PNGs in " << directory.string() << std::endl;
+        return 1;
+    }
+
+    const auto decoder = PngDecoder();
+    auto failed = 0;
+    for (const auto& fileName : fileNames) {
+        failed += !check(decoder, fileName);
+    }
+    std::cout << fileNames.size() - failed << "/" << fileNames.size() <<
+            " PNGs decoded identically" << std::endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+// Decodes images with SOIL2 and with the decoders in src/imagedecoder.cpp
+// and compares time and output. Run from the build directory:
+//     decodebench [iterations] [images...]
+
+#include <SOIL2/SOIL2.h>
+
+#include "imagedecoder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+static auto readFile(const char* const fileName) noexcept {
+    auto file = std::ifstream(fileName, std::ios::binary);
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file),
+            std::istreambuf_iterator<char>());
+}
+
+template <typename Decode>
+static auto averageMilliseconds(const int iterations,
+        const Decode& decode) noexcept {
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < iterations; ++i) {
+        decode();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count()/
+            iterations;
+}
+
+int main(int argc, char** argv) noexcept {
+    auto iterations = 20;
+    auto images = std::vector<const char*>{ "rsc/ilufan.png", "rsc/box.png" };
+    if (argc > 1) {
+        iterations = std::max(1, std::atoi(argv[1]));
+    }
+    if (argc > 2) {
+        images.assign(argv + 2, argv + argc);
+    }
+
+    const auto decoders = ImageDecoders();
+    for (const auto imageName : images) {
+        const auto data = readFile(imageName);
+        if (data.empty()) {
+            std::cout << imageName << ": not found\n";
+            continue;
+        }
+
+        // Reference pixels and timing
+
+        auto width = 0;
+        auto height = 0;
+        const auto reference = SOIL_load_image_from_memory(data.data(),
+                static_cast<int>(data.size()), &width, &height, nullptr,
+                SOIL_LOAD_RGBA);
+        if (!reference) {
+            std::cout << imageName << ": SOIL2 can't decode it\n";
+            continue;
+        }
+        const auto soilTime = averageMilliseconds(iterations, [&] {
+            auto w = 0;
+            auto h = 0;
+            SOIL_free_image_data(SOIL_load_image_from_memory(data.data(),
+                    static_cast<int>(data.size()), &w, &h, nullptr,
+                    SOIL_LOAD_RGBA));
+        });
+
+        // Staging memory is allocated once, as a pixel buffer would be
+
+        auto staging = std::vector<unsigned char>(
+                static_cast<std::size_t>(width)*height*4u);
+        const auto stage = [&](const int w, const int h) {
+            return w == width && h == height ? staging.data() : nullptr;
+        };
+        const auto decoded = decoders.decode(data.data(), data.size(), stage);
+        const auto decoderTime = averageMilliseconds(iterations, [&] {
+            decoders.decode(data.data(), data.size(), stage);
+        });
+
+        const auto identical = decoded &&
+                std::memcmp(staging.data(), reference, staging.size()) == 0;
+        SOIL_free_image_data(reference);
+
+        std::cout << imageName << " " << width << "x" << height <<
+                ": SOIL2 " << soilTime << " ms, decoders " << decoderTime <<
+                " ms (" << soilTime/decoderTime << "x), " <<
+                (identical ? "identical" : "DIFFERENT") << "\n";
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Measures how frame tasks scale with the number of job system workers:
+// frustum culling of a large sphere set and a transform update pass.
+//     jobbench [objects] [iterations] [max workers]
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "culling.hpp"
+#include "jobsystem.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+template <typename Task>
+static auto averageMilliseconds(const int iterations,
+        const Task& task) noexcept {
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = 0; i < iterations; ++i) {
+        task();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::milli>(elapsed).count()/
+            iterations;
+}
+
+int main(int argc, char** argv) noexcept {
+    const auto objectCount = argc > 1 ?
+            static_cast<std::size_t>(std::atoll(argv[1])) :
+            std::size_t(1) << 20;
+    const auto iterations = argc > 2 ? std::max(1, std::atoi(argv[2])) : 20;
+    const auto maxWorkers = argc > 3 ? std::max(1, std::atoi(argv[3])) :
+            std::max(1, int(std::thread::hardware_concurrency()));
+
+    // Scene
+
+    auto random = std::mt19937(1234u);
+    auto position = std::uniform_real_distribution<float>(-500.f, 500.f);
+    auto spheres = BoundingSpheres();
+    auto locals = std::vector<glm::mat4>(objectCount);
+    for (auto& local : locals) {
+        const auto center = glm::vec3(position(random), position(random),
+                position(random));
+        spheres.add(center, 1.f);
+        local = glm::translate(glm::mat4(1.f), center);
+    }
+    auto worlds = std::vector<glm::mat4>(objectCount);
+
+    const auto frustum = extractFrustum(glm::perspective(glm::radians(90.f),
+            16.f/9.f, .1f, 1000.f)*glm::lookAt(glm::vec3(0.f),
+            glm::vec3(0.f, 0.f, -1.f), glm::vec3(0.f, 1.f, 0.f)));
+    auto visible = std::vector<std::uint32_t>();
+
+    auto baseCull = 0.;
+    auto baseTransform = 0.;
+    for (auto workers = 1; workers <= maxWorkers; ++workers) {
+        auto jobs = JobSystem(static_cast<unsigned>(workers));
+
+        const auto cullTime = averageMilliseconds(iterations, [&] {
+            auto stats = CullStats();
+            cullSpheres(frustum, spheres, visible, stats, &jobs);
+        });
+
+        auto parent = glm::rotate(glm::mat4(1.f), .1f,
+                glm::vec3(0.f, 1.f, 0.f));
+        const auto transformTime = averageMilliseconds(iterations, [&] {
+            jobs.parallelFor(objectCount, 4096u,
+                    [&](const std::size_t begin, const std::size_t end) {
+                for (auto i = begin; i < end; ++i) {
+                    worlds[i] = parent*locals[i];
+                }
+            });
+            parent = glm::rotate(parent, .01f, glm::vec3(0.f, 1.f, 0.f));
+        });
+
+        if (workers == 1) {
+            baseCull = cullTime;
+            baseTransform = transformTime;
+        }
+        std::cout << workers << " workers: cull " << cullTime << " ms (" <<
+                baseCull/cullTime << "x), transforms " << transformTime <<
+                " ms (" << baseTransform/transformTime << "x)\n";
+    }
+    return 0;
+}
@@ -0,0 +1,91 @@
+// Imports OBJ and glTF meshes, generates their levels of detail,
+// optimizes them for the vertex cache, overdraw and vertex fetch, splits
+// them in meshlets and writes them in the cooked format the sample maps at
+// startup. Reports the levels and ACMR and ATVR before and after. Run from
+// the build directory:
+//     meshcooker input output [input output...]
+
+#include "cookedmesh.hpp"
+#include "jobsystem.hpp"
+#include "meshlet.hpp"
+#include "meshloader.hpp"
+#include "meshlod.hpp"
+#include "meshoptimizer.hpp"
+
+#include <chrono>
+#include <iostream>
+
+// Of the full detail level, its indices come first
+static auto vertexCacheStats(const Mesh& mesh) noexcept {
+    auto indexCount = mesh.indices.size();
+    if (!mesh.lods.empty()) {
+        const auto& last = mesh.submeshes[mesh.lods[0].firstSubmesh +
+                mesh.lods[0].submeshCount - 1u];
+        indexCount = last.firstIndex + last.indexCount;
+    }
+    return analyzeVertexCache(mesh.indices.data(), indexCount,
+            mesh.vertices.size());
+}
+
+int main(int argc, char** argv) noexcept {
+    if (argc < 3 || argc%2 != 1) {
+        std::cout << "Usage: meshcooker input output [input output...]\n";
+        return 1;
+    }
+
+    auto jobs = JobSystem();
+    auto failed = 0;
+    for (auto arg = 1; arg + 1 < argc; arg += 2) {
+        const auto start = std::chrono::steady_clock::now();
+        auto mesh = Mesh();
+        if (!loadMesh(argv[arg], mesh, &jobs)) {
+            ++failed;
+            continue;
+        }
+        const auto before = vertexCacheStats(mesh);
+        generateLods(mesh);
+        optimizeMesh(mesh);
+        buildMeshlets(mesh);
+        const auto after = vertexCacheStats(mesh);
+        if (!cookMesh(mesh, argv[arg + 1])) {
+            ++failed;
+            continue;
+        }
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+
+        std::cout << argv[arg] << " -> " << argv[arg + 1] << ": " <<
+                mesh.vertices.size() << " vertices, " <<
+                mesh.indices.size()/3u << " triangles, " <<
+                mesh.submeshes.size() << " submeshes, " <<
+                mesh.meshlets.size() << " meshlets, " <<
+                std::chrono::duration<double, std::milli>(elapsed).count() <<
+                " ms\n";
+        std::cout << "    ACMR " << before.acmr() << " -> " << after.acmr() <<
+                ", ATVR " << before.atvr() << " -> " << after.atvr() << '\n';
+        for (auto level = std::size_t(0); level < mesh.lods.size(); ++level) {
+            const auto& lod = mesh.lods[level];
+            auto triangles = std::size_t(0);
+            for (auto submesh = lod.firstSubmesh; submesh <
+                    lod.firstSubmesh + lod.submeshCount; ++submesh) {
+                triangles += mesh.submeshes[submesh].indexCount/3u;
+            }
+            std::cout << "    LOD " << level << ": " << triangles <<
+                    " triangles, " << lod.meshletCount <<
+                    " meshlets, error " << lod.error << '\n';
+        }
+
+        // The cooked file must come back as written
+        auto cooked = CookedMesh();
+        if (!cooked.open(argv[arg + 1]) ||
+                cooked.view().indexCount != mesh.indices.size() ||
+                cooked.view().meshletCount != mesh.meshlets.size()) {
+            std::cout << argv[arg + 1] << " doesn't read back\n";
+            ++failed;
+            continue;
+        }
+        std::cout << "    " << cooked.view().indexSize*8u <<
+                "-bit indices, " << cooked.view().submeshCount <<
+                " draws\n";
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,40 @@
+// Decodes images with the sample's decoders and writes them as tiled
+// virtual texture files, every mip split into bordered tiles that
+// VirtualTexture streams. The build cooks rsc/ilufan.png this way. Run from
+// the build directory:
+//     texturecooker input output [input output...]
+
+#include "imagedecoder.hpp"
+#include "virtualtexture.hpp"
+
+#include <iostream>
+#include <vector>
+
+int main(int argc, char** argv) noexcept {
+    if (argc < 3 || argc%2 != 1) {
+        std::cout << "Usage: texturecooker input output " <<
+                "[input output...]\n";
+        return 1;
+    }
+
+    const auto decoders = ImageDecoders();
+    auto rgba = std::vector<unsigned char>();
+    auto failed = 0;
+    for (auto arg = 1; arg + 1 < argc; arg += 2) {
+        auto width = 0;
+        auto height = 0;
+        if (!decoders.load(argv[arg], rgba, width, height)) {
+            std::cout << argv[arg] << " can't be decoded\n";
+            ++failed;
+            continue;
+        }
+        if (!writeVirtualTexture(argv[arg + 1], rgba.data(), width,
+                height)) {
+            ++failed;
+            continue;
+        }
+        std::cout << argv[arg] << " -> " << argv[arg + 1] << ": " <<
+                width << "x" << height << '\n';
+    }
+    return failed == 0 ? 0 : 1;
+}